@@ -903,6 +903,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "601");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 			"Partial");
+	config_set_default_uint  (basicConfig, "Video", "ConversionThreads", 0);
 
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
@@ -2477,6 +2478,8 @@ int OBSBasic::ResetVideo()
 	ovi.adapter        = 0;
 	ovi.gpu_conversion = true;
 	ovi.scale_type     = GetScaleType(basicConfig);
+	ovi.conversion_threads = (uint32_t)config_get_uint(basicConfig,
+			"Video", "ConversionThreads");
 
 	if (ovi.base_width == 0 || ovi.base_height == 0) {
 		ovi.base_width = 1920;
@@ -3881,6 +3884,11 @@ void OBSBasic::RecordingStop(int code)
 				QTStr("Output.RecordNoSpace.Title"),
 				QTStr("Output.RecordNoSpace.Msg"));
 
+	} else if (code == OBS_OUTPUT_QUEUE_FULL && isVisible()) {
+		QMessageBox::information(this,
+				QTStr("Output.RecordQueueFull.Title"),
+				QTStr("Output.RecordQueueFull.Msg"));
+
 	} else if (code != OBS_OUTPUT_SUCCESS && isVisible()) {
 		QMessageBox::information(this,
 				QTStr("Output.RecordError.Title"),
@@ -3894,6 +3902,10 @@ void OBSBasic::RecordingStop(int code)
 		SysTrayNotify(QTStr("Output.RecordNoSpace.Msg"),
 			QSystemTrayIcon::Warning);
 
+	} else if (code == OBS_OUTPUT_QUEUE_FULL && !isVisible()) {
+		SysTrayNotify(QTStr("Output.RecordQueueFull.Msg"),
+			QSystemTrayIcon::Warning);
+
 	} else if (code != OBS_OUTPUT_SUCCESS && !isVisible()) {
 		SysTrayNotify(QTStr("Output.RecordError.Msg"),
 			QSystemTrayIcon::Warning);
@@ -226,6 +226,48 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		const uint8_t *data, uint32_t linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	uint32_t bytes_per_pixel;
+	bool success;
+
+	if (!is_texture_2d(tex, "gs_texture_set_image_region"))
+		goto fail;
+
+	if (gs_is_compressed_format(tex->format))
+		goto fail;
+
+	if (x + cx > tex2d->width || y + cy > tex2d->height) {
+		blog(LOG_ERROR, "Texture region out of bounds");
+		goto fail;
+	}
+
+	bytes_per_pixel = gs_get_format_bpp(tex->format) / 8;
+	if (!bytes_per_pixel || linesize % bytes_per_pixel != 0)
+		goto fail;
+
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex2d->base.texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / bytes_per_pixel);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cx, cy,
+			tex->gl_format, tex->gl_type, data);
+	success = gl_success("glTexSubImage2D");
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+
+	if (success)
+		return true;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_set_image_region (GL) failed");
+	return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
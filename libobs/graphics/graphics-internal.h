@@ -159,6 +159,9 @@ struct gs_exports {
 	bool     (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			uint32_t *linesize);
 	void     (*gs_texture_unmap)(gs_texture_t *tex);
+	bool     (*gs_texture_set_image_region)(gs_texture_t *tex,
+			uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+			const uint8_t *data, uint32_t linesize);
 	bool     (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void    *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -2161,6 +2161,21 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		const uint8_t *data, uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_region", tex, data))
+		return false;
+	if (!graphics->exports.gs_texture_set_image_region)
+		return false;
+
+	return graphics->exports.gs_texture_set_image_region(tex, x, y, cx, cy,
+			data, linesize);
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
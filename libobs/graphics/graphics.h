@@ -676,6 +676,15 @@ EXPORT enum gs_color_format gs_texture_get_color_format(
 EXPORT bool     gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 		uint32_t *linesize);
 EXPORT void     gs_texture_unmap(gs_texture_t *tex);
+/**
+ * Updates a region of a texture without touching the rest of it.  Not every
+ * renderer supports this; returns false if the region could not be updated,
+ * in which case the whole texture should be updated with
+ * gs_texture_set_image instead.
+ */
+EXPORT bool     gs_texture_set_image_region(gs_texture_t *tex,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		const uint8_t *data, uint32_t linesize);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
@@ -18,6 +18,7 @@
 #include "image-file.h"
 #include "../util/base.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #define blog(level, format, ...) \
 	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
@@ -54,12 +55,131 @@ static void bi_def_bitmap_modified(void *bitmap)
 	UNUSED_PARAMETER(bitmap);
 }
 
-static inline int get_full_decoded_gif_size(gs_image_file_t *image)
+/*
+ * Animated gifs whose frames don't all fit in the cache limit are decoded
+ * while they play.  The frame after the current one is decoded ahead of time
+ * on a worker thread, and only the current and next frames are kept.
+ */
+struct gif_stream {
+	pthread_t       thread;
+	bool            thread_active;
+	volatile bool   stop;
+	os_event_t      *event;
+
+	/* protects the gif decoder state and the next frame */
+	pthread_mutex_t mutex;
+
+	uint8_t         *frame;
+	uint8_t         *next;
+	int             frame_idx;
+	int             next_idx;
+	int             request_idx;
+};
+
+static inline size_t get_gif_frame_size(gs_image_file_t *image)
 {
-	return image->gif.width * image->gif.height * 4 * image->gif.frame_count;
+	return (size_t)image->gif.width * (size_t)image->gif.height * 4;
 }
 
-static bool init_animated_gif(gs_image_file_t *image, const char *path)
+/* each gif frame is drawn on top of the previous one, so frames can only be
+ * decoded in order */
+static bool decode_frames_to(gs_image_file_t *image, int frame)
+{
+	int first = (frame < image->last_decoded_frame) ?
+		0 : image->last_decoded_frame + 1;
+
+	for (int i = first; i <= frame; i++) {
+		if (gif_decode_frame(&image->gif, i) != GIF_OK)
+			return false;
+		image->last_decoded_frame = i;
+	}
+
+	return true;
+}
+
+static void *gif_stream_thread(void *param)
+{
+	gs_image_file_t *image = param;
+	struct gif_stream *stream = image->stream;
+
+	os_set_thread_name("image-file: gif decode thread");
+
+	while (os_event_wait(stream->event) == 0) {
+		if (os_atomic_load_bool(&stream->stop))
+			break;
+
+		pthread_mutex_lock(&stream->mutex);
+
+		int idx = stream->request_idx;
+		if (idx != stream->next_idx && decode_frames_to(image, idx)) {
+			memcpy(stream->next, image->gif.frame_image,
+					get_gif_frame_size(image));
+			stream->next_idx = idx;
+		}
+
+		pthread_mutex_unlock(&stream->mutex);
+	}
+
+	return NULL;
+}
+
+static bool init_gif_stream(gs_image_file_t *image)
+{
+	struct gif_stream *stream = bzalloc(sizeof(struct gif_stream));
+	size_t size = get_gif_frame_size(image);
+
+	if (pthread_mutex_init(&stream->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_event_init(&stream->event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+
+	stream->frame       = bmalloc(size);
+	stream->next        = bmalloc(size);
+	stream->frame_idx   = 0;
+	stream->next_idx    = -1;
+	stream->request_idx = 1;
+	memcpy(stream->frame, image->gif.frame_image, size);
+
+	image->stream = stream;
+
+	/* without the thread, frames are simply decoded when needed */
+	if (pthread_create(&stream->thread, NULL, gif_stream_thread,
+				image) == 0) {
+		stream->thread_active = true;
+		os_event_signal(stream->event);
+	}
+
+	return true;
+
+fail_event:
+	pthread_mutex_destroy(&stream->mutex);
+fail_mutex:
+	bfree(stream);
+	return false;
+}
+
+static void free_gif_stream(gs_image_file_t *image)
+{
+	struct gif_stream *stream = image->stream;
+	if (!stream)
+		return;
+
+	if (stream->thread_active) {
+		os_atomic_set_bool(&stream->stop, true);
+		os_event_signal(stream->event);
+		pthread_join(stream->thread, NULL);
+	}
+
+	os_event_destroy(stream->event);
+	pthread_mutex_destroy(&stream->mutex);
+	bfree(stream->frame);
+	bfree(stream->next);
+	bfree(stream);
+	image->stream = NULL;
+}
+
+static bool init_animated_gif(gs_image_file_t *image, const char *path,
+		uint64_t cache_limit)
 {
 	bool is_animated_gif = true;
 	gif_result result;
@@ -107,20 +227,38 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path)
 	max_size = (uint64_t)image->gif.width * (uint64_t)image->gif.height *
 		(uint64_t)image->gif.frame_count * 4LLU;
 
-	if ((uint64_t)get_full_decoded_gif_size(image) != max_size) {
-		blog(LOG_WARNING, "Gif '%s' overflowed maximum pointer size",
-				path);
-		goto fail;
-	}
+	/* the full cache can't be addressed on 32-bit builds, whatever the
+	 * limit is set to */
+	if (cache_limit > SIZE_MAX)
+		cache_limit = SIZE_MAX;
 
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
-	if (image->is_animated_gif) {
+	if (image->is_animated_gif && max_size > cache_limit) {
+		gif_decode_frame(&image->gif, 0);
+
+		if (max_size > SIZE_MAX)
+			blog(LOG_INFO, "Gif '%s' overflowed maximum pointer "
+					"size, decoding it while it plays",
+					path);
+		else
+			blog(LOG_INFO, "Gif '%s' needs %"PRIu64" MB to cache "
+					"all of its frames, decoding it while "
+					"it plays", path,
+					max_size / (1024 * 1024));
+
+		if (!init_gif_stream(image))
+			goto fail;
+
+		image->cx = (uint32_t)image->gif.width;
+		image->cy = (uint32_t)image->gif.height;
+		image->format = GS_RGBA;
+
+	} else if (image->is_animated_gif) {
 		gif_decode_frame(&image->gif, 0);
 
 		image->animation_frame_cache = bzalloc(
 				image->gif.frame_count * sizeof(uint8_t*));
-		image->animation_frame_data = bzalloc(
-				get_full_decoded_gif_size(image));
+		image->animation_frame_data = bzalloc((size_t)max_size);
 
 		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
 			if (gif_decode_frame(&image->gif, i) != GIF_OK)
@@ -154,6 +292,13 @@ not_animated:
 }
 
 void gs_image_file_init(gs_image_file_t *image, const char *file)
+{
+	gs_image_file_init_limit(image, file,
+			GS_IMAGE_FILE_DEFAULT_CACHE_LIMIT);
+}
+
+void gs_image_file_init_limit(gs_image_file_t *image, const char *file,
+		uint64_t cache_limit)
 {
 	size_t len;
 
@@ -168,7 +313,7 @@ void gs_image_file_init(gs_image_file_t *image, const char *file)
 	len = strlen(file);
 
 	if (len > 4 && strcmp(file + len - 4, ".gif") == 0) {
-		if (init_animated_gif(image, file))
+		if (init_animated_gif(image, file, cache_limit))
 			return;
 	}
 
@@ -189,6 +334,7 @@ void gs_image_file_free(gs_image_file_t *image)
 
 	if (image->loaded) {
 		if (image->is_animated_gif) {
+			free_gif_stream(image);
 			gif_finalise(&image->gif);
 			bfree(image->animation_frame_cache);
 			bfree(image->animation_frame_data);
@@ -208,10 +354,12 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 		return;
 
 	if (image->is_animated_gif) {
+		const uint8_t *data = image->stream ?
+			image->stream->frame : image->gif.frame_image;
+
 		image->texture = gs_texture_create(
 				image->cx, image->cy, image->format, 1,
-				(const uint8_t**)&image->gif.frame_image,
-				GS_DYNAMIC);
+				&data, GS_DYNAMIC);
 
 	} else {
 		image->texture = gs_texture_create(
@@ -255,34 +403,54 @@ static inline int calculate_new_frame(gs_image_file_t *image,
 	return new_frame;
 }
 
-static void decode_new_frame(gs_image_file_t *image, int new_frame)
+static void stream_new_frame(gs_image_file_t *image, int new_frame)
 {
-	if (!image->animation_frame_cache[new_frame]) {
-		int last_frame;
+	struct gif_stream *stream = image->stream;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if (stream->frame_idx != new_frame) {
+		if (stream->next_idx == new_frame) {
+			uint8_t *frame = stream->frame;
+			stream->frame = stream->next;
+			stream->next = frame;
+			stream->next_idx = -1;
+			stream->frame_idx = new_frame;
+
+		/* the frame wasn't decoded ahead of time (frames were skipped,
+		 * or the thread is still on it), so decode it here */
+		} else if (decode_frames_to(image, new_frame)) {
+			memcpy(stream->frame, image->gif.frame_image,
+					get_gif_frame_size(image));
+			stream->frame_idx = new_frame;
+		}
+	}
 
-		/* if looped, decode frame 0 */
-		last_frame = (new_frame < image->last_decoded_frame) ?
-			0 : image->last_decoded_frame + 1;
+	stream->request_idx = (new_frame + 1) % (int)image->gif.frame_count;
+	pthread_mutex_unlock(&stream->mutex);
 
-		/* decode missed frames */
-		for (int i = last_frame; i < new_frame; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				return;
-		}
+	if (stream->thread_active)
+		os_event_signal(stream->event);
+
+	image->cur_frame = new_frame;
+}
+
+static void decode_new_frame(gs_image_file_t *image, int new_frame)
+{
+	if (image->stream) {
+		stream_new_frame(image, new_frame);
+		return;
+	}
 
-		/* decode actual desired frame */
-		if (gif_decode_frame(&image->gif, new_frame) == GIF_OK) {
-			size_t pos = new_frame * image->gif.width *
-				image->gif.height * 4;
+	if (!image->animation_frame_cache[new_frame]) {
+		if (decode_frames_to(image, new_frame)) {
+			size_t pos = new_frame * get_gif_frame_size(image);
 			image->animation_frame_cache[new_frame] =
 				image->animation_frame_data + pos;
 
 			memcpy(image->animation_frame_cache[new_frame],
 					image->gif.frame_image,
-					image->gif.width *
-					image->gif.height * 4);
-
-			image->last_decoded_frame = new_frame;
+					get_gif_frame_size(image));
 		}
 	}
 
@@ -318,6 +486,15 @@ void gs_image_file_update_texture(gs_image_file_t *image)
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
+	if (image->stream) {
+		if (image->stream->frame_idx != image->cur_frame)
+			stream_new_frame(image, image->cur_frame);
+
+		gs_texture_set_image(image->texture, image->stream->frame,
+				image->gif.width * 4, false);
+		return;
+	}
+
 	if (!image->animation_frame_cache[image->cur_frame])
 		decode_new_frame(image, image->cur_frame);
 
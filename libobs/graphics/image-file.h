@@ -20,6 +20,12 @@
 #include "graphics.h"
 #include "libnsgif/libnsgif.h"
 
+/* default amount of memory an animated gif may use to keep all of its frames
+ * decoded.  gifs that need more than that are decoded while they play */
+#define GS_IMAGE_FILE_DEFAULT_CACHE_LIMIT (128ULL * 1024ULL * 1024ULL)
+
+struct gif_stream;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -37,6 +43,7 @@ struct gs_image_file {
 	int cur_frame;
 	int cur_loop;
 	int last_decoded_frame;
+	struct gif_stream *stream;
 
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
@@ -45,6 +52,8 @@ struct gs_image_file {
 typedef struct gs_image_file gs_image_file_t;
 
 EXPORT void gs_image_file_init(gs_image_file_t *image, const char *file);
+EXPORT void gs_image_file_init_limit(gs_image_file_t *image, const char *file,
+		uint64_t cache_limit);
 EXPORT void gs_image_file_free(gs_image_file_t *image);
 
 EXPORT void gs_image_file_init_texture(gs_image_file_t *image);
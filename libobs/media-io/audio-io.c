@@ -23,9 +23,11 @@
 #include "../util/circlebuf.h"
 #include "../util/platform.h"
 #include "../util/profiler.h"
+#include "../util/tick-timer.h"
 
 #include "audio-io.h"
 #include "audio-resampler.h"
+#include "audio-math.h"
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
@@ -164,7 +166,8 @@ static inline void do_audio_output(struct audio_output *audio,
 	pthread_mutex_unlock(&audio->input_mutex);
 }
 
-static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
+static inline void clamp_audio_output(struct audio_output *audio, size_t bytes,
+		uint32_t active_mixes)
 {
 	size_t float_size = bytes / sizeof(float);
 
@@ -172,20 +175,11 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		/* do not process mixing if a specific mix is inactive */
-		if (!mix->inputs.num)
+		if ((active_mixes & (1 << mix_idx)) == 0)
 			continue;
 
-		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = mix->buffer[plane];
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val >  1.0f) ?  1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
-		}
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			audio_mix_clamp(mix->buffer[plane], float_size);
 	}
 }
 
@@ -213,12 +207,13 @@ static void input_and_output(struct audio_output *audio,
 	}
 	pthread_mutex_unlock(&audio->input_mutex);
 
-	/* clear mix buffers */
+	/* clear mix buffers, inactive mixes are neither mixed nor output */
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
-		memset(mix->buffer[0], 0, AUDIO_OUTPUT_FRAMES *
-				MAX_AUDIO_CHANNELS * sizeof(float));
+		if ((active_mixes & (1 << mix_idx)) != 0)
+			memset(mix->buffer[0], 0, AUDIO_OUTPUT_FRAMES *
+					MAX_AUDIO_CHANNELS * sizeof(float));
 
 		for (size_t i = 0; i < audio->planes; i++)
 			data[mix_idx].data[i] = mix->buffer[i];
@@ -231,11 +226,13 @@ static void input_and_output(struct audio_output *audio,
 		return;
 
 	/* clamps audio data to -1.0..1.0 */
-	clamp_audio_output(audio, bytes);
+	clamp_audio_output(audio, bytes, active_mixes);
 
 	/* output */
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if ((active_mixes & (1 << i)) != 0)
+			do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+	}
 }
 
 static void *audio_thread(void *param)
@@ -246,20 +243,29 @@ static void *audio_thread(void *param)
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
-	uint32_t audio_wait_time =
-		(uint32_t)(audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) /
-				1000000);
+	uint64_t overrun_ticks = 0;
+	uint64_t multi_tick_wakes = 0;
+	struct tick_timer timer;
 
 	os_set_thread_name("audio-io: audio thread");
 
 	const char *audio_thread_name =
 		profile_store_name(obs_get_profiler_name_store(),
 				"audio_thread(%s)", audio->info.name);
+	tick_timer_init(&timer,
+		profile_store_name(obs_get_profiler_name_store(),
+				"audio_thread(%s) wake latency",
+				audio->info.name));
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		uint64_t cur_time;
+		uint64_t ticks = 0;
+		bool on_time;
 
-		os_sleep_ms(audio_wait_time);
+		/* audio_time is the end of the last tick output, which is
+		 * when the next tick becomes due.  sleep until then rather
+		 * than polling at millisecond granularity */
+		on_time = tick_timer_sleepto(&timer, audio_time);
 
 		profile_start(audio_thread_name);
 
@@ -271,6 +277,20 @@ static void *audio_thread(void *param)
 
 			input_and_output(audio, audio_time, prev_time);
 			prev_time = audio_time;
+			ticks++;
+		}
+
+		/* a wake-up that was on time must only have one tick to
+		 * process, anything more means the deadline is wrong */
+		if (ticks > 1) {
+			overrun_ticks += ticks - 1;
+			multi_tick_wakes++;
+
+			if (on_time && multi_tick_wakes == 1)
+				blog(LOG_WARNING, "audio_thread(%s): on time "
+						"wake-up processed %"PRIu64
+						" ticks", audio->info.name,
+						ticks);
 		}
 
 		profile_end(audio_thread_name);
@@ -278,6 +298,15 @@ static void *audio_thread(void *param)
 		profile_reenable_thread();
 	}
 
+	if (overrun_ticks || timer.late_waits)
+		blog(LOG_INFO, "audio_thread(%s): %"PRIu64" of %"PRIu64" "
+				"wake-ups were late (max %"PRIu64" us), "
+				"%"PRIu64" ticks had to be caught up in "
+				"%"PRIu64" wake-ups",
+				audio->info.name, timer.late_waits,
+				timer.waits, timer.max_latency / 1000,
+				overrun_ticks, multi_tick_wakes);
+
 	return NULL;
 }
 
@@ -0,0 +1,105 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-math-simd.h"
+#include <immintrin.h>
+
+/* 8 samples at a time, then the sse version handles the remainder */
+
+void audio_mix_add_avx(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(dst + i);
+		__m256 b = _mm256_loadu_ps(src + i);
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(a, b));
+	}
+
+	audio_mix_add_sse(dst + i, src + i, count - i);
+}
+
+void audio_mix_add_mul_avx(float *dst, const float *src, const float *mul,
+		size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(dst + i);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i),
+				_mm256_loadu_ps(mul + i));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(a, b));
+	}
+
+	audio_mix_add_mul_sse(dst + i, src + i, mul + i, count - i);
+}
+
+void audio_mix_mul_avx(float *data, const float *mul, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(data + i);
+		__m256 b = _mm256_loadu_ps(mul + i);
+		_mm256_storeu_ps(data + i, _mm256_mul_ps(a, b));
+	}
+
+	audio_mix_mul_sse(data + i, mul + i, count - i);
+}
+
+void audio_mix_scale_avx(float *data, float vol, size_t count)
+{
+	__m256 vol_val = _mm256_set1_ps(vol);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(data + i);
+		_mm256_storeu_ps(data + i, _mm256_mul_ps(a, vol_val));
+	}
+
+	audio_mix_scale_sse(data + i, vol, count - i);
+}
+
+void audio_mix_clamp_avx(float *data, size_t count)
+{
+	__m256 max_val = _mm256_set1_ps(1.0f);
+	__m256 min_val = _mm256_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(data + i);
+		a = _mm256_max_ps(min_val, _mm256_min_ps(max_val, a));
+		_mm256_storeu_ps(data + i, a);
+	}
+
+	audio_mix_clamp_sse(data + i, count - i);
+}
+
+bool audio_mix_silent_avx(const float *data, size_t count)
+{
+	__m256 zero = _mm256_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(data + i);
+		__m256 ne = _mm256_cmp_ps(a, zero, _CMP_NEQ_UQ);
+		if (_mm256_movemask_ps(ne) != 0)
+			return false;
+	}
+
+	return audio_mix_silent_sse(data + i, count - i);
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * Instruction set specific versions of the audio-math.h buffer functions,
+ * built with the matching compiler flags and picked at runtime by
+ * audio-math.c
+ */
+
+#define DECLARE_AUDIO_MATH_FUNCS(suffix)                                      \
+	void audio_mix_add_##suffix(float *dst, const float *src,             \
+			size_t count);                                        \
+	void audio_mix_add_mul_##suffix(float *dst, const float *src,         \
+			const float *mul, size_t count);                      \
+	void audio_mix_mul_##suffix(float *data, const float *mul,            \
+			size_t count);                                        \
+	void audio_mix_scale_##suffix(float *data, float vol, size_t count);  \
+	void audio_mix_clamp_##suffix(float *data, size_t count);             \
+	bool audio_mix_silent_##suffix(const float *data, size_t count)
+
+DECLARE_AUDIO_MATH_FUNCS(sse);
+DECLARE_AUDIO_MATH_FUNCS(avx);
+
+static inline float audio_mix_clamp_sample(float val)
+{
+	val = (val >  1.0f) ?  1.0f : val;
+	val = (val < -1.0f) ? -1.0f : val;
+	return val;
+}
@@ -0,0 +1,165 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-math.h"
+#include "audio-math-simd.h"
+#include "../util/platform.h"
+#include <xmmintrin.h>
+
+/* buffers are not necessarily aligned (mixing can start at any frame), so
+ * unaligned loads/stores are used throughout */
+
+void audio_mix_add_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(dst + i);
+		__m128 b = _mm_loadu_ps(src + i);
+		_mm_storeu_ps(dst + i, _mm_add_ps(a, b));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_add_mul_sse(float *dst, const float *src, const float *mul,
+		size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(dst + i);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i),
+				_mm_loadu_ps(mul + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(a, b));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * mul[i];
+}
+
+void audio_mix_mul_sse(float *data, const float *mul, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(data + i);
+		__m128 b = _mm_loadu_ps(mul + i);
+		_mm_storeu_ps(data + i, _mm_mul_ps(a, b));
+	}
+
+	for (; i < count; i++)
+		data[i] *= mul[i];
+}
+
+void audio_mix_scale_sse(float *data, float vol, size_t count)
+{
+	__m128 vol_val = _mm_set1_ps(vol);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(data + i);
+		_mm_storeu_ps(data + i, _mm_mul_ps(a, vol_val));
+	}
+
+	for (; i < count; i++)
+		data[i] *= vol;
+}
+
+void audio_mix_clamp_sse(float *data, size_t count)
+{
+	__m128 max_val = _mm_set1_ps(1.0f);
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	/* minps/maxps return the second operand if either is NaN, so with the
+	 * limits first NaN passes through like it does in
+	 * audio_mix_clamp_sample (same for the avx version) */
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(data + i);
+		a = _mm_max_ps(min_val, _mm_min_ps(max_val, a));
+		_mm_storeu_ps(data + i, a);
+	}
+
+	for (; i < count; i++)
+		data[i] = audio_mix_clamp_sample(data[i]);
+}
+
+bool audio_mix_silent_sse(const float *data, size_t count)
+{
+	__m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+	/* compares as floats, so -0.0 is silent and NaN is not */
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(data + i);
+		if (_mm_movemask_ps(_mm_cmpneq_ps(a, zero)) != 0)
+			return false;
+	}
+
+	for (; i < count; i++) {
+		if (data[i] != 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define audio_math_dispatch(func, ...)                                        \
+do {                                                                          \
+	if (os_get_cpu_features() & OS_CPU_AVX)                               \
+		func ## _avx(__VA_ARGS__);                                    \
+	else                                                                  \
+		func ## _sse(__VA_ARGS__);                                    \
+} while (false)
+
+void audio_mix_add(float *dst, const float *src, size_t count)
+{
+	audio_math_dispatch(audio_mix_add, dst, src, count);
+}
+
+void audio_mix_add_mul(float *dst, const float *src, const float *mul,
+		size_t count)
+{
+	audio_math_dispatch(audio_mix_add_mul, dst, src, mul, count);
+}
+
+void audio_mix_mul(float *data, const float *mul, size_t count)
+{
+	audio_math_dispatch(audio_mix_mul, data, mul, count);
+}
+
+void audio_mix_scale(float *data, float vol, size_t count)
+{
+	audio_math_dispatch(audio_mix_scale, data, vol, count);
+}
+
+void audio_mix_clamp(float *data, size_t count)
+{
+	audio_math_dispatch(audio_mix_clamp, data, count);
+}
+
+bool audio_mix_silent(const float *data, size_t count)
+{
+	if (os_get_cpu_features() & OS_CPU_AVX)
+		return audio_mix_silent_avx(data, count);
+	else
+		return audio_mix_silent_sse(data, count);
+}
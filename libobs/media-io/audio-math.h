@@ -20,6 +20,10 @@
 #include "../util/c99defs.h"
 #include <math.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #ifdef _MSC_VER
 #include <float.h>
 
@@ -41,3 +45,29 @@ static inline float db_to_mul(const float db)
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
+
+/* vectorized float sample buffer operations, picks the best instruction set
+ * available at runtime */
+
+/* dst[i] += src[i] */
+EXPORT void audio_mix_add(float *dst, const float *src, size_t count);
+
+/* dst[i] += src[i] * mul[i] */
+EXPORT void audio_mix_add_mul(float *dst, const float *src, const float *mul,
+		size_t count);
+
+/* data[i] *= mul[i] */
+EXPORT void audio_mix_mul(float *data, const float *mul, size_t count);
+
+/* data[i] *= vol */
+EXPORT void audio_mix_scale(float *data, float vol, size_t count);
+
+/* clamps data to -1.0..1.0 */
+EXPORT void audio_mix_clamp(float *data, size_t count);
+
+/* true if every sample is 0.0 or -0.0, stops at the first one that isn't */
+EXPORT bool audio_mix_silent(const float *data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
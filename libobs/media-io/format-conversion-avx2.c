@@ -0,0 +1,478 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "format-conversion-simd.h"
+#include <immintrin.h>
+
+/* avx2 shuffles only work within each 128 bit lane, so these process 8 uyvx
+ * pixels at a time as two groups of 4 and then permute the results back
+ * together.  the 4 pixel versions handle what's left of each row. */
+
+#define SHUF_ZERO -128
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static FORCE_INLINE __m256i shuffle_both_lanes(__m128i shuf)
+{
+	return _mm256_broadcastsi128_si256(shuf);
+}
+
+static FORCE_INLINE void store_32(uint8_t *dst, __m128i val)
+{
+	*(uint32_t*)dst = (uint32_t)_mm_cvtsi128_si32(val);
+}
+
+static FORCE_INLINE void store_64(uint8_t *dst, __m128i val)
+{
+	_mm_storel_epi64((__m128i*)dst, val);
+}
+
+/* gathers the first dword of each lane in to the low 64 bits */
+static FORCE_INLINE __m128i join_lanes_32(__m256i val)
+{
+	__m256i idx = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(val, idx));
+}
+
+static FORCE_INLINE __m128i lum_shuffle(void)
+{
+	return _mm_setr_epi8(1, 5, 9, 13,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO);
+}
+
+static FORCE_INLINE __m128i i420_chroma_shuffle(void)
+{
+	return _mm_setr_epi8(
+			0, SHUF_ZERO, 4, SHUF_ZERO, 8, SHUF_ZERO, 12, SHUF_ZERO,
+			2, SHUF_ZERO, 6, SHUF_ZERO, 10, SHUF_ZERO, 14, SHUF_ZERO);
+}
+
+static FORCE_INLINE __m128i nv12_chroma_shuffle(void)
+{
+	return _mm_setr_epi8(
+			0, SHUF_ZERO, 4, SHUF_ZERO, 2, SHUF_ZERO, 6, SHUF_ZERO,
+			8, SHUF_ZERO, 12, SHUF_ZERO, 10, SHUF_ZERO, 14, SHUF_ZERO);
+}
+
+static FORCE_INLINE __m256i avg_chroma_256(__m256i line1, __m256i line2,
+		__m256i shuf)
+{
+	__m256i sum = _mm256_add_epi16(_mm256_shuffle_epi8(line1, shuf),
+			_mm256_shuffle_epi8(line2, shuf));
+	sum = _mm256_hadd_epi16(sum, sum);
+	sum = _mm256_srli_epi16(sum, 2);
+	return _mm256_packus_epi16(sum, sum);
+}
+
+static FORCE_INLINE __m128i avg_chroma_128(__m128i line1, __m128i line2,
+		__m128i shuf)
+{
+	__m128i sum = _mm_add_epi16(_mm_shuffle_epi8(line1, shuf),
+			_mm_shuffle_epi8(line2, shuf));
+	sum = _mm_hadd_epi16(sum, sum);
+	sum = _mm_srli_epi16(sum, 2);
+	return _mm_packus_epi16(sum, sum);
+}
+
+static FORCE_INLINE void split_uv_16(uint8_t *u_plane, uint8_t *v_plane,
+		uint32_t uv)
+{
+	*(uint16_t*)u_plane = (uint16_t)uv;
+	*(uint16_t*)v_plane = (uint16_t)(uv>>16);
+}
+
+void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_shuf    = lum_shuffle();
+	__m128i uv_shuf     = i420_chroma_shuffle();
+	__m256i lum_shuf256 = shuffle_both_lanes(lum_shuf);
+	__m256i uv_shuf256  = shuffle_both_lanes(uv_shuf);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+			__m128i uv;
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			store_64(lum_plane + lum_pos0, join_lanes_32(
+					_mm256_shuffle_epi8(line1, lum_shuf256)));
+			store_64(lum_plane + lum_pos1, join_lanes_32(
+					_mm256_shuffle_epi8(line2, lum_shuf256)));
+
+			uv = join_lanes_32(avg_chroma_256(line1, line2,
+						uv_shuf256));
+			split_uv_16(u_plane + chroma_pos, v_plane + chroma_pos,
+					(uint32_t)_mm_cvtsi128_si32(uv));
+			split_uv_16(u_plane + chroma_pos + 2,
+					v_plane + chroma_pos + 2,
+					(uint32_t)_mm_extract_epi32(uv, 1));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+
+			__m128i line1 = _mm_loadu_si128((const __m128i*)img);
+			__m128i line2 = _mm_loadu_si128(
+					(const __m128i*)(img + in_linesize));
+
+			store_32(lum_plane + lum_pos0,
+					_mm_shuffle_epi8(line1, lum_shuf));
+			store_32(lum_plane + lum_pos1,
+					_mm_shuffle_epi8(line2, lum_shuf));
+			split_uv_16(u_plane + chroma_pos, v_plane + chroma_pos,
+					(uint32_t)_mm_cvtsi128_si32(avg_chroma_128(
+							line1, line2, uv_shuf)));
+		}
+	}
+}
+
+void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_shuf    = lum_shuffle();
+	__m128i uv_shuf     = nv12_chroma_shuffle();
+	__m256i lum_shuf256 = shuffle_both_lanes(lum_shuf);
+	__m256i uv_shuf256  = shuffle_both_lanes(uv_shuf);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			store_64(lum_plane + lum_pos0, join_lanes_32(
+					_mm256_shuffle_epi8(line1, lum_shuf256)));
+			store_64(lum_plane + lum_pos1, join_lanes_32(
+					_mm256_shuffle_epi8(line2, lum_shuf256)));
+			store_64(chroma_plane + chroma_y_pos + x, join_lanes_32(
+					avg_chroma_256(line1, line2, uv_shuf256)));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_loadu_si128((const __m128i*)img);
+			__m128i line2 = _mm_loadu_si128(
+					(const __m128i*)(img + in_linesize));
+
+			store_32(lum_plane + lum_pos0,
+					_mm_shuffle_epi8(line1, lum_shuf));
+			store_32(lum_plane + lum_pos1,
+					_mm_shuffle_epi8(line2, lum_shuf));
+			store_32(chroma_plane + chroma_y_pos + x,
+					avg_chroma_128(line1, line2, uv_shuf));
+		}
+	}
+}
+
+static FORCE_INLINE void store_planar_8(uint8_t *lum, uint8_t *u, uint8_t *v,
+		__m256i val, __m256i shuf)
+{
+	__m256i idx = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m256i planar = _mm256_permutevar8x32_epi32(
+			_mm256_shuffle_epi8(val, shuf), idx);
+	__m128i lum_u = _mm256_castsi256_si128(planar);
+
+	store_64(lum, lum_u);
+	store_64(u, _mm_unpackhi_epi64(lum_u, lum_u));
+	store_64(v, _mm256_extracti128_si256(planar, 1));
+}
+
+static FORCE_INLINE void store_planar_4(uint8_t *lum, uint8_t *u, uint8_t *v,
+		__m128i val, __m128i shuf)
+{
+	val = _mm_shuffle_epi8(val, shuf);
+
+	store_32(lum, val);
+	store_32(u, _mm_srli_si128(val, 4));
+	store_32(v, _mm_srli_si128(val, 8));
+}
+
+void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	/* Y, U and V of the four pixels in the first three dwords */
+	__m128i planar_shuf    = _mm_setr_epi8(1, 5, 9, 13, 0, 4, 8, 12,
+			2, 6, 10, 14,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO);
+	__m256i planar_shuf256 = shuffle_both_lanes(planar_shuf);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			store_planar_8(lum_plane + lum_pos0, u_plane + lum_pos0,
+					v_plane + lum_pos0,
+					_mm256_loadu_si256((const __m256i*)img),
+					planar_shuf256);
+			store_planar_8(lum_plane + lum_pos1, u_plane + lum_pos1,
+					v_plane + lum_pos1,
+					_mm256_loadu_si256((const __m256i*)
+						(img + in_linesize)),
+					planar_shuf256);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			store_planar_4(lum_plane + lum_pos0, u_plane + lum_pos0,
+					v_plane + lum_pos0,
+					_mm_loadu_si128((const __m128i*)img),
+					planar_shuf);
+			store_planar_4(lum_plane + lum_pos1, u_plane + lum_pos1,
+					v_plane + lum_pos1,
+					_mm_loadu_si128((const __m128i*)
+						(img + in_linesize)),
+					planar_shuf);
+		}
+	}
+}
+
+/* val holds 8 luma values and their chroma in each lane.  the lanes are
+ * expanded to pixels 0-3/8-11 and 4-7/12-15, then put back in order */
+static FORCE_INLINE void store_packed_444_16(uint32_t *output, __m256i val,
+		__m256i shuf_lo, __m256i shuf_hi)
+{
+	__m256i lo = _mm256_shuffle_epi8(val, shuf_lo);
+	__m256i hi = _mm256_shuffle_epi8(val, shuf_hi);
+
+	_mm256_storeu_si256((__m256i*)output,
+			_mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*)(output + 8),
+			_mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+static FORCE_INLINE __m256i combine_lum_chroma(__m128i lum, __m128i chroma)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_unpacklo_epi64(lum, chroma)),
+			_mm_unpackhi_epi64(lum, chroma), 1);
+}
+
+void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	/* luma in bytes 0-7, U in bytes 8-11, V in bytes 12-15 */
+	__m256i shuf_lo = shuffle_both_lanes(_mm_setr_epi8(
+			0, 8, 12, SHUF_ZERO, 1, 8, 12, SHUF_ZERO,
+			2, 9, 13, SHUF_ZERO, 3, 9, 13, SHUF_ZERO));
+	__m256i shuf_hi = shuffle_both_lanes(_mm_setr_epi8(
+			4, 10, 14, SHUF_ZERO, 5, 10, 14, SHUF_ZERO,
+			6, 11, 15, SHUF_ZERO, 7, 11, 15, SHUF_ZERO));
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			/* U0-3 V0-3 U4-7 V4-7 */
+			__m128i uv = _mm_unpacklo_epi32(
+					_mm_loadl_epi64(
+						(const __m128i*)(chroma0 + x)),
+					_mm_loadl_epi64(
+						(const __m128i*)(chroma1 + x)));
+			__m128i l0 = _mm_loadu_si128(
+					(const __m128i*)(lum0 + x*2));
+			__m128i l1 = _mm_loadu_si128(
+					(const __m128i*)(lum1 + x*2));
+
+			store_packed_444_16(output0 + x*2,
+					combine_lum_chroma(l0, uv),
+					shuf_lo, shuf_hi);
+			store_packed_444_16(output1 + x*2,
+					combine_lum_chroma(l1, uv),
+					shuf_lo, shuf_hi);
+		}
+
+		decompress_420_pixels(lum0 + x*2, lum1 + x*2,
+				chroma0 + x, chroma1 + x,
+				output0 + x*2, output1 + x*2, width_d2 - x);
+	}
+}
+
+void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	/* luma in bytes 0-7, interleaved UV in bytes 8-15 */
+	__m256i shuf_lo = shuffle_both_lanes(_mm_setr_epi8(
+			0, 8, 9, SHUF_ZERO, 1, 8, 9, SHUF_ZERO,
+			2, 10, 11, SHUF_ZERO, 3, 10, 11, SHUF_ZERO));
+	__m256i shuf_hi = shuffle_both_lanes(_mm_setr_epi8(
+			4, 12, 13, SHUF_ZERO, 5, 12, 13, SHUF_ZERO,
+			6, 14, 15, SHUF_ZERO, 7, 14, 15, SHUF_ZERO));
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i uv = _mm_loadu_si128(
+					(const __m128i*)(chroma + x));
+			__m128i l0 = _mm_loadu_si128(
+					(const __m128i*)(lum0 + x*2));
+			__m128i l1 = _mm_loadu_si128(
+					(const __m128i*)(lum1 + x*2));
+
+			store_packed_444_16(output0 + x*2,
+					combine_lum_chroma(l0, uv),
+					shuf_lo, shuf_hi);
+			store_packed_444_16(output1 + x*2,
+					combine_lum_chroma(l1, uv),
+					shuf_lo, shuf_hi);
+		}
+
+		decompress_nv12_pixels(lum0 + x*2, lum1 + x*2, chroma + x,
+				output0 + x*2, output1 + x*2, width_d2 - x);
+	}
+}
+
+void decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t y;
+
+	/* each input dword holds two pixels, the second pixel's output reuses
+	 * the dword with its own luma moved in to the first luma position */
+	__m256i shuf = shuffle_both_lanes(leading_lum ?
+		_mm_setr_epi8(0, 1, 2, 3, 2, 1, 2, 3, 4, 5, 6, 7, 6, 5, 6, 7) :
+		_mm_setr_epi8(0, 1, 2, 3, 0, 3, 2, 3, 4, 5, 6, 7, 4, 7, 6, 7));
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t       *output32;
+		uint32_t       x;
+
+		input32  = (const uint32_t*)(input + y*in_linesize);
+		output32 = (uint32_t*)(output + y*out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m256i val = _mm256_loadu_si256(
+					(const __m256i*)(input32 + x));
+
+			/* qwords 0,1 to the two lanes, then qwords 2,3 */
+			_mm256_storeu_si256((__m256i*)(output32 + x*2),
+					_mm256_shuffle_epi8(
+						_mm256_permute4x64_epi64(val,
+							_MM_SHUFFLE(1, 1, 0, 0)),
+						shuf));
+			_mm256_storeu_si256((__m256i*)(output32 + x*2 + 8),
+					_mm256_shuffle_epi8(
+						_mm256_permute4x64_epi64(val,
+							_MM_SHUFFLE(3, 3, 2, 2)),
+						shuf));
+		}
+
+		decompress_422_pixels(input32 + x, output32 + x*2,
+				width_d2 - x, leading_lum);
+	}
+}
@@ -0,0 +1,130 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * Instruction set specific versions of the format-conversion.h functions.
+ * Each set lives in its own file so it can be built with the matching
+ * compiler flags; format-conversion.c picks one at runtime.
+ */
+
+#define DECLARE_FORMAT_CONVERSION_FUNCS(suffix)                               \
+	void compress_uyvx_to_i420_##suffix(                                  \
+			const uint8_t *input, uint32_t in_linesize,           \
+			uint32_t start_y, uint32_t end_y,                     \
+			uint8_t *output[], const uint32_t out_linesize[]);    \
+	void compress_uyvx_to_nv12_##suffix(                                  \
+			const uint8_t *input, uint32_t in_linesize,           \
+			uint32_t start_y, uint32_t end_y,                     \
+			uint8_t *output[], const uint32_t out_linesize[]);    \
+	void convert_uyvx_to_i444_##suffix(                                   \
+			const uint8_t *input, uint32_t in_linesize,           \
+			uint32_t start_y, uint32_t end_y,                     \
+			uint8_t *output[], const uint32_t out_linesize[]);    \
+	void decompress_nv12_##suffix(                                        \
+			const uint8_t *const input[],                         \
+			const uint32_t in_linesize[],                         \
+			uint32_t start_y, uint32_t end_y,                     \
+			uint8_t *output, uint32_t out_linesize);              \
+	void decompress_420_##suffix(                                         \
+			const uint8_t *const input[],                         \
+			const uint32_t in_linesize[],                         \
+			uint32_t start_y, uint32_t end_y,                     \
+			uint8_t *output, uint32_t out_linesize);              \
+	void decompress_422_##suffix(                                         \
+			const uint8_t *input, uint32_t in_linesize,           \
+			uint32_t start_y, uint32_t end_y,                     \
+			uint8_t *output, uint32_t out_linesize,               \
+			bool leading_lum)
+
+DECLARE_FORMAT_CONVERSION_FUNCS(sse2);
+DECLARE_FORMAT_CONVERSION_FUNCS(ssse3);
+DECLARE_FORMAT_CONVERSION_FUNCS(avx2);
+
+/*
+ * Plain C row helpers, shared by every version for the pixels left over
+ * after the vectorized part of a row
+ */
+
+static inline void decompress_420_pixels(
+		const uint8_t *lum0, const uint8_t *lum1,
+		const uint8_t *chroma0, const uint8_t *chroma1,
+		uint32_t *output0, uint32_t *output1, uint32_t count)
+{
+	for (uint32_t x = 0; x < count; x++) {
+		uint32_t out;
+		out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
+
+		*(output0++) = *(lum0++) | out;
+		*(output0++) = *(lum0++) | out;
+
+		*(output1++) = *(lum1++) | out;
+		*(output1++) = *(lum1++) | out;
+	}
+}
+
+static inline void decompress_nv12_pixels(
+		const uint8_t *lum0, const uint8_t *lum1,
+		const uint16_t *chroma,
+		uint32_t *output0, uint32_t *output1, uint32_t count)
+{
+	for (uint32_t x = 0; x < count; x++) {
+		uint32_t out = *(chroma++) << 8;
+
+		*(output0++) = *(lum0++) | out;
+		*(output0++) = *(lum0++) | out;
+
+		*(output1++) = *(lum1++) | out;
+		*(output1++) = *(lum1++) | out;
+	}
+}
+
+static inline void decompress_422_pixels(
+		const uint32_t *input32, uint32_t *output32, uint32_t count,
+		bool leading_lum)
+{
+	const uint32_t *input32_end = input32 + count;
+
+	if (leading_lum) {
+		while (input32 < input32_end) {
+			uint32_t dw = *input32;
+
+			output32[0] = dw;
+			dw &= 0xFFFFFF00;
+			dw |= (uint8_t)(dw>>16);
+			output32[1] = dw;
+
+			output32 += 2;
+			input32++;
+		}
+	} else {
+		while (input32 < input32_end) {
+			uint32_t dw = *input32;
+
+			output32[0] = dw;
+			dw &= 0xFFFF00FF;
+			dw |= (dw>>16) & 0xFF00;
+			output32[1] = dw;
+
+			output32 += 2;
+			input32++;
+		}
+	}
+}
@@ -0,0 +1,337 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "format-conversion-simd.h"
+#include <tmmintrin.h>
+
+/* uyvx pixels are stored as U, Y, V, X bytes.  unlike the sse2 versions,
+ * these use pshufb to pick out the channels, and unaligned loads so the input
+ * doesn't have to be 16 byte aligned. */
+
+#define SHUF_ZERO -128
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static FORCE_INLINE __m128i load_uyvx(const uint8_t *img)
+{
+	return _mm_loadu_si128((const __m128i*)img);
+}
+
+static FORCE_INLINE void store_32(uint8_t *dst, __m128i val)
+{
+	*(uint32_t*)dst = (uint32_t)_mm_cvtsi128_si32(val);
+}
+
+static FORCE_INLINE __m128i lum_shuffle(void)
+{
+	return _mm_setr_epi8(1, 5, 9, 13,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO);
+}
+
+/* averages a 2x2 block of chroma with the words already shuffled in to
+ * pairs of horizontally adjacent pixels */
+static FORCE_INLINE __m128i avg_chroma(__m128i line1, __m128i line2,
+		__m128i shuf)
+{
+	__m128i sum = _mm_add_epi16(_mm_shuffle_epi8(line1, shuf),
+			_mm_shuffle_epi8(line2, shuf));
+	sum = _mm_hadd_epi16(sum, sum);
+	sum = _mm_srli_epi16(sum, 2);
+	return _mm_packus_epi16(sum, sum);
+}
+
+void compress_uyvx_to_i420_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_shuf = lum_shuffle();
+	__m128i uv_shuf  = _mm_setr_epi8(
+			0, SHUF_ZERO, 4, SHUF_ZERO, 8, SHUF_ZERO, 12, SHUF_ZERO,
+			2, SHUF_ZERO, 6, SHUF_ZERO, 10, SHUF_ZERO, 14, SHUF_ZERO);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+			uint32_t uv;
+
+			__m128i line1 = load_uyvx(img);
+			__m128i line2 = load_uyvx(img + in_linesize);
+
+			store_32(lum_plane + lum_pos0,
+					_mm_shuffle_epi8(line1, lum_shuf));
+			store_32(lum_plane + lum_pos1,
+					_mm_shuffle_epi8(line2, lum_shuf));
+
+			uv = (uint32_t)_mm_cvtsi128_si32(
+					avg_chroma(line1, line2, uv_shuf));
+			*(uint16_t*)(u_plane + chroma_pos) = (uint16_t)uv;
+			*(uint16_t*)(v_plane + chroma_pos) = (uint16_t)(uv>>16);
+		}
+	}
+}
+
+void compress_uyvx_to_nv12_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_shuf = lum_shuffle();
+	__m128i uv_shuf  = _mm_setr_epi8(
+			0, SHUF_ZERO, 4, SHUF_ZERO, 2, SHUF_ZERO, 6, SHUF_ZERO,
+			8, SHUF_ZERO, 12, SHUF_ZERO, 10, SHUF_ZERO, 14, SHUF_ZERO);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = load_uyvx(img);
+			__m128i line2 = load_uyvx(img + in_linesize);
+
+			store_32(lum_plane + lum_pos0,
+					_mm_shuffle_epi8(line1, lum_shuf));
+			store_32(lum_plane + lum_pos1,
+					_mm_shuffle_epi8(line2, lum_shuf));
+			store_32(chroma_plane + chroma_y_pos + x,
+					avg_chroma(line1, line2, uv_shuf));
+		}
+	}
+}
+
+void convert_uyvx_to_i444_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	/* Y, U and V of the four pixels in the first three dwords */
+	__m128i planar_shuf = _mm_setr_epi8(1, 5, 9, 13, 0, 4, 8, 12,
+			2, 6, 10, 14,
+			SHUF_ZERO, SHUF_ZERO, SHUF_ZERO, SHUF_ZERO);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_shuffle_epi8(load_uyvx(img),
+					planar_shuf);
+			__m128i line2 = _mm_shuffle_epi8(
+					load_uyvx(img + in_linesize),
+					planar_shuf);
+
+			store_32(lum_plane + lum_pos0, line1);
+			store_32(lum_plane + lum_pos1, line2);
+			store_32(u_plane + lum_pos0, _mm_srli_si128(line1, 4));
+			store_32(u_plane + lum_pos1, _mm_srli_si128(line2, 4));
+			store_32(v_plane + lum_pos0, _mm_srli_si128(line1, 8));
+			store_32(v_plane + lum_pos1, _mm_srli_si128(line2, 8));
+		}
+	}
+}
+
+/* expands 8 luma values in the low half of val and their chroma in the high
+ * half in to 8 packed pixels */
+static FORCE_INLINE void store_packed_444(uint32_t *output, __m128i val,
+		__m128i shuf_lo, __m128i shuf_hi)
+{
+	_mm_storeu_si128((__m128i*)output, _mm_shuffle_epi8(val, shuf_lo));
+	_mm_storeu_si128((__m128i*)(output + 4),
+			_mm_shuffle_epi8(val, shuf_hi));
+}
+
+void decompress_420_ssse3(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	/* luma in bytes 0-7, U in bytes 8-11, V in bytes 12-15 */
+	__m128i shuf_lo = _mm_setr_epi8(
+			0, 8, 12, SHUF_ZERO, 1, 8, 12, SHUF_ZERO,
+			2, 9, 13, SHUF_ZERO, 3, 9, 13, SHUF_ZERO);
+	__m128i shuf_hi = _mm_setr_epi8(
+			4, 10, 14, SHUF_ZERO, 5, 10, 14, SHUF_ZERO,
+			6, 11, 15, SHUF_ZERO, 7, 11, 15, SHUF_ZERO);
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i uv = _mm_unpacklo_epi32(
+					_mm_cvtsi32_si128(
+						*(const int*)(chroma0 + x)),
+					_mm_cvtsi32_si128(
+						*(const int*)(chroma1 + x)));
+			__m128i line0 = _mm_unpacklo_epi64(_mm_loadl_epi64(
+					(const __m128i*)(lum0 + x*2)), uv);
+			__m128i line1 = _mm_unpacklo_epi64(_mm_loadl_epi64(
+					(const __m128i*)(lum1 + x*2)), uv);
+
+			store_packed_444(output0 + x*2, line0,
+					shuf_lo, shuf_hi);
+			store_packed_444(output1 + x*2, line1,
+					shuf_lo, shuf_hi);
+		}
+
+		decompress_420_pixels(lum0 + x*2, lum1 + x*2,
+				chroma0 + x, chroma1 + x,
+				output0 + x*2, output1 + x*2, width_d2 - x);
+	}
+}
+
+void decompress_nv12_ssse3(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	/* luma in bytes 0-7, interleaved UV in bytes 8-15 */
+	__m128i shuf_lo = _mm_setr_epi8(
+			0, 8, 9, SHUF_ZERO, 1, 8, 9, SHUF_ZERO,
+			2, 10, 11, SHUF_ZERO, 3, 10, 11, SHUF_ZERO);
+	__m128i shuf_hi = _mm_setr_epi8(
+			4, 12, 13, SHUF_ZERO, 5, 12, 13, SHUF_ZERO,
+			6, 14, 15, SHUF_ZERO, 7, 14, 15, SHUF_ZERO);
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i uv = _mm_loadl_epi64(
+					(const __m128i*)(chroma + x));
+			__m128i line0 = _mm_unpacklo_epi64(_mm_loadl_epi64(
+					(const __m128i*)(lum0 + x*2)), uv);
+			__m128i line1 = _mm_unpacklo_epi64(_mm_loadl_epi64(
+					(const __m128i*)(lum1 + x*2)), uv);
+
+			store_packed_444(output0 + x*2, line0,
+					shuf_lo, shuf_hi);
+			store_packed_444(output1 + x*2, line1,
+					shuf_lo, shuf_hi);
+		}
+
+		decompress_nv12_pixels(lum0 + x*2, lum1 + x*2, chroma + x,
+				output0 + x*2, output1 + x*2, width_d2 - x);
+	}
+}
+
+void decompress_422_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t y;
+
+	/* each input dword holds two pixels, the second pixel's output reuses
+	 * the dword with its own luma moved in to the first luma position */
+	__m128i shuf_lo = leading_lum ?
+		_mm_setr_epi8(0, 1, 2, 3, 2, 1, 2, 3, 4, 5, 6, 7, 6, 5, 6, 7) :
+		_mm_setr_epi8(0, 1, 2, 3, 0, 3, 2, 3, 4, 5, 6, 7, 4, 7, 6, 7);
+	__m128i shuf_hi = _mm_add_epi8(shuf_lo, _mm_set1_epi8(8));
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t       *output32;
+		uint32_t       x;
+
+		input32  = (const uint32_t*)(input + y*in_linesize);
+		output32 = (uint32_t*)(output + y*out_linesize);
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i val = _mm_loadu_si128(
+					(const __m128i*)(input32 + x));
+
+			_mm_storeu_si128((__m128i*)(output32 + x*2),
+					_mm_shuffle_epi8(val, shuf_lo));
+			_mm_storeu_si128((__m128i*)(output32 + x*2 + 4),
+					_mm_shuffle_epi8(val, shuf_hi));
+		}
+
+		decompress_422_pixels(input32 + x, output32 + x*2,
+				width_d2 - x, leading_lum);
+	}
+}
@@ -16,6 +16,8 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "format-conversion-simd.h"
+#include "../util/platform.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
@@ -89,7 +91,7 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(
+void compress_uyvx_to_i420_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -127,7 +129,7 @@ void compress_uyvx_to_i420(
 	}
 }
 
-void compress_uyvx_to_nv12(
+void compress_uyvx_to_nv12_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -163,7 +165,7 @@ void compress_uyvx_to_nv12(
 	}
 }
 
-void convert_uyvx_to_i444(
+void convert_uyvx_to_i444_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -202,7 +204,7 @@ void convert_uyvx_to_i444(
 	}
 }
 
-void decompress_420(
+void decompress_420_sse2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
@@ -215,29 +217,20 @@ void decompress_420(
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
-		uint32_t x;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * in_linesize[0]);
-		output1 = (uint32_t*)((uint8_t*)output0 + in_linesize[0]);
-
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out;
-			out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
-
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
-		}
+		decompress_420_pixels(lum0, lum1, chroma0, chroma1,
+				output0, output1, width_d2);
 	}
 }
 
-void decompress_nv12(
+void decompress_nv12_sse2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
@@ -249,9 +242,8 @@ void decompress_nv12(
 
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
-		uint32_t x;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 
 		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
 		lum0 = input[0] + y * 2 * in_linesize[0];
@@ -259,19 +251,12 @@ void decompress_nv12(
 		output0 = (uint32_t*)(output + y * 2 * out_linesize);
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out = *(chroma++) << 8;
-
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
-
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
-		}
+		decompress_nv12_pixels(lum0, lum1, chroma,
+				output0, output1, width_d2);
 	}
 }
 
-void decompress_422(
+void decompress_422_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize,
@@ -280,45 +265,82 @@ void decompress_422(
 	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
 	uint32_t y;
 
-	register const uint32_t *input32;
-	register const uint32_t *input32_end;
-	register uint32_t       *output32;
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t       *output32;
 
-	if (leading_lum) {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+		input32  = (const uint32_t*)(input + y*in_linesize);
+		output32 = (uint32_t*)(output + y*out_linesize);
 
-			while(input32 < input32_end) {
-				register uint32_t dw = *input32;
+		decompress_422_pixels(input32, output32, width_d2, leading_lum);
+	}
+}
 
-				output32[0] = dw;
-				dw &= 0xFFFFFF00;
-				dw |= (uint8_t)(dw>>16);
-				output32[1] = dw;
+/* ------------------------------------------------------------------------- */
 
-				output32 += 2;
-				input32++;
-			}
-		}
-	} else {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
-
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
-
-				output32[0] = dw;
-				dw &= 0xFFFF00FF;
-				dw |= (dw>>16) & 0xFF00;
-				output32[1] = dw;
-
-				output32 += 2;
-				input32++;
-			}
-		}
-	}
+#define convert_dispatch(func, ...)                                           \
+do {                                                                          \
+	uint32_t cpu_features = os_get_cpu_features();                        \
+                                                                              \
+	if (cpu_features & OS_CPU_AVX2)                                       \
+		func ## _avx2(__VA_ARGS__);                                   \
+	else if (cpu_features & OS_CPU_SSSE3)                                 \
+		func ## _ssse3(__VA_ARGS__);                                  \
+	else                                                                  \
+		func ## _sse2(__VA_ARGS__);                                   \
+} while (false)
+
+void compress_uyvx_to_i420(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	convert_dispatch(compress_uyvx_to_i420, input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	convert_dispatch(compress_uyvx_to_nv12, input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void convert_uyvx_to_i444(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	convert_dispatch(convert_uyvx_to_i444, input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_420(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	convert_dispatch(decompress_420, input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_nv12(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	convert_dispatch(decompress_nv12, input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_422(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	convert_dispatch(decompress_422, input, in_linesize,
+			start_y, end_y, output, out_linesize, leading_lum);
 }
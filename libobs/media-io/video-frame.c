@@ -104,6 +104,57 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	}
 }
 
+size_t video_frame_get_size(enum video_format format, uint32_t width,
+		uint32_t height)
+{
+	size_t size = 0;
+	int    alignment = base_get_alignment();
+
+	/* must match the allocations made in video_frame_init */
+	switch (format) {
+	case VIDEO_FORMAT_NONE:
+		return 0;
+
+	case VIDEO_FORMAT_I420:
+		size = width * height;
+		ALIGN_SIZE(size, alignment);
+		size += (width/2) * (height/2);
+		ALIGN_SIZE(size, alignment);
+		size += (width/2) * (height/2);
+		break;
+
+	case VIDEO_FORMAT_NV12:
+		size = width * height;
+		ALIGN_SIZE(size, alignment);
+		size += (width/2) * (height/2) * 2;
+		break;
+
+	case VIDEO_FORMAT_Y800:
+		size = width * height;
+		break;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		size = width * height * 2;
+		break;
+
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		size = width * height * 4;
+		break;
+
+	case VIDEO_FORMAT_I444:
+		size = width * height;
+		ALIGN_SIZE(size, alignment);
+		return size * 3;
+	}
+
+	ALIGN_SIZE(size, alignment);
+	return size;
+}
+
 void video_frame_copy(struct video_frame *dst, const struct video_frame *src,
 		enum video_format format, uint32_t cy)
 {
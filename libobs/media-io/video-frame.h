@@ -28,6 +28,10 @@ struct video_frame {
 EXPORT void video_frame_init(struct video_frame *frame,
 		enum video_format format, uint32_t width, uint32_t height);
 
+/** Returns the size of the data allocated by video_frame_init */
+EXPORT size_t video_frame_get_size(enum video_format format,
+		uint32_t width, uint32_t height);
+
 static inline void video_frame_free(struct video_frame *frame)
 {
 	if (frame) {
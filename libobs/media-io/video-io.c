@@ -32,9 +32,20 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
 
+/* count is the number of times the frame still has to be output.  once a
+ * frame has been published the producer may only add to it while it is
+ * non-zero, and video_thread only ever decrements it.  refs is held by
+ * video_thread until it's done with the frame, and by each input thread
+ * that has the frame queued */
 struct cached_frame_info {
 	struct video_data frame;
-	int count;
+	volatile long count;
+	volatile long refs;
+};
+
+struct queued_frame {
+	struct cached_frame_info *frame_info;
+	uint64_t                 timestamp;
 };
 
 struct video_input {
@@ -43,22 +54,29 @@ struct video_input {
 	struct video_frame        frame[MAX_CONVERT_BUFFERS];
 	int                       cur_frame;
 
+	uint64_t                  last_callback_ns;
+	uint32_t                  skipped_frames;
+
+	/* used when the output dispatches each input on its own thread */
+	struct video_output       *video;
+	pthread_t                 thread;
+	bool                      thread_active;
+	bool                      stop;
+	os_sem_t                  *queue_semaphore;
+	const char                *profile_name;
+	size_t                    queue_size;
+	volatile long             queue_write_pos;
+	volatile long             queue_read_pos;
+	struct queued_frame       queue[MAX_CACHE_SIZE];
+
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
 };
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
-
 struct video_output {
 	struct video_output_info   info;
 
 	pthread_t                  thread;
-	pthread_mutex_t            data_mutex;
 	bool                       stop;
 
 	os_sem_t                   *update_semaphore;
@@ -69,14 +87,55 @@ struct video_output {
 	bool                       initialized;
 
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct video_input) inputs;
-
-	size_t                     available_frames;
-	size_t                     first_added;
-	size_t                     last_added;
+	DARRAY(struct video_input*) inputs;
+
+	/* single producer ring: write_pos is only advanced by the thread
+	 * calling video_output_lock_frame/unlock_frame, and read_pos by
+	 * whichever thread releases the oldest frame.  both only ever
+	 * increase.  dispatch_pos is the next frame video_thread outputs */
+	volatile long              write_pos;
+	volatile long              read_pos;
+	long                       dispatch_pos;
 	struct cached_frame_info   cache[MAX_CACHE_SIZE];
 };
 
+static inline struct cached_frame_info *get_cached_frame(
+		struct video_output *video, long pos)
+{
+	return &video->cache[(unsigned long)pos % video->info.cache_size];
+}
+
+static inline size_t queued_frames(struct video_output *video)
+{
+	long write_pos = os_atomic_load_long(&video->write_pos);
+	long read_pos  = os_atomic_load_long(&video->read_pos);
+	return (size_t)(unsigned long)(write_pos - read_pos);
+}
+
+/* frames can be released out of order when inputs have their own threads, so
+ * whoever releases the last reference sweeps read_pos past every finished
+ * frame at the front of the ring */
+static void release_frame(struct video_output *video,
+		struct cached_frame_info *frame_info)
+{
+	if (os_atomic_dec_long(&frame_info->refs) != 0)
+		return;
+
+	for (;;) {
+		long read_pos = os_atomic_load_long(&video->read_pos);
+
+		if (read_pos == os_atomic_load_long(&video->write_pos))
+			break;
+
+		frame_info = get_cached_frame(video, read_pos);
+		if (os_atomic_load_long(&frame_info->refs) != 0)
+			break;
+
+		os_atomic_compare_swap_long(&video->read_pos, read_pos,
+				read_pos + 1);
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 
 static inline bool scale_video_output(struct video_input *input,
@@ -110,50 +169,144 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
+/* when the ring is close to overflowing (which would make every input skip
+ * frames), inputs whose last callback took longer than a frame drop the
+ * current frame for themselves only so that the other inputs can catch up */
+static inline bool input_should_skip(struct video_output *video,
+		struct video_input *input, bool behind)
+{
+	if (behind && video->inputs.num > 1 &&
+	    input->last_callback_ns > video->frame_time) {
+		input->last_callback_ns = 0;
+		input->skipped_frames++;
+		return true;
+	}
+
+	return false;
+}
+
+static inline void copy_frame_pointers(struct video_data *frame,
+		const struct video_data *cached)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i]     = cached->data[i];
+		frame->linesize[i] = cached->linesize[i];
+	}
+}
+
+static void *input_thread(void *param)
+{
+	struct video_input *input = param;
+
+	os_set_thread_name("video-io: input thread");
+
+	while (os_sem_wait(input->queue_semaphore) == 0) {
+		struct cached_frame_info *frame_info;
+		struct queued_frame *queued;
+		struct video_data frame;
+
+		if (input->stop)
+			break;
+
+		queued = &input->queue[(unsigned long)input->queue_read_pos %
+			input->queue_size];
+		frame_info = queued->frame_info;
+
+		copy_frame_pointers(&frame, &frame_info->frame);
+		frame.timestamp = queued->timestamp;
+
+		profile_start(input->profile_name);
+
+		if (scale_video_output(input, &frame))
+			input->callback(input->param, &frame);
+
+		profile_end(input->profile_name);
+
+		os_atomic_inc_long(&input->queue_read_pos);
+		release_frame(input->video, frame_info);
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+/* the frame data isn't copied, the input thread just holds a reference to
+ * the cached frame until its callback is done with it.  the queue is kept
+ * well below the cache size so that an input that can't keep up drops its
+ * own frames instead of using up the cache for every other input */
+static inline void queue_input_frame(struct video_input *input,
+		struct cached_frame_info *frame_info)
+{
+	struct queued_frame *queued;
+	long write_pos = input->queue_write_pos;
+	long read_pos  = os_atomic_load_long(&input->queue_read_pos);
+
+	if ((size_t)(unsigned long)(write_pos - read_pos) >= input->queue_size) {
+		input->skipped_frames++;
+		return;
+	}
+
+	os_atomic_inc_long(&frame_info->refs);
+
+	queued = &input->queue[(unsigned long)write_pos % input->queue_size];
+	queued->frame_info = frame_info;
+	queued->timestamp  = frame_info->frame.timestamp;
+
+	os_atomic_inc_long(&input->queue_write_pos);
+	os_sem_post(input->queue_semaphore);
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
 	bool complete;
+	bool behind;
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
+	frame_info = get_cached_frame(video, video->dispatch_pos);
 
-	frame_info = &video->cache[video->first_added];
-
-	pthread_mutex_unlock(&video->data_mutex);
+	behind = os_atomic_load_long(&frame_info->count) > 1 ||
+		queued_frames(video) * 2 >= video->info.cache_size;
 
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		struct video_data frame = frame_info->frame;
+		uint64_t start_time;
+
+		if (input->thread_active) {
+			queue_input_frame(input, frame_info);
+			continue;
+		}
+
+		if (input_should_skip(video, input, behind))
+			continue;
+
+		start_time = os_gettime_ns();
 
 		if (scale_video_output(input, &frame))
 			input->callback(input->param, &frame);
+
+		input->last_callback_ns = os_gettime_ns() - start_time;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
 	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
+	complete = os_atomic_dec_long(&frame_info->count) == 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
-
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		video->dispatch_pos++;
+		release_frame(video, frame_info);
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	/* -------------------------------- */
 
 	return complete;
@@ -187,6 +340,50 @@ static void *video_thread(void *param)
 	return NULL;
 }
 
+static void video_input_free(struct video_input *input)
+{
+	if (input->thread_active) {
+		input->stop = true;
+		os_sem_post(input->queue_semaphore);
+		pthread_join(input->thread, NULL);
+
+		while (input->queue_read_pos != input->queue_write_pos) {
+			struct queued_frame *queued = &input->queue[
+				(unsigned long)input->queue_read_pos %
+				input->queue_size];
+
+			release_frame(input->video, queued->frame_info);
+			input->queue_read_pos++;
+		}
+	}
+
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
+		video_frame_free(&input->frame[i]);
+	video_scaler_destroy(input->scaler);
+	os_sem_destroy(input->queue_semaphore);
+	bfree(input);
+}
+
+static inline bool video_input_start_thread(struct video_input *input,
+		struct video_output *video)
+{
+	input->video        = video;
+	input->queue_size   = video->info.cache_size / 2;
+	input->profile_name = profile_store_name(obs_get_profiler_name_store(),
+			"video_input_thread(%s)", video->info.name);
+
+	if (!input->queue_size)
+		input->queue_size = 1;
+
+	if (os_sem_init(&input->queue_semaphore, 0) != 0)
+		return false;
+	if (pthread_create(&input->thread, NULL, input_thread, input) != 0)
+		return false;
+
+	input->thread_active = true;
+	return true;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static inline bool valid_video_params(const struct video_output_info *info)
@@ -207,8 +404,6 @@ static inline void init_cache(struct video_output *video)
 		video_frame_init(frame, video->info.format,
 				video->info.width, video->info.height);
 	}
-
-	video->available_frames = video->info.cache_size;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -232,8 +427,6 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		goto fail;
-	if (pthread_mutex_init(&out->data_mutex, &attr) != 0)
-		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
@@ -260,14 +453,13 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame*)&video->cache[i]);
 
 	os_sem_destroy(video->update_semaphore);
-	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 	bfree(video);
 }
@@ -277,7 +469,7 @@ static size_t video_get_input_idx(const video_t *video,
 		void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -318,6 +510,13 @@ static inline bool video_input_init(struct video_input *input,
 					input->conversion.height);
 	}
 
+	if (video->info.threaded_inputs &&
+	    !video_input_start_thread(input, video)) {
+		blog(LOG_ERROR, "video_input_init: Failed to create input "
+		                "thread");
+		return false;
+	}
+
 	return true;
 }
 
@@ -334,28 +533,29 @@ bool video_output_connect(video_t *video,
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param    = param;
+		input->callback = callback;
+		input->param    = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format    = video->info.format;
-			input.conversion.width     = video->info.width;
-			input.conversion.height    = video->info.height;
+			input->conversion.format    = video->info.format;
+			input->conversion.width     = video->info.width;
+			input->conversion.height    = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success)
 			da_push_back(video->inputs, &input);
+		else
+			video_input_free(input);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -367,6 +567,8 @@ void video_output_disconnect(video_t *video,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
 {
+	struct video_input *input = NULL;
+
 	if (!video || !callback)
 		return;
 
@@ -374,11 +576,14 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	if (input)
+		video_input_free(input);
 }
 
 bool video_output_active(const video_t *video)
@@ -396,47 +601,40 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
+	long cur_count;
 
 	if (!video) return false;
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	if (video->available_frames == 0) {
-		video->skipped_frames += count;
-		video->cache[video->last_added].count += count;
-		locked = false;
-
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
-
-		cfi = &video->cache[video->last_added];
+	if (queued_frames(video) < video->info.cache_size) {
+		cfi = get_cached_frame(video, video->write_pos);
 		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
+		os_atomic_set_long(&cfi->count, count);
+		os_atomic_set_long(&cfi->refs, 1);
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
-
-		locked = true;
+		return true;
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
+	/* the ring is full, so repeat the last published frame instead if
+	 * video_thread hasn't finished outputting it yet.  otherwise the frame
+	 * is just dropped, and the encoders skip over the timestamp gap */
+	cfi = get_cached_frame(video, video->write_pos - 1);
+	cur_count = os_atomic_load_long(&cfi->count);
 
-	return locked;
+	if (cur_count > 0)
+		os_atomic_compare_swap_long(&cfi->count, cur_count,
+				cur_count + count);
+
+	video->skipped_frames += count;
+	return false;
 }
 
 void video_output_unlock_frame(video_t *video)
 {
 	if (!video) return;
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	video->available_frames--;
+	os_atomic_inc_long(&video->write_pos);
 	os_sem_post(video->update_semaphore);
-
-	pthread_mutex_unlock(&video->data_mutex);
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
@@ -499,3 +697,23 @@ uint32_t video_output_get_total_frames(const video_t *video)
 {
 	return video->total_frames;
 }
+
+uint32_t video_output_get_input_skipped_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	uint32_t skipped = 0;
+
+	if (!video || !callback)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		skipped = video->inputs.array[idx]->skipped_frames;
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return skipped;
+}
@@ -82,6 +82,9 @@ struct video_output_info {
 
 	enum video_colorspace colorspace;
 	enum video_range_type range;
+
+	/* outputs frames to each connected input on its own thread */
+	bool              threaded_inputs;
 };
 
 static inline bool format_is_yuv(enum video_format format)
@@ -180,6 +183,10 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+EXPORT uint32_t video_output_get_input_skipped_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+
 
 #ifdef __cplusplus
 }
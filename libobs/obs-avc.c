@@ -141,6 +141,7 @@ void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 
 	avc_packet->data          = output.bytes.array;
 	avc_packet->size          = output.bytes.num;
+	avc_packet->buf           = NULL;
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
 }
 
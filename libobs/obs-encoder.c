@@ -717,11 +717,16 @@ static inline bool get_sei(const struct obs_encoder *encoder,
 	return false;
 }
 
+static struct encoder_packet_buf *packet_buf_create(size_t size);
+static inline uint8_t *packet_buf_data(struct encoder_packet_buf *buf);
+
+/* the SEI is written directly in to a shared packet buffer in front of the
+ * keyframe data, and every output that is waiting on its first packet gets a
+ * reference to that same buffer */
 static void send_first_video_packet(struct obs_encoder *encoder,
-		struct encoder_callback *cb, struct encoder_packet *packet)
+		struct encoder_callback *cb, struct encoder_packet *packet,
+		struct encoder_packet *first_packet)
 {
-	struct encoder_packet first_packet;
-	DARRAY(uint8_t)       data;
 	uint8_t               *sei;
 	size_t                size;
 
@@ -729,37 +734,63 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
+	if (!first_packet->buf) {
+		*first_packet      = *packet;
+		first_packet->size = size + packet->size;
+		first_packet->buf  = packet_buf_create(first_packet->size);
+		first_packet->data = packet_buf_data(first_packet->buf);
 
-	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+		memcpy(first_packet->data, sei, size);
+		memcpy(first_packet->data + size, packet->data, packet->size);
+	}
 
-	cb->new_packet(cb->param, &first_packet);
+	cb->new_packet(cb->param, first_packet);
 	cb->sent_first_packet = true;
-
-	da_free(data);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
-		struct encoder_callback *cb, struct encoder_packet *packet)
+		struct encoder_callback *cb, struct encoder_packet *packet,
+		struct encoder_packet *first_packet)
 {
 	/* include SEI in first video packet */
 	if (encoder->info.type == OBS_ENCODER_VIDEO && !cb->sent_first_packet)
-		send_first_video_packet(encoder, cb, packet);
+		send_first_video_packet(encoder, cb, packet, first_packet);
 	else
 		cb->new_packet(cb->param, packet);
 }
 
+/* with more than one output, copy the encoder's data in to a shared buffer
+ * once, so that each output only has to add a reference to it */
+static inline void send_packet_to_callbacks(struct obs_encoder *encoder,
+		struct encoder_packet *pkt)
+{
+	struct encoder_packet shared;
+	struct encoder_packet first_packet = {0};
+	bool share = encoder->callbacks.num > 1;
+
+	if (share) {
+		obs_encoder_packet_ref(&shared, pkt);
+		pkt = &shared;
+	}
+
+	for (size_t i = encoder->callbacks.num; i > 0; i--) {
+		struct encoder_callback *cb;
+		cb = encoder->callbacks.array+(i-1);
+		send_packet(encoder, cb, pkt, &first_packet);
+	}
+
+	if (first_packet.buf)
+		obs_encoder_packet_release(&first_packet);
+	if (share)
+		obs_encoder_packet_release(&shared);
+}
+
 static void full_stop(struct obs_encoder *encoder)
 {
 	if (encoder) {
@@ -812,13 +843,7 @@ static inline void do_encode(struct obs_encoder *encoder,
 		pkt.sys_dts_usec = pkt.dts_usec;
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
-
-		for (size_t i = encoder->callbacks.num; i > 0; i--) {
-			struct encoder_callback *cb;
-			cb = encoder->callbacks.array+(i-1);
-			send_packet(encoder, cb, &pkt);
-		}
-
+		send_packet_to_callbacks(encoder, &pkt);
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 	}
 
@@ -826,6 +851,22 @@ static inline void do_encode(struct obs_encoder *encoder,
 }
 
 static const char *receive_video_name = "receive_video";
+/* video-io may drop frames for an encoder that can't keep up, so advance the
+ * pts past any gap in the timestamps to keep it in sync with audio */
+static inline void skip_dropped_frames(struct obs_encoder *encoder,
+		uint64_t timestamp)
+{
+	uint64_t frame_time = video_output_get_frame_time(encoder->media);
+	uint64_t frames = (uint64_t)encoder->cur_pts / encoder->timebase_num;
+	uint64_t expected_ts = encoder->start_ts + frames * frame_time;
+
+	if (timestamp > expected_ts + frame_time / 2) {
+		uint64_t dropped = (timestamp - expected_ts + frame_time / 2) /
+			frame_time;
+		encoder->cur_pts += (int64_t)dropped * encoder->timebase_num;
+	}
+}
+
 static void receive_video(void *param, struct video_data *frame)
 {
 	profile_start(receive_video_name);
@@ -850,6 +891,8 @@ static void receive_video(void *param, struct video_data *frame)
 
 	if (!encoder->start_ts)
 		encoder->start_ts = frame->timestamp;
+	else
+		skip_dropped_frames(encoder, frame->timestamp);
 
 	enc_frame.frames = 1;
 	enc_frame.pts    = encoder->cur_pts;
@@ -1034,19 +1077,196 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 	pthread_mutex_unlock(&encoder->outputs_mutex);
 }
 
-void obs_duplicate_encoder_packet(struct encoder_packet *dst,
+/* ------------------------------------------------------------------------- */
+/* shared packet buffers
+ *
+ * encoded packet data is copied once into a reference counted buffer, which
+ * is then shared by every output (and delay buffer) that the packet goes to.
+ * released buffers are kept in per-size-class free lists so that steady-state
+ * encoding does not have to hit the allocator for every packet. */
+
+#define PACKET_POOL_MIN_SHIFT   12 /* 4 KiB */
+#define PACKET_POOL_CLASSES     12 /* up to 8 MiB */
+#define PACKET_POOL_CLASS_BYTES (8 * 1024 * 1024)
+
+struct encoder_packet_buf {
+	volatile long             refs;
+	int                       size_class;
+	size_t                    capacity;
+	size_t                    size;
+	struct encoder_packet_buf *next;
+};
+
+static pthread_mutex_t packet_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct encoder_packet_buf *packet_pool[PACKET_POOL_CLASSES];
+static size_t packet_pool_free[PACKET_POOL_CLASSES];
+
+/* number of buffers allocated and reused, logged on shutdown */
+static volatile long packet_pool_allocs = 0;
+static volatile long packet_pool_reuses = 0;
+
+static inline uint8_t *packet_buf_data(struct encoder_packet_buf *buf)
+{
+	return (uint8_t*)(buf + 1);
+}
+
+static inline int packet_size_class(size_t size)
+{
+	for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+		if (size <= ((size_t)1 << (PACKET_POOL_MIN_SHIFT + i)))
+			return i;
+	}
+
+	return -1;
+}
+
+static inline size_t packet_pool_max_free(int size_class)
+{
+	size_t capacity = (size_t)1 << (PACKET_POOL_MIN_SHIFT + size_class);
+	size_t max_free = PACKET_POOL_CLASS_BYTES / capacity;
+	return max_free ? max_free : 1;
+}
+
+static struct encoder_packet_buf *packet_buf_create(size_t size)
+{
+	struct encoder_packet_buf *buf = NULL;
+	int size_class = packet_size_class(size);
+	size_t capacity;
+
+	if (size_class >= 0) {
+		pthread_mutex_lock(&packet_pool_mutex);
+		buf = packet_pool[size_class];
+		if (buf) {
+			packet_pool[size_class] = buf->next;
+			packet_pool_free[size_class]--;
+		}
+		pthread_mutex_unlock(&packet_pool_mutex);
+
+		capacity = (size_t)1 << (PACKET_POOL_MIN_SHIFT + size_class);
+	} else {
+		capacity = size;
+	}
+
+	if (!buf) {
+		buf = bmalloc(sizeof(struct encoder_packet_buf) + capacity);
+		buf->size_class = size_class;
+		buf->capacity   = capacity;
+		os_atomic_inc_long(&packet_pool_allocs);
+	} else {
+		os_atomic_inc_long(&packet_pool_reuses);
+	}
+
+	buf->refs = 1;
+	buf->size = size;
+	buf->next = NULL;
+	return buf;
+}
+
+static void packet_buf_release(struct encoder_packet_buf *buf)
+{
+	if (os_atomic_dec_long(&buf->refs) != 0)
+		return;
+
+	if (buf->size_class >= 0) {
+		int size_class = buf->size_class;
+
+		pthread_mutex_lock(&packet_pool_mutex);
+		if (packet_pool_free[size_class] <
+				packet_pool_max_free(size_class)) {
+			buf->next = packet_pool[size_class];
+			packet_pool[size_class] = buf;
+			packet_pool_free[size_class]++;
+			buf = NULL;
+		}
+		pthread_mutex_unlock(&packet_pool_mutex);
+	}
+
+	bfree(buf);
+}
+
+/* the data of a packet only belongs to its buffer if it actually points in to
+ * it; obs_parse_avc_packet and others replace the data of a packet copy */
+static inline bool packet_owns_buf(const struct encoder_packet *packet)
+{
+	uint8_t *start;
+
+	if (!packet->buf || !packet->data)
+		return false;
+
+	start = packet_buf_data(packet->buf);
+	return packet->data >= start &&
+		packet->data + packet->size <= start + packet->buf->size;
+}
+
+void obs_encoder_packet_get_pool_stats(long *allocs, long *reuses)
+{
+	if (allocs)
+		*allocs = os_atomic_load_long(&packet_pool_allocs);
+	if (reuses)
+		*reuses = os_atomic_load_long(&packet_pool_reuses);
+}
+
+void obs_free_encoder_packet_pool(void)
+{
+	blog(LOG_INFO, "Encoder packet buffers: %ld allocated, %ld reused",
+			os_atomic_load_long(&packet_pool_allocs),
+			os_atomic_load_long(&packet_pool_reuses));
+
+	pthread_mutex_lock(&packet_pool_mutex);
+
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		struct encoder_packet_buf *buf = packet_pool[i];
+
+		while (buf) {
+			struct encoder_packet_buf *next = buf->next;
+			bfree(buf);
+			buf = next;
+		}
+
+		packet_pool[i] = NULL;
+		packet_pool_free[i] = 0;
+	}
+
+	pthread_mutex_unlock(&packet_pool_mutex);
+}
+
+void obs_encoder_packet_ref(struct encoder_packet *dst,
 		const struct encoder_packet *src)
 {
 	*dst = *src;
-	dst->data = bmemdup(src->data, src->size);
+
+	if (packet_owns_buf(src)) {
+		os_atomic_inc_long(&src->buf->refs);
+		return;
+	}
+
+	dst->buf  = packet_buf_create(src->size);
+	dst->data = packet_buf_data(dst->buf);
+	if (src->size)
+		memcpy(dst->data, src->data, src->size);
 }
 
-void obs_free_encoder_packet(struct encoder_packet *packet)
+void obs_encoder_packet_release(struct encoder_packet *packet)
 {
-	bfree(packet->data);
+	if (packet_owns_buf(packet))
+		packet_buf_release(packet->buf);
+	else
+		bfree(packet->data);
+
 	memset(packet, 0, sizeof(struct encoder_packet));
 }
 
+void obs_duplicate_encoder_packet(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	obs_encoder_packet_ref(dst, src);
+}
+
+void obs_free_encoder_packet(struct encoder_packet *packet)
+{
+	obs_encoder_packet_release(packet);
+}
+
 void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 		enum video_format format)
 {
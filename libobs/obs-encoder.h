@@ -37,6 +37,8 @@ enum obs_encoder_type {
 	OBS_ENCODER_VIDEO  /**< The encoder provides a video codec */
 };
 
+struct encoder_packet_buf;
+
 /** Encoder output packet */
 struct encoder_packet {
 	uint8_t               *data;        /**< Packet data */
@@ -82,6 +84,13 @@ struct encoder_packet {
 
 	/** Encoder from which the track originated from */
 	obs_encoder_t         *encoder;
+
+	/**
+	 * Shared, reference counted buffer that holds the packet data.
+	 * Managed by obs_encoder_packet_ref and obs_encoder_packet_release;
+	 * encoders should leave this NULL.
+	 */
+	struct encoder_packet_buf *buf;
 };
 
 /** Encoder input frame */
@@ -0,0 +1,107 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/circlebuf.h"
+#include "util/darray.h"
+#include "obs.h"
+
+/*
+ * Per-track interleave queues used by outputs once interleaving has started:
+ * queue 0 holds video, queue 1 + n holds audio track n.  Each queue is kept
+ * in dts order, and the next packet to send is the earliest of the first
+ * packets of each queue.
+ */
+
+#define INTERLEAVE_QUEUES (MAX_AUDIO_MIXES + 1)
+
+struct interleaved_packet {
+	struct encoder_packet packet;
+	uint64_t              seq;
+};
+
+static inline struct circlebuf *get_interleave_queue(struct circlebuf *queues,
+		const struct encoder_packet *packet)
+{
+	return (packet->type == OBS_ENCODER_VIDEO) ?
+		&queues[0] : &queues[1 + packet->track_idx];
+}
+
+/* packets are ordered by dts, and packets with the same dts stay in the
+ * order they were queued in */
+static inline bool interleaved_before(const struct interleaved_packet *a,
+		const struct interleaved_packet *b)
+{
+	if (a->packet.dts_usec != b->packet.dts_usec)
+		return a->packet.dts_usec < b->packet.dts_usec;
+	return a->seq < b->seq;
+}
+
+static inline void queue_interleaved_packet(struct circlebuf *queues,
+		uint64_t *seq, struct encoder_packet *out)
+{
+	struct circlebuf *queue = get_interleave_queue(queues, out);
+	struct interleaved_packet item = {*out, (*seq)++};
+	DARRAY(struct interleaved_packet) later;
+
+	da_init(later);
+
+	/* each track is normally already in dts order, so this almost never
+	 * has to move anything */
+	while (queue->size) {
+		struct interleaved_packet back;
+		circlebuf_peek_back(queue, &back, sizeof(back));
+		if (back.packet.dts_usec <= out->dts_usec)
+			break;
+
+		circlebuf_pop_back(queue, NULL, sizeof(back));
+		da_push_back(later, &back);
+	}
+
+	circlebuf_push_back(queue, &item, sizeof(item));
+
+	for (size_t i = later.num; i > 0; i--)
+		circlebuf_push_back(queue, &later.array[i - 1], sizeof(item));
+
+	da_free(later);
+}
+
+/* the next packet to send is the earliest of the first packets of each
+ * track's queue, returns NULL if all queues are empty */
+static inline struct circlebuf *get_next_interleave_queue(
+		struct circlebuf *queues)
+{
+	struct circlebuf *next_queue = NULL;
+	struct interleaved_packet *next = NULL;
+
+	for (size_t i = 0; i < INTERLEAVE_QUEUES; i++) {
+		struct circlebuf *queue = &queues[i];
+		struct interleaved_packet *first;
+
+		if (!queue->size)
+			continue;
+
+		first = circlebuf_data(queue, 0);
+		if (!next || interleaved_before(first, next)) {
+			next_queue = queue;
+			next = first;
+		}
+	}
+
+	return next_queue;
+}
@@ -24,6 +24,7 @@
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
+#include "util/task-pool.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
 
@@ -251,6 +252,7 @@ struct obs_core_video {
 	bool                            thread_initialized;
 
 	bool                            gpu_conversion;
+	uint32_t                        conversion_threads;
 	const char                      *conversion_tech;
 	uint32_t                        conversion_height;
 	uint32_t                        plane_offsets[3];
@@ -371,6 +373,9 @@ struct obs_core {
 	bool                            name_store_owned;
 	profiler_name_store_t           *name_store;
 
+	/* worker threads for splitting CPU-side frame conversion/copies */
+	task_pool_t                     *task_pool;
+
 	/* segmented into multiple sub-structures to keep things a bit more
 	 * clean and organized */
 	struct obs_core_video           video;
@@ -383,6 +388,32 @@ extern struct obs_core *obs;
 
 extern void *obs_video_thread(void *param);
 
+#define MIN_SLICE_ROWS 64
+#define MAX_CONVERSION_THREADS 64
+
+/* number of row slices to split CPU-side frame work of a given height into */
+static inline size_t obs_get_slice_count(uint32_t height)
+{
+	size_t slices = obs->video.conversion_threads;
+	size_t max_slices = height / MIN_SLICE_ROWS;
+
+	if (!slices)
+		slices = task_pool_threads(obs->task_pool) + 1;
+	if (slices > max_slices)
+		slices = max_slices;
+
+	return slices ? slices : 1;
+}
+
+/* rows of a slice, kept on even boundaries for subsampled chroma planes */
+static inline void obs_get_slice_rows(uint32_t height, size_t slices,
+		size_t idx, uint32_t *start_y, uint32_t *end_y)
+{
+	*start_y = (uint32_t)((uint64_t)height * idx / slices) & ~1U;
+	*end_y = (idx + 1 == slices) ? height :
+		(uint32_t)((uint64_t)height * (idx + 1) / slices) & ~1U;
+}
+
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
 extern bool audio_callback(void *param,
@@ -573,6 +604,8 @@ struct obs_source {
 	struct obs_audio_data           audio_data;
 	size_t                          audio_storage_size;
 	uint32_t                        audio_mixers;
+	/* mixes whose output buffers are known to contain only silence */
+	uint32_t                        audio_silent_mixes;
 	float                           user_volume;
 	float                           volume;
 	int64_t                         sync_offset;
@@ -596,6 +629,11 @@ struct obs_source {
 	DARRAY(struct async_frame)      async_cache;
 	DARRAY(struct obs_source_frame*)async_frames;
 	pthread_mutex_t                 async_mutex;
+	os_event_t                      *async_space_event;
+	bool                            async_space_waiting;
+	enum obs_async_drop_policy      async_drop_policy;
+	uint32_t                        async_block_timeout_ms;
+	uint32_t                        async_dropped_frames;
 	uint32_t                        async_width;
 	uint32_t                        async_height;
 	uint32_t                        async_cache_width;
@@ -758,12 +796,23 @@ enum delay_msg {
 	DELAY_MSG_PACKET,
 	DELAY_MSG_START,
 	DELAY_MSG_STOP,
+
+	/* a packet that could not be read back from disk in time.  this can
+	 * be a keyframe, so video is then dropped until the next keyframe */
+	DELAY_MSG_DROPPED,
 };
 
+struct delay_segment;
+struct delay_spill;
+
 struct delay_data {
 	enum delay_msg msg;
 	uint64_t ts;
 	struct encoder_packet packet;
+
+	/* if set, packet data is handled by the delay disk thread, and
+	 * packet only holds the packet info */
+	struct delay_spill *spill;
 };
 
 typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
@@ -793,6 +842,12 @@ struct obs_output {
 	os_event_t                      *stopping_event;
 	pthread_mutex_t                 interleaved_mutex;
 	DARRAY(struct encoder_packet)   interleaved_packets;
+
+	/* once interleaving has started, packets are kept in one queue per
+	 * track (video, then each audio mix), each ordered by dts, and the
+	 * queues are merged when sending */
+	struct circlebuf                interleave_queues[MAX_AUDIO_MIXES + 1];
+	uint64_t                        interleave_seq;
 	int                             stop_code;
 
 	int                             reconnect_retry_sec;
@@ -832,7 +887,20 @@ struct obs_output {
 	uint64_t                        active_delay_ns;
 	encoded_callback_t              delay_callback;
 	struct circlebuf                delay_data; /* struct delay_data */
+	DARRAY(struct delay_segment*)   delay_segments;
+	uint64_t                        delay_memory_bytes;
+	uint64_t                        delay_disk_bytes;
 	pthread_mutex_t                 delay_mutex;
+	pthread_mutex_t                 delay_disk_mutex;
+	pthread_t                       delay_disk_thread;
+	os_sem_t                        *delay_disk_sem;
+	bool                            delay_disk_thread_active;
+	volatile bool                   delay_disk_stop;
+	struct circlebuf                delay_disk_writes; /* delay_spill* */
+	struct circlebuf                delay_disk_reads;  /* delay_spill* */
+	bool                            delay_video_resync;
+	volatile long                   delay_dropped_packets;
+	volatile long                   delay_dropped_frames;
 	uint32_t                        delay_sec;
 	uint32_t                        delay_flags;
 	uint32_t                        delay_cur_flags;
@@ -957,6 +1025,8 @@ extern void obs_encoder_remove_output(struct obs_encoder *encoder,
 
 void obs_encoder_destroy(obs_encoder_t *encoder);
 
+extern void obs_free_encoder_packet_pool(void);
+
 /* ------------------------------------------------------------------------- */
 /* services */
 
@@ -28,16 +28,417 @@ static inline bool delay_capturing(const struct obs_output *output)
 	return os_atomic_load_bool(&output->delay_capturing);
 }
 
+/* packet data beyond this amount is written to disk when the disk flag is
+ * set, so only a small window of the delay is kept in memory */
+#define DELAY_MEMORY_WINDOW (16 * 1024 * 1024)
+#define DELAY_SEGMENT_SIZE  (64 * 1024 * 1024)
+
+/* how much spilled data the disk thread reads back ahead of it being due */
+#define DELAY_READ_AHEAD    (8 * 1024 * 1024)
+
+/*
+ * All file I/O for spilled packets happens on the output's delay disk
+ * thread, so a slow disk never blocks the encoder threads while they hold
+ * the delay mutex.  Packets stay in memory until the thread has written
+ * them, and are read back in order ahead of becoming due.  A packet that is
+ * due but not back in memory yet is dropped (see DELAY_MSG_DROPPED).
+ *
+ * The spill state and segment packet counts are protected by the delay disk
+ * mutex.  The segment list and files are only touched by the disk thread.
+ */
+
+struct delay_segment {
+	FILE    *file;
+	int64_t size;
+	size_t  packets;
+};
+
+struct delay_spill {
+	/* data is NULL while the packet is only on disk */
+	struct encoder_packet packet;
+	struct delay_segment  *segment;
+	int64_t               offset;
+
+	/* the disk thread is using the spill outside of the mutex, so it
+	 * frees the spill if it gets consumed in the meantime */
+	bool                  writing;
+	bool                  loading;
+	bool                  consumed;
+	bool                  failed;
+};
+
+static inline void free_spill(struct delay_spill *spill)
+{
+	obs_encoder_packet_release(&spill->packet);
+	bfree(spill);
+}
+
+static void free_delay_segments(struct obs_output *output)
+{
+	for (size_t i = 0; i < output->delay_segments.num; i++) {
+		struct delay_segment *segment = output->delay_segments.array[i];
+		fclose(segment->file);
+		bfree(segment);
+	}
+
+	da_free(output->delay_segments);
+	output->delay_memory_bytes = 0;
+	output->delay_disk_bytes = 0;
+}
+
+static struct delay_segment *get_write_segment(struct obs_output *output,
+		size_t size)
+{
+	size_t num = output->delay_segments.num;
+	struct delay_segment *segment = NULL;
+	FILE *file;
+
+	if (num)
+		segment = output->delay_segments.array[num - 1];
+	if (segment && segment->size + (int64_t)size <= DELAY_SEGMENT_SIZE)
+		return segment;
+
+	file = tmpfile();
+	if (!file) {
+		blog(LOG_WARNING, "Output '%s': Failed to create delay "
+		                  "segment file, keeping delay data in memory",
+		                  output->context.name);
+		return NULL;
+	}
+
+	segment = bzalloc(sizeof(*segment));
+	segment->file = file;
+	da_push_back(output->delay_segments, &segment);
+	return segment;
+}
+
+/* disk thread: writes the oldest queued spill, returns false if there was
+ * nothing to write */
+static bool write_next_spill(struct obs_output *output)
+{
+	struct delay_spill *spill;
+	struct delay_segment *segment;
+	struct encoder_packet packet;
+	struct encoder_packet written = {0};
+	bool success;
+
+	pthread_mutex_lock(&output->delay_disk_mutex);
+	if (!output->delay_disk_writes.size) {
+		pthread_mutex_unlock(&output->delay_disk_mutex);
+		return false;
+	}
+
+	circlebuf_pop_front(&output->delay_disk_writes, &spill, sizeof(spill));
+	obs_encoder_packet_ref(&packet, &spill->packet);
+	pthread_mutex_unlock(&output->delay_disk_mutex);
+
+	segment = get_write_segment(output, packet.size);
+	success = segment &&
+		os_fseeki64(segment->file, segment->size, SEEK_SET) == 0 &&
+		fwrite(packet.data, 1, packet.size, segment->file) ==
+			packet.size;
+
+	if (segment && !success)
+		blog(LOG_WARNING, "Output '%s': Failed to write delay data to "
+		                  "disk, keeping it in memory",
+		                  output->context.name);
+
+	obs_encoder_packet_release(&packet);
+
+	pthread_mutex_lock(&output->delay_disk_mutex);
+	spill->writing = false;
+
+	if (spill->consumed) {
+		pthread_mutex_unlock(&output->delay_disk_mutex);
+		free_spill(spill);
+		return true;
+	}
+
+	if (success) {
+		spill->segment = segment;
+		spill->offset = segment->size;
+		segment->packets++;
+
+		written = spill->packet;
+		spill->packet.data = NULL;
+		spill->packet.buf = NULL;
+	} else {
+		spill->failed = true;
+	}
+	pthread_mutex_unlock(&output->delay_disk_mutex);
+
+	if (success)
+		segment->size += packet.size;
+
+	obs_encoder_packet_release(&written);
+	return true;
+}
+
+/* disk thread: finds the oldest spill that needs to be read back, as long
+ * as less than DELAY_READ_AHEAD bytes are already back in memory.  must be
+ * called with the delay disk mutex held */
+static struct delay_spill *get_next_load(struct obs_output *output)
+{
+	size_t count = output->delay_disk_reads.size /
+		sizeof(struct delay_spill*);
+	size_t ahead = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		struct delay_spill *spill = *(struct delay_spill**)
+			circlebuf_data(&output->delay_disk_reads,
+					i * sizeof(struct delay_spill*));
+
+		if (ahead >= DELAY_READ_AHEAD)
+			break;
+
+		if (spill->packet.data || spill->failed || spill->writing) {
+			ahead += spill->packet.size;
+			continue;
+		}
+
+		return spill;
+	}
+
+	return NULL;
+}
+
+/* disk thread: reads spilled packets back into memory before they are
+ * due */
+static void read_ahead(struct obs_output *output)
+{
+	for (;;) {
+		struct delay_spill *spill;
+		struct delay_segment *segment;
+		int64_t offset;
+		size_t size;
+		uint8_t *data;
+		bool success;
+
+		pthread_mutex_lock(&output->delay_disk_mutex);
+		spill = get_next_load(output);
+		if (spill) {
+			spill->loading = true;
+			segment = spill->segment;
+			offset = spill->offset;
+			size = spill->packet.size;
+		}
+		pthread_mutex_unlock(&output->delay_disk_mutex);
+
+		if (!spill)
+			break;
+
+		data = bmalloc(size);
+		success = os_fseeki64(segment->file, offset, SEEK_SET) == 0 &&
+			fread(data, 1, size, segment->file) == size;
+
+		if (!success)
+			blog(LOG_WARNING, "Output '%s': Failed to read delay "
+			                  "data from disk",
+			                  output->context.name);
+
+		pthread_mutex_lock(&output->delay_disk_mutex);
+		spill->loading = false;
+
+		if (spill->consumed) {
+			pthread_mutex_unlock(&output->delay_disk_mutex);
+			bfree(data);
+			free_spill(spill);
+			continue;
+		}
+
+		if (success) {
+			spill->packet.data = data;
+			data = NULL;
+		} else {
+			spill->failed = true;
+		}
+		pthread_mutex_unlock(&output->delay_disk_mutex);
+
+		bfree(data);
+	}
+}
+
+/* disk thread: closes segments that have been fully consumed.  the last
+ * segment is rewound rather than freed so it can continue to be written
+ * to */
+static void free_consumed_segments(struct obs_output *output)
+{
+	for (;;) {
+		struct delay_segment *closed = NULL;
+		size_t last = output->delay_segments.num - 1;
+
+		pthread_mutex_lock(&output->delay_disk_mutex);
+		for (size_t i = 0; i < output->delay_segments.num; i++) {
+			struct delay_segment *segment =
+				output->delay_segments.array[i];
+
+			if (segment->packets || segment->size == 0)
+				continue;
+
+			if (i != last) {
+				da_erase(output->delay_segments, i);
+				closed = segment;
+				break;
+			}
+
+			segment->size = 0;
+		}
+		pthread_mutex_unlock(&output->delay_disk_mutex);
+
+		if (!closed)
+			break;
+
+		fclose(closed->file);
+		bfree(closed);
+	}
+}
+
+static void *delay_disk_thread(void *data)
+{
+	struct obs_output *output = data;
+
+	os_set_thread_name("obs-output: delay disk thread");
+
+	while (os_sem_wait(output->delay_disk_sem) == 0) {
+		if (os_atomic_load_bool(&output->delay_disk_stop))
+			break;
+
+		while (write_next_spill(output));
+		read_ahead(output);
+		free_consumed_segments(output);
+	}
+
+	return NULL;
+}
+
+/* must be called with the delay mutex held */
+static bool start_delay_disk_thread(struct obs_output *output)
+{
+	if (output->delay_disk_thread_active)
+		return true;
+
+	if (os_sem_init(&output->delay_disk_sem, 0) != 0)
+		return false;
+
+	os_atomic_set_bool(&output->delay_disk_stop, false);
+
+	if (pthread_create(&output->delay_disk_thread, NULL,
+				delay_disk_thread, output) != 0) {
+		blog(LOG_WARNING, "Output '%s': Failed to create delay disk "
+		                  "thread, keeping delay data in memory",
+		                  output->context.name);
+		os_sem_destroy(output->delay_disk_sem);
+		output->delay_disk_sem = NULL;
+		return false;
+	}
+
+	output->delay_disk_thread_active = true;
+	return true;
+}
+
+static void stop_delay_disk_thread(struct obs_output *output)
+{
+	if (!output->delay_disk_thread_active)
+		return;
+
+	os_atomic_set_bool(&output->delay_disk_stop, true);
+	os_sem_post(output->delay_disk_sem);
+	pthread_join(output->delay_disk_thread, NULL);
+
+	os_sem_destroy(output->delay_disk_sem);
+	output->delay_disk_sem = NULL;
+	output->delay_disk_thread_active = false;
+}
+
+/* must be called with the delay mutex held */
+static bool spill_packet(struct obs_output *output, struct delay_data *dd,
+		struct encoder_packet *packet)
+{
+	struct delay_spill *spill;
+
+	if (!start_delay_disk_thread(output))
+		return false;
+
+	spill = bzalloc(sizeof(*spill));
+	spill->writing = true;
+	obs_encoder_packet_ref(&spill->packet, packet);
+
+	dd->packet = *packet;
+	dd->packet.data = NULL;
+	dd->packet.buf = NULL;
+	dd->spill = spill;
+
+	pthread_mutex_lock(&output->delay_disk_mutex);
+	circlebuf_push_back(&output->delay_disk_writes, &spill, sizeof(spill));
+	circlebuf_push_back(&output->delay_disk_reads, &spill, sizeof(spill));
+	pthread_mutex_unlock(&output->delay_disk_mutex);
+
+	output->delay_disk_bytes += packet->size;
+	os_sem_post(output->delay_disk_sem);
+	return true;
+}
+
+/* must be called with the delay mutex held.  spills are consumed in order,
+ * so the spill is always the front of the read queue.  returns false if the
+ * packet is not back in memory yet, in which case it is dropped */
+static bool take_spilled_packet(struct obs_output *output,
+		struct delay_data *dd)
+{
+	struct delay_spill *spill = dd->spill;
+	bool busy;
+	bool success;
+
+	pthread_mutex_lock(&output->delay_disk_mutex);
+	circlebuf_pop_front(&output->delay_disk_reads, NULL, sizeof(spill));
+
+	spill->consumed = true;
+	if (spill->segment)
+		spill->segment->packets--;
+
+	success = spill->packet.data != NULL;
+	if (success) {
+		dd->packet = spill->packet;
+		memset(&spill->packet, 0, sizeof(spill->packet));
+	}
+
+	busy = spill->writing || spill->loading;
+	pthread_mutex_unlock(&output->delay_disk_mutex);
+
+	output->delay_disk_bytes -= dd->packet.size;
+	dd->spill = NULL;
+
+	if (!busy)
+		free_spill(spill);
+
+	/* let the disk thread read further ahead and free segments */
+	os_sem_post(output->delay_disk_sem);
+
+	if (!success)
+		blog(LOG_WARNING, "Output '%s': Delay data was not read back "
+		                  "from disk in time, dropping packet",
+		                  output->context.name);
+	return success;
+}
+
 static inline void push_packet(struct obs_output *output,
 		struct encoder_packet *packet, uint64_t t)
 {
 	struct delay_data dd = {0};
+	bool use_disk;
 
 	dd.msg = DELAY_MSG_PACKET;
 	dd.ts  = t;
-	obs_duplicate_encoder_packet(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
+
+	use_disk = (output->delay_cur_flags & OBS_OUTPUT_DELAY_DISK) != 0 &&
+		output->delay_memory_bytes + packet->size > DELAY_MEMORY_WINDOW;
+
+	if (!use_disk || !spill_packet(output, &dd, packet)) {
+		obs_encoder_packet_ref(&dd.packet, packet);
+		output->delay_memory_bytes += packet->size;
+	}
+
 	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
 	pthread_mutex_unlock(&output->delay_mutex);
 }
@@ -48,7 +449,7 @@ static inline void process_delay_data(struct obs_output *output,
 	switch (dd->msg) {
 	case DELAY_MSG_PACKET:
 		if (!delay_active(output) || !delay_capturing(output))
-			obs_free_encoder_packet(&dd->packet);
+			obs_encoder_packet_release(&dd->packet);
 		else
 			output->delay_callback(output, &dd->packet);
 		break;
@@ -58,24 +459,93 @@ static inline void process_delay_data(struct obs_output *output,
 	case DELAY_MSG_STOP:
 		obs_output_actual_stop(output, false, dd->ts);
 		break;
+	case DELAY_MSG_DROPPED:
+		break;
 	}
 }
 
 void obs_output_cleanup_delay(obs_output_t *output)
 {
 	struct delay_data dd;
+	struct delay_spill *spill;
+
+	stop_delay_disk_thread(output);
+
+	if (os_atomic_load_long(&output->delay_dropped_packets))
+		blog(LOG_INFO, "Output '%s': %ld delayed packets (%ld video "
+		               "frames) were dropped because the disk could "
+		               "not keep up",
+		               output->context.name,
+		               os_atomic_load_long(
+				       &output->delay_dropped_packets),
+		               os_atomic_load_long(
+				       &output->delay_dropped_frames));
+
+	/* spills that were consumed while being written are owned by the
+	 * write queue, all others are freed through the delay queue */
+	while (output->delay_disk_writes.size) {
+		circlebuf_pop_front(&output->delay_disk_writes, &spill,
+				sizeof(spill));
+		if (spill->consumed)
+			free_spill(spill);
+	}
 
 	while (output->delay_data.size) {
 		circlebuf_pop_front(&output->delay_data, &dd, sizeof(dd));
 		if (dd.msg == DELAY_MSG_PACKET) {
-			obs_free_encoder_packet(&dd.packet);
+			if (dd.spill)
+				free_spill(dd.spill);
+			else
+				obs_encoder_packet_release(&dd.packet);
 		}
 	}
 
+	circlebuf_free(&output->delay_disk_writes);
+	circlebuf_free(&output->delay_disk_reads);
+	free_delay_segments(output);
+
+	output->delay_video_resync = false;
 	output->active_delay_ns = 0;
+	os_atomic_set_long(&output->delay_dropped_packets, 0);
+	os_atomic_set_long(&output->delay_dropped_frames, 0);
 	os_atomic_set_long(&output->delay_restart_refs, 0);
 }
 
+/* must be called with the delay mutex held.  once a video packet has been
+ * dropped, video is dropped until the next keyframe so the output never
+ * receives frames that depend on missing data */
+static inline void resync_video(struct obs_output *output,
+		struct delay_data *dd)
+{
+	if (dd->packet.type != OBS_ENCODER_VIDEO)
+		return;
+
+	if (dd->msg == DELAY_MSG_DROPPED) {
+		output->delay_video_resync = true;
+
+	} else if (output->delay_video_resync) {
+		if (dd->packet.keyframe) {
+			output->delay_video_resync = false;
+		} else {
+			obs_encoder_packet_release(&dd->packet);
+			dd->msg = DELAY_MSG_DROPPED;
+		}
+	}
+}
+
+/* dropped video packets count towards the output's dropped frames, see
+ * obs_output_get_frames_dropped */
+static inline void count_dropped(struct obs_output *output,
+		const struct delay_data *dd)
+{
+	if (dd->msg != DELAY_MSG_DROPPED)
+		return;
+
+	os_atomic_inc_long(&output->delay_dropped_packets);
+	if (dd->packet.type == OBS_ENCODER_VIDEO)
+		os_atomic_inc_long(&output->delay_dropped_frames);
+}
+
 static inline bool pop_packet(struct obs_output *output, uint64_t t)
 {
 	uint64_t elapsed_time;
@@ -100,6 +570,17 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 			circlebuf_pop_front(&output->delay_data, NULL,
 					sizeof(dd));
 			popped = true;
+
+			if (dd.msg == DELAY_MSG_PACKET) {
+				if (!dd.spill)
+					output->delay_memory_bytes -=
+						dd.packet.size;
+				else if (!take_spilled_packet(output, &dd))
+					dd.msg = DELAY_MSG_DROPPED;
+
+				resync_video(output, &dd);
+				count_dropped(output, &dd);
+			}
 		}
 	}
 
@@ -208,3 +689,22 @@ uint32_t obs_output_get_active_delay(const obs_output_t *output)
 	return obs_output_valid(output, "obs_output_set_delay") ?
 		(uint32_t)(output->active_delay_ns / 1000000000ULL) : 0;
 }
+
+void obs_output_get_delay_usage(const obs_output_t *output,
+		uint64_t *memory_bytes, uint64_t *disk_bytes)
+{
+	uint64_t memory = 0;
+	uint64_t disk = 0;
+
+	if (obs_output_valid(output, "obs_output_get_delay_usage")) {
+		pthread_mutex_lock((pthread_mutex_t*)&output->delay_mutex);
+		memory = output->delay_memory_bytes;
+		disk = output->delay_disk_bytes;
+		pthread_mutex_unlock((pthread_mutex_t*)&output->delay_mutex);
+	}
+
+	if (memory_bytes)
+		*memory_bytes = memory;
+	if (disk_bytes)
+		*disk_bytes = disk;
+}
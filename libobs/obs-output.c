@@ -19,6 +19,7 @@
 #include "util/platform.h"
 #include "obs.h"
 #include "obs-internal.h"
+#include "obs-interleave.h"
 
 static inline bool active(const struct obs_output *output)
 {
@@ -99,11 +100,14 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	output = bzalloc(sizeof(struct obs_output));
 	pthread_mutex_init_value(&output->interleaved_mutex);
 	pthread_mutex_init_value(&output->delay_mutex);
+	pthread_mutex_init_value(&output->delay_disk_mutex);
 
 	if (pthread_mutex_init(&output->interleaved_mutex, NULL) != 0)
 		goto fail;
 	if (pthread_mutex_init(&output->delay_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&output->delay_disk_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&output->stopping_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 	if (!init_output_handlers(output, name, settings, hotkey_data))
@@ -157,8 +161,21 @@ fail:
 static inline void free_packets(struct obs_output *output)
 {
 	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_free_encoder_packet(output->interleaved_packets.array+i);
+		obs_encoder_packet_release(output->interleaved_packets.array+i);
 	da_free(output->interleaved_packets);
+
+	for (size_t i = 0; i < INTERLEAVE_QUEUES; i++) {
+		struct circlebuf *queue = &output->interleave_queues[i];
+
+		while (queue->size) {
+			struct interleaved_packet item;
+			circlebuf_pop_front(queue, &item, sizeof(item));
+			obs_encoder_packet_release(&item.packet);
+		}
+		circlebuf_free(queue);
+	}
+
+	output->interleave_seq = 0;
 }
 
 void obs_output_destroy(obs_output_t *output)
@@ -200,7 +217,10 @@ void obs_output_destroy(obs_output_t *output)
 		pthread_mutex_destroy(&output->delay_mutex);
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
+		obs_output_cleanup_delay(output);
+		pthread_mutex_destroy(&output->delay_disk_mutex);
 		circlebuf_free(&output->delay_data);
+		da_free(output->delay_segments);
 		if (output->owns_info_id)
 			bfree((void*)output->info.id);
 		bfree(output);
@@ -663,14 +683,39 @@ uint64_t obs_output_get_total_bytes(const obs_output_t *output)
 	return output->info.get_total_bytes(output->context.data);
 }
 
+float obs_output_get_congestion(const obs_output_t *output)
+{
+	float congestion;
+
+	if (!obs_output_valid(output, "obs_output_get_congestion"))
+		return 0.0f;
+	if (!output->info.get_congestion || !active(output))
+		return 0.0f;
+
+	congestion = output->info.get_congestion(output->context.data);
+	if (congestion < 0.0f)
+		congestion = 0.0f;
+	else if (congestion > 1.0f)
+		congestion = 1.0f;
+	return congestion;
+}
+
 int obs_output_get_frames_dropped(const obs_output_t *output)
 {
+	int dropped;
+
 	if (!obs_output_valid(output, "obs_output_get_frames_dropped"))
 		return 0;
-	if (!output->info.get_dropped_frames)
-		return 0;
 
-	return output->info.get_dropped_frames(output->context.data);
+	/* frames the delay dropped because they couldn't be read back from
+	 * disk in time never reach the output */
+	dropped = (int)os_atomic_load_long(&output->delay_dropped_frames);
+
+	if (output->info.get_dropped_frames)
+		dropped += output->info.get_dropped_frames(
+				output->context.data);
+
+	return dropped;
 }
 
 int obs_output_get_total_frames(const obs_output_t *output)
@@ -944,20 +989,27 @@ static inline bool has_higher_opposing_ts(struct obs_output *output,
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct circlebuf *queue =
+		get_next_interleave_queue(output->interleave_queues);
+	struct interleaved_packet item;
+
+	if (!queue)
+		return;
+
+	circlebuf_peek_front(queue, &item, sizeof(item));
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timstamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!has_higher_opposing_ts(output, &item.packet))
 		return;
 
-	if (out.type == OBS_ENCODER_VIDEO)
+	if (item.packet.type == OBS_ENCODER_VIDEO)
 		output->total_frames++;
 
-	da_erase(output->interleaved_packets, 0);
-	output->info.encoded_packet(output->context.data, &out);
-	obs_free_encoder_packet(&out);
+	circlebuf_pop_front(queue, NULL, sizeof(item));
+	output->info.encoded_packet(output->context.data, &item.packet);
+	obs_encoder_packet_release(&item.packet);
 }
 
 static inline void set_higher_ts(struct obs_output *output,
@@ -1056,7 +1108,7 @@ static void discard_to_idx(struct obs_output *output, size_t idx)
 	for (size_t i = 0; i < idx; i++) {
 		struct encoder_packet *packet =
 			&output->interleaved_packets.array[i];
-		obs_free_encoder_packet(packet);
+		obs_encoder_packet_release(packet);
 	}
 
 	da_erase_range(output->interleaved_packets, 0, idx);
@@ -1251,18 +1303,17 @@ static inline void insert_interleaved_packet(struct obs_output *output,
 	da_insert(output->interleaved_packets, idx, out);
 }
 
-static void resort_interleaved_packets(struct obs_output *output)
+/* moves the starting packets in to the per-track queues once their offsets
+ * have been applied.  packets are queued in their current order, so packets
+ * that end up with the same dts keep their relative order */
+static void start_interleave_queues(struct obs_output *output)
 {
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-			sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
+	for (size_t i = 0; i < output->interleaved_packets.num; i++)
+		queue_interleaved_packet(output->interleave_queues,
+				&output->interleave_seq,
+				&output->interleaved_packets.array[i]);
 
-	da_free(old_array);
+	da_free(output->interleaved_packets);
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
@@ -1304,7 +1355,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 		pthread_mutex_unlock(&output->interleaved_mutex);
 
 		if (output->active_delay_ns)
-			obs_free_encoder_packet(packet);
+			obs_encoder_packet_release(packet);
 		return;
 	}
 
@@ -1313,14 +1364,17 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_duplicate_encoder_packet(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
-	if (was_started)
+	if (was_started) {
 		apply_interleaved_packet_offset(output, &out);
-	else
+		queue_interleaved_packet(output->interleave_queues,
+				&output->interleave_seq, &out);
+	} else {
 		check_received(output, packet);
+		insert_interleaved_packet(output, &out);
+	}
 
-	insert_interleaved_packet(output, &out);
 	set_higher_ts(output, &out);
 
 	/* when both video and audio have been received, we're ready
@@ -1329,7 +1383,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
 				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+					start_interleave_queues(output);
 					send_interleaved(output);
 				}
 			}
@@ -1356,7 +1410,7 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 	}
 
 	if (output->active_delay_ns)
-		obs_free_encoder_packet(packet);
+		obs_encoder_packet_release(packet);
 }
 
 static void default_raw_video_callback(void *param, struct video_data *frame)
@@ -64,6 +64,12 @@ struct obs_output_info {
 
 	void *type_data;
 	void (*free_type_data)(void *type_data);
+
+	/**
+	 * Returns how congested the output's connection currently is, from
+	 * 0.0 (not at all) to 1.0 (fully saturated)
+	 */
+	float (*get_congestion)(void *data);
 };
 
 EXPORT void obs_register_output_s(const struct obs_output_info *info,
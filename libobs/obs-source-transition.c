@@ -779,6 +779,8 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 
 		if ((mixers & (1 << mix_idx)) == 0)
 			continue;
+		if ((child->audio_silent_mixes & (1 << mix_idx)) != 0)
+			continue;
 
 		for (size_t ch = 0; ch < channels; ch++) {
 			float *out = output->data[ch];
@@ -20,6 +20,7 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-math.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "callback/calldata.h"
@@ -132,6 +133,8 @@ static inline bool is_composite_source(const struct obs_source *source)
 
 extern char *find_libobs_data_file(const char *file);
 
+#define DEFAULT_ASYNC_BLOCK_TIMEOUT_MS 100
+
 /* internal initialization */
 bool obs_source_init(struct obs_source *source)
 {
@@ -162,6 +165,8 @@ bool obs_source_init(struct obs_source *source)
 		return false;
 	if (pthread_mutex_init(&source->async_mutex, NULL) != 0)
 		return false;
+	if (os_event_init(&source->async_space_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
 
 	if (is_audio_source(source) || is_composite_source(source))
 		allocate_audio_output_buffer(source);
@@ -173,6 +178,7 @@ bool obs_source_init(struct obs_source *source)
 
 	source->control = bzalloc(sizeof(obs_weak_source_t));
 	source->deinterlace_top_first = true;
+	source->async_block_timeout_ms = DEFAULT_ASYNC_BLOCK_TIMEOUT_MS;
 	source->control->source = source;
 	source->audio_mixers = 0xF;
 
@@ -542,6 +548,7 @@ void obs_source_destroy(struct obs_source *source)
 	pthread_mutex_destroy(&source->audio_cb_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
+	os_event_destroy(source->async_space_event);
 	obs_context_data_free(&source->context);
 
 	if (source->owns_info_id)
@@ -949,6 +956,9 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		}
 
 		source->last_sys_timestamp = sys_time;
+
+		if (source->async_space_waiting)
+			os_event_signal(source->async_space_event);
 		pthread_mutex_unlock(&source->async_mutex);
 	}
 
@@ -2071,45 +2081,53 @@ static inline void copy_frame_data_line(struct obs_source_frame *dst,
 
 static inline void copy_frame_data_plane(struct obs_source_frame *dst,
 		const struct obs_source_frame *src,
-		uint32_t plane, uint32_t lines)
+		uint32_t plane, uint32_t start_y, uint32_t end_y)
 {
-	if (dst->linesize[plane] != src->linesize[plane])
-		for (uint32_t y = 0; y < lines; y++)
+	uint32_t linesize = dst->linesize[plane];
+
+	if (linesize != src->linesize[plane])
+		for (uint32_t y = start_y; y < end_y; y++)
 			copy_frame_data_line(dst, src, plane, y);
 	else
-		memcpy(dst->data[plane], src->data[plane],
-				dst->linesize[plane] * lines);
+		memcpy(dst->data[plane] + start_y * linesize,
+				src->data[plane] + start_y * linesize,
+				linesize * (end_y - start_y));
 }
 
-static void copy_frame_data(struct obs_source_frame *dst,
-		const struct obs_source_frame *src)
+struct frame_copy_slices {
+	struct obs_source_frame         *dst;
+	const struct obs_source_frame   *src;
+	size_t                          count;
+};
+
+static void copy_frame_data_slice(void *param, size_t idx)
 {
-	dst->flip         = src->flip;
-	dst->full_range   = src->full_range;
-	dst->timestamp    = src->timestamp;
-	memcpy(dst->color_matrix, src->color_matrix, sizeof(float) * 16);
-	if (!dst->full_range) {
-		size_t const size = sizeof(float) * 3;
-		memcpy(dst->color_range_min, src->color_range_min, size);
-		memcpy(dst->color_range_max, src->color_range_max, size);
-	}
+	struct frame_copy_slices *slices = param;
+	struct obs_source_frame *dst = slices->dst;
+	const struct obs_source_frame *src = slices->src;
+	uint32_t start_y, end_y;
+	uint32_t uv_start_y, uv_end_y;
+
+	obs_get_slice_rows(dst->height, slices->count, idx, &start_y, &end_y);
+	uv_start_y = start_y / 2;
+	uv_end_y   = end_y / 2;
 
 	switch (dst->format) {
 	case VIDEO_FORMAT_I420:
-		copy_frame_data_plane(dst, src, 0, dst->height);
-		copy_frame_data_plane(dst, src, 1, dst->height/2);
-		copy_frame_data_plane(dst, src, 2, dst->height/2);
+		copy_frame_data_plane(dst, src, 0, start_y, end_y);
+		copy_frame_data_plane(dst, src, 1, uv_start_y, uv_end_y);
+		copy_frame_data_plane(dst, src, 2, uv_start_y, uv_end_y);
 		break;
 
 	case VIDEO_FORMAT_NV12:
-		copy_frame_data_plane(dst, src, 0, dst->height);
-		copy_frame_data_plane(dst, src, 1, dst->height/2);
+		copy_frame_data_plane(dst, src, 0, start_y, end_y);
+		copy_frame_data_plane(dst, src, 1, uv_start_y, uv_end_y);
 		break;
 
 	case VIDEO_FORMAT_I444:
-		copy_frame_data_plane(dst, src, 0, dst->height);
-		copy_frame_data_plane(dst, src, 1, dst->height);
-		copy_frame_data_plane(dst, src, 2, dst->height);
+		copy_frame_data_plane(dst, src, 0, start_y, end_y);
+		copy_frame_data_plane(dst, src, 1, start_y, end_y);
+		copy_frame_data_plane(dst, src, 2, start_y, end_y);
 		break;
 
 	case VIDEO_FORMAT_YVYU:
@@ -2120,19 +2138,40 @@ static void copy_frame_data(struct obs_source_frame *dst,
 	case VIDEO_FORMAT_RGBA:
 	case VIDEO_FORMAT_BGRA:
 	case VIDEO_FORMAT_BGRX:
-		copy_frame_data_plane(dst, src, 0, dst->height);
+		copy_frame_data_plane(dst, src, 0, start_y, end_y);
+	}
+}
+
+static const char *copy_frame_data_slice_name = "copy_frame_data_slice";
+static void copy_frame_data(struct obs_source_frame *dst,
+		const struct obs_source_frame *src)
+{
+	struct frame_copy_slices slices = {dst, src};
+
+	dst->flip         = src->flip;
+	dst->full_range   = src->full_range;
+	dst->timestamp    = src->timestamp;
+	memcpy(dst->color_matrix, src->color_matrix, sizeof(float) * 16);
+	if (!dst->full_range) {
+		size_t const size = sizeof(float) * 3;
+		memcpy(dst->color_range_min, src->color_range_min, size);
+		memcpy(dst->color_range_max, src->color_range_max, size);
 	}
+
+	slices.count = obs_get_slice_count(dst->height);
+	task_pool_run(obs->task_pool, copy_frame_data_slice, &slices,
+			slices.count, copy_frame_data_slice_name);
 }
 
 static inline bool async_texture_changed(struct obs_source *source,
-		const struct obs_source_frame *frame)
+		enum video_format format, uint32_t width, uint32_t height)
 {
 	enum convert_type prev, cur;
 	prev = get_convert_type(source->async_cache_format);
-	cur  = get_convert_type(frame->format);
+	cur  = get_convert_type(format);
 
-	return source->async_cache_width  != frame->width ||
-	       source->async_cache_height != frame->height ||
+	return source->async_cache_width  != width ||
+	       source->async_cache_height != height ||
 	       prev != cur;
 }
 
@@ -2166,25 +2205,84 @@ static void clean_cache(obs_source_t *source)
 
 #define MAX_ASYNC_FRAMES 30
 
-static inline struct obs_source_frame *cache_video(struct obs_source *source,
-		const struct obs_source_frame *frame)
+static inline void drop_oldest_async_frame(struct obs_source *source)
 {
-	struct obs_source_frame *new_frame = NULL;
+	struct obs_source_frame *frame = source->async_frames.array[0];
 
-	pthread_mutex_lock(&source->async_mutex);
+	da_erase(source->async_frames, 0);
+	remove_async_frame(source, frame);
+	source->async_dropped_frames++;
+}
 
-	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
-		free_async_cache(source);
-		source->last_frame_ts = 0;
+/* waits until a queued frame has been used or the timeout expires.  must be
+ * called with the async mutex locked */
+static void wait_for_async_space(struct obs_source *source)
+{
+	uint64_t end_time = os_gettime_ns() +
+		(uint64_t)source->async_block_timeout_ms * 1000000ULL;
+
+	while (source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		uint64_t cur_time = os_gettime_ns();
+		unsigned long ms;
+
+		if (cur_time >= end_time)
+			break;
+
+		ms = (unsigned long)((end_time - cur_time + 999999) / 1000000);
+
+		source->async_space_waiting = true;
 		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
+		os_event_timedwait(source->async_space_event, ms);
+		pthread_mutex_lock(&source->async_mutex);
+		source->async_space_waiting = false;
 	}
+}
+
+/* makes room in the async frame queue according to the drop policy, returns
+ * false if the new frame should be dropped.  must be called with the async
+ * mutex locked */
+static bool make_async_space(struct obs_source *source)
+{
+	if (source->async_frames.num < MAX_ASYNC_FRAMES)
+		return true;
 
-	if (async_texture_changed(source, frame)) {
+	switch (source->async_drop_policy) {
+	case OBS_ASYNC_DROP_OLDEST:
+		while (source->async_frames.num >= MAX_ASYNC_FRAMES)
+			drop_oldest_async_frame(source);
+		return true;
+
+	case OBS_ASYNC_BLOCK:
+		wait_for_async_space(source);
+		if (source->async_frames.num < MAX_ASYNC_FRAMES)
+			return true;
+		break;
+
+	case OBS_ASYNC_DROP_NEWEST:
+		break;
+	}
+
+	source->async_dropped_frames++;
+	return false;
+}
+
+/* gets an unused frame from the async cache with an extra reference held for
+ * the caller, or NULL if the frame should be dropped.  must be called with the
+ * async mutex locked */
+static struct obs_source_frame *get_cached_frame(struct obs_source *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *new_frame = NULL;
+
+	if (!make_async_space(source))
+		return NULL;
+
+	if (async_texture_changed(source, format, width, height) ||
+	    source->async_cache_format != format) {
 		free_async_cache(source);
-		source->async_cache_width  = frame->width;
-		source->async_cache_height = frame->height;
-		source->async_cache_format = frame->format;
+		source->async_cache_width  = width;
+		source->async_cache_height = height;
+		source->async_cache_format = format;
 	}
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
@@ -2202,8 +2300,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(frame->format,
-				frame->width, frame->height);
+		new_frame = obs_source_frame_create(format, width, height);
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
@@ -2213,9 +2310,22 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	}
 
 	os_atomic_inc_long(&new_frame->refs);
+	return new_frame;
+}
+
+static inline struct obs_source_frame *cache_video(struct obs_source *source,
+		const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame;
 
+	pthread_mutex_lock(&source->async_mutex);
+	new_frame = get_cached_frame(source, frame->format,
+			frame->width, frame->height);
 	pthread_mutex_unlock(&source->async_mutex);
 
+	if (!new_frame)
+		return NULL;
+
 	copy_frame_data(new_frame, frame);
 
 	if (os_atomic_dec_long(&new_frame->refs) == 0) {
@@ -2250,6 +2360,53 @@ void obs_source_output_video(obs_source_t *source,
 	}
 }
 
+struct obs_source_frame *obs_source_get_free_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+
+	if (!obs_source_valid(source, "obs_source_get_free_frame"))
+		return NULL;
+	if (format == VIDEO_FORMAT_NONE || !width || !height)
+		return NULL;
+
+	pthread_mutex_lock(&source->async_mutex);
+	frame = get_cached_frame(source, format, width, height);
+	pthread_mutex_unlock(&source->async_mutex);
+
+	if (frame) {
+		frame->timestamp  = 0;
+		frame->full_range = false;
+		frame->flip       = false;
+	}
+
+	return frame;
+}
+
+void obs_source_output_free_frame(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	if (!frame)
+		return;
+	if (!obs_source_valid(source, "obs_source_output_free_frame")) {
+		obs_source_frame_destroy(frame);
+		return;
+	}
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	/* the cache was reset while the frame was being written */
+	if (os_atomic_dec_long(&frame->refs) == 0) {
+		pthread_mutex_unlock(&source->async_mutex);
+		obs_source_frame_destroy(frame);
+		return;
+	}
+
+	da_push_back(source->async_frames, &frame);
+	pthread_mutex_unlock(&source->async_mutex);
+	source->async_active = true;
+}
+
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
 		struct obs_audio_data *in)
 {
@@ -2592,6 +2749,51 @@ void obs_source_release_frame(obs_source_t *source,
 	}
 }
 
+void obs_source_set_async_drop_policy(obs_source_t *source,
+		enum obs_async_drop_policy policy, uint32_t timeout_ms)
+{
+	if (!obs_source_valid(source, "obs_source_set_async_drop_policy"))
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	source->async_drop_policy = policy;
+	source->async_block_timeout_ms = timeout_ms;
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+enum obs_async_drop_policy obs_source_get_async_drop_policy(
+		const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_async_drop_policy") ?
+		source->async_drop_policy : OBS_ASYNC_DROP_OLDEST;
+}
+
+uint32_t obs_source_get_async_dropped_frames(obs_source_t *source)
+{
+	uint32_t dropped;
+
+	if (!obs_source_valid(source, "obs_source_get_async_dropped_frames"))
+		return 0;
+
+	pthread_mutex_lock(&source->async_mutex);
+	dropped = source->async_dropped_frames;
+	pthread_mutex_unlock(&source->async_mutex);
+	return dropped;
+}
+
+size_t obs_source_get_async_queued_frames(obs_source_t *source)
+{
+	size_t queued;
+
+	if (!obs_source_valid(source, "obs_source_get_async_queued_frames"))
+		return 0;
+
+	pthread_mutex_lock(&source->async_mutex);
+	queued = source->async_frames.num;
+	pthread_mutex_unlock(&source->async_mutex);
+	return queued;
+}
+
 const char *obs_source_get_name(const obs_source_t *source)
 {
 	return obs_source_valid(source, "obs_source_get_name") ?
@@ -3489,27 +3691,43 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 	return source->volume;
 }
 
+static inline bool mix_silent(const obs_source_t *source, size_t mix)
+{
+	return (source->audio_silent_mixes & (1 << mix)) != 0;
+}
+
+/* zeroes a mix's output buffer unless it's already known to be silent */
+static inline void silence_output_mix(obs_source_t *source, size_t mix,
+		size_t channels)
+{
+	if (mix_silent(source, mix))
+		return;
+
+	memset(source->audio_output_buf[mix][0], 0,
+			sizeof(float) * AUDIO_OUTPUT_FRAMES * channels);
+	source->audio_silent_mixes |= (1 << mix);
+}
+
+static inline void silence_all_output_mixes(obs_source_t *source,
+		size_t channels)
+{
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		silence_output_mix(source, mix, channels);
+}
+
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 		size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
-
-	while (out < end)
-		*(out++) *= vol;
+	audio_mix_scale(source->audio_output_buf[mix][0], vol,
+			AUDIO_OUTPUT_FRAMES * channels);
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 		size_t channels, float *vol_data)
 {
-	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
-		register float *vol = vol_data;
-
-		while (out < end)
-			*(out++) *= *(vol++);
-	}
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mix_mul(source->audio_output_buf[mix][ch], vol_data,
+				AUDIO_OUTPUT_FRAMES);
 }
 
 static inline void apply_audio_action(obs_source_t *source,
@@ -3568,19 +3786,19 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		if ((source->audio_mixers & (1 << mix)) != 0)
+		if ((source->audio_mixers & (1 << mix)) != 0 &&
+		    !mix_silent(source, mix))
 			multiply_vol_data(source, mix, channels, vol_data);
 	}
 
 	free(vol_data);
 }
 
-static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
-		size_t channels, size_t sample_rate)
+/* whether any volume/mute actions take effect during the current tick */
+static bool audio_actions_pending(obs_source_t *source, size_t sample_rate)
 {
 	struct audio_action action;
 	bool actions_pending;
-	float vol;
 
 	pthread_mutex_lock(&source->audio_actions_mutex);
 
@@ -3594,10 +3812,20 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		uint64_t duration = conv_frames_to_time(sample_rate,
 				AUDIO_OUTPUT_FRAMES);
 
-		if (action.timestamp < (source->audio_ts + duration)) {
-			apply_audio_actions(source, channels, sample_rate);
-			return;
-		}
+		return action.timestamp < (source->audio_ts + duration);
+	}
+
+	return false;
+}
+
+static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
+		size_t channels, size_t sample_rate)
+{
+	float vol;
+
+	if (audio_actions_pending(source, sample_rate)) {
+		apply_audio_actions(source, channels, sample_rate);
+		return;
 	}
 
 	vol = get_source_volume(source, source->audio_ts);
@@ -3605,16 +3833,15 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		return;
 
 	if (vol == 0.0f || mixers == 0) {
-		memset(source->audio_output_buf[0][0], 0,
-				AUDIO_OUTPUT_FRAMES * sizeof(float) *
-				MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES);
+		silence_all_output_mixes(source, channels);
 		return;
 	}
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
 		uint32_t mix_and_val = (1 << mix);
 		if ((source->audio_mixers & mix_and_val) != 0 &&
-		    (mixers & mix_and_val) != 0)
+		    (mixers & mix_and_val) != 0 &&
+		    !mix_silent(source, mix))
 			multiply_output_audio(source, mix, channels, vol);
 	}
 }
@@ -3632,8 +3859,10 @@ static void custom_audio_render(obs_source_t *source, uint32_t mixers,
 				source->audio_output_buf[mix][ch];
 	}
 
-	memset(audio_data.output[0].data[0], 0, AUDIO_OUTPUT_FRAMES *
-			MAX_AUDIO_MIXES * channels * sizeof(float));
+	silence_all_output_mixes(source, channels);
+
+	/* the callback can write to any of the mixes */
+	source->audio_silent_mixes = 0;
 
 	success = source->info.audio_render(source->context.data, &ts,
 			&audio_data, mixers, channels, sample_rate);
@@ -3644,21 +3873,42 @@ static void custom_audio_render(obs_source_t *source, uint32_t mixers,
 		return;
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		if ((source->audio_mixers & (1 << mix)) == 0) {
-			memset(source->audio_output_buf[mix][0], 0,
-					sizeof(float) * AUDIO_OUTPUT_FRAMES *
-					channels);
-			continue;
-		}
+		if ((source->audio_mixers & (1 << mix)) == 0)
+			silence_output_mix(source, mix, channels);
 	}
 
 	apply_audio_volume(source, mixers, channels, sample_rate);
 }
 
+/* muted or zero volume for the entire tick */
+static inline bool audio_source_silent(obs_source_t *source,
+		size_t sample_rate)
+{
+	return !audio_actions_pending(source, sample_rate) &&
+		get_source_volume(source, source->audio_ts) == 0.0f;
+}
+
+/* the input for this tick (in mix 0) is all zero samples, as from an idle
+ * capture device.  usually stops at the first sample */
+static inline bool audio_input_silent(obs_source_t *source, size_t channels,
+		size_t size)
+{
+	for (size_t ch = 0; ch < channels; ch++) {
+		if (!audio_mix_silent(source->audio_output_buf[0][ch],
+					size / sizeof(float)))
+			return false;
+	}
+
+	return true;
+}
+
 static inline void process_audio_source_tick(obs_source_t *source,
 		uint32_t mixers, size_t channels, size_t sample_rate,
 		size_t size)
 {
+	uint32_t active_mixes = source->audio_mixers & mixers;
+	bool silent = !active_mixes || audio_source_silent(source, sample_rate);
+
 	pthread_mutex_lock(&source->audio_buf_mutex);
 
 	if (source->audio_input_buf[0].size < size) {
@@ -3667,6 +3917,14 @@ static inline void process_audio_source_tick(obs_source_t *source,
 		return;
 	}
 
+	if (silent) {
+		pthread_mutex_unlock(&source->audio_buf_mutex);
+
+		silence_all_output_mixes(source, channels);
+		source->audio_pending = false;
+		return;
+	}
+
 	for (size_t ch = 0; ch < channels; ch++)
 		circlebuf_peek_front(&source->audio_input_buf[ch],
 				source->audio_output_buf[0][ch],
@@ -3674,24 +3932,30 @@ static inline void process_audio_source_tick(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->audio_buf_mutex);
 
-	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
-		uint32_t mix_and_val = (1 << mix);
+	if (audio_input_silent(source, channels, size)) {
+		source->audio_silent_mixes |= 1;
+		silence_all_output_mixes(source, channels);
+		source->audio_pending = false;
+		return;
+	}
 
-		if ((source->audio_mixers & mix_and_val) == 0 ||
-		    (mixers & mix_and_val) == 0) {
-			memset(source->audio_output_buf[mix][0],
-					0, size * channels);
+	source->audio_silent_mixes &= ~1;
+
+	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
+		if ((active_mixes & (1 << mix)) == 0) {
+			silence_output_mix(source, mix, channels);
 			continue;
 		}
 
 		for (size_t ch = 0; ch < channels; ch++)
 			memcpy(source->audio_output_buf[mix][ch],
 					source->audio_output_buf[0][ch], size);
+
+		source->audio_silent_mixes &= ~(1 << mix);
 	}
 
-	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0)
-		memset(source->audio_output_buf[0][0], 0,
-				size * channels);
+	if ((active_mixes & 1) == 0)
+		silence_output_mix(source, 0, channels);
 
 	apply_audio_volume(source, mixers, channels, sample_rate);
 	source->audio_pending = false;
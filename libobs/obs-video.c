@@ -20,6 +20,7 @@
 #include "graphics/vec4.h"
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
+#include "util/tick-timer.h"
 
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
@@ -419,52 +420,101 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 	}
 }
 
-static void convert_frame(
-		struct video_frame *output, const struct video_data *input,
-		const struct video_output_info *info)
+struct frame_slices {
+	struct video_frame              *output;
+	const struct video_data         *input;
+	const struct video_output_info  *info;
+	size_t                          count;
+};
+
+static void convert_frame_slice(void *param, size_t idx)
 {
+	struct frame_slices *slices = param;
+	const struct video_output_info *info = slices->info;
+	const struct video_data *input = slices->input;
+	struct video_frame *output = slices->output;
+	uint32_t start_y, end_y;
+
+	obs_get_slice_rows(info->height, slices->count, idx, &start_y, &end_y);
+
 	if (info->format == VIDEO_FORMAT_I420) {
 		compress_uyvx_to_i420(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_NV12) {
 		compress_uyvx_to_nv12(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_I444) {
 		convert_uyvx_to_i444(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
-
-	} else {
-		blog(LOG_ERROR, "convert_frame: unsupported texture format");
 	}
 }
 
-static inline void copy_rgbx_frame(
+static const char *convert_frame_slice_name = "convert_frame_slice";
+static void convert_frame(
 		struct video_frame *output, const struct video_data *input,
 		const struct video_output_info *info)
 {
-	uint8_t *in_ptr = input->data[0];
-	uint8_t *out_ptr = output->data[0];
+	struct frame_slices slices = {output, input, info};
+
+	if (info->format != VIDEO_FORMAT_I420 &&
+	    info->format != VIDEO_FORMAT_NV12 &&
+	    info->format != VIDEO_FORMAT_I444) {
+		blog(LOG_ERROR, "convert_frame: unsupported texture format");
+		return;
+	}
+
+	slices.count = obs_get_slice_count(info->height);
+	task_pool_run(obs->task_pool, convert_frame_slice, &slices,
+			slices.count, convert_frame_slice_name);
+}
+
+static void copy_rgbx_frame_slice(void *param, size_t idx)
+{
+	struct frame_slices *slices = param;
+	const struct video_data *input = slices->input;
+	struct video_frame *output = slices->output;
+	uint32_t start_y, end_y;
+	uint8_t *in_ptr;
+	uint8_t *out_ptr;
+
+	obs_get_slice_rows(slices->info->height, slices->count, idx,
+			&start_y, &end_y);
+
+	in_ptr = input->data[0] + start_y * input->linesize[0];
+	out_ptr = output->data[0] + start_y * output->linesize[0];
 
 	/* if the line sizes match, do a single copy */
 	if (input->linesize[0] == output->linesize[0]) {
-		memcpy(out_ptr, in_ptr, input->linesize[0] * info->height);
+		memcpy(out_ptr, in_ptr, input->linesize[0] * (end_y - start_y));
 	} else {
-		for (size_t y = 0; y < info->height; y++) {
-			memcpy(out_ptr, in_ptr, info->width * 4);
+		for (uint32_t y = start_y; y < end_y; y++) {
+			memcpy(out_ptr, in_ptr, slices->info->width * 4);
 			in_ptr += input->linesize[0];
 			out_ptr += output->linesize[0];
 		}
 	}
 }
 
+static const char *copy_rgbx_frame_slice_name = "copy_rgbx_frame_slice";
+static inline void copy_rgbx_frame(
+		struct video_frame *output, const struct video_data *input,
+		const struct video_output_info *info)
+{
+	struct frame_slices slices = {output, input, info};
+
+	slices.count = obs_get_slice_count(info->height);
+	task_pool_run(obs->task_pool, copy_rgbx_frame_slice, &slices,
+			slices.count, copy_rgbx_frame_slice_name);
+}
+
 static inline void output_video_data(struct obs_core_video *video,
 		struct video_data *input_frame, int count)
 {
@@ -492,14 +542,15 @@ static inline void output_video_data(struct obs_core_video *video,
 }
 
 static inline void video_sleep(struct obs_core_video *video,
-		uint64_t *p_time, uint64_t interval_ns)
+		struct tick_timer *timer, uint64_t *p_time,
+		uint64_t interval_ns)
 {
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	if (tick_timer_sleepto(timer, t)) {
 		*p_time = t;
 		count = 1;
 	} else {
@@ -575,6 +626,7 @@ void *obs_video_thread(void *param)
 	uint64_t interval = video_output_get_frame_time(obs->video.video);
 	uint64_t fps_total_ns = 0;
 	uint32_t fps_total_frames = 0;
+	struct tick_timer timer;
 
 	obs->video.video_time = os_gettime_ns();
 
@@ -585,6 +637,11 @@ void *obs_video_thread(void *param)
 			"obs_video_thread(%g"NBSP"ms)", interval / 1000000.);
 	profile_register_root(video_thread_name, interval);
 
+	tick_timer_init(&timer,
+		profile_store_name(obs_get_profiler_name_store(),
+			"obs_video_thread(%g"NBSP"ms) wake latency",
+			interval / 1000000.));
+
 	while (!video_output_stopped(obs->video.video)) {
 		profile_start(video_thread_name);
 
@@ -604,7 +661,8 @@ void *obs_video_thread(void *param)
 
 		profile_reenable_thread();
 
-		video_sleep(&obs->video, &obs->video.video_time, interval);
+		video_sleep(&obs->video, &timer, &obs->video.video_time,
+				interval);
 
 		fps_total_ns += (obs->video.video_time - last_time);
 		fps_total_frames++;
@@ -40,6 +40,7 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->range   = ovi->range;
 	vi->colorspace = ovi->colorspace;
 	vi->cache_size = 6;
+	vi->threaded_inputs = true;
 }
 
 #define PIXEL_SIZE 4
@@ -360,6 +361,7 @@ static int obs_init_video(struct obs_video_info *ovi)
 	video->output_height  = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
 	video->scale_type     = ovi->scale_type;
+	video->conversion_threads = ovi->conversion_threads;
 
 	set_video_matrix(video, ovi);
 
@@ -720,6 +722,25 @@ extern const struct obs_source_info scene_info;
 
 extern void log_system_info(void);
 
+#define MAX_TASK_THREADS 7
+
+static bool obs_init_task_pool(void)
+{
+	int threads = os_get_logical_cores() - 1;
+	if (threads > MAX_TASK_THREADS)
+		threads = MAX_TASK_THREADS;
+	if (threads < 0)
+		threads = 0;
+
+	obs->task_pool = task_pool_create("libobs: task pool", (size_t)threads);
+	if (!obs->task_pool) {
+		blog(LOG_ERROR, "Couldn't create task pool");
+		return false;
+	}
+
+	return true;
+}
+
 static bool obs_init(const char *locale, const char *module_config_path,
 		profiler_name_store_t *store)
 {
@@ -734,6 +755,8 @@ static bool obs_init(const char *locale, const char *module_config_path,
 
 	log_system_info();
 
+	if (!obs_init_task_pool())
+		return false;
 	if (!obs_init_data())
 		return false;
 	if (!obs_init_handlers())
@@ -818,10 +841,13 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	obs_free_encoder_packet_pool();
+	task_pool_destroy(obs->task_pool);
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
 	obs->signals = NULL;
+	obs->task_pool = NULL;
 
 	module = obs->first_module;
 	while (module) {
@@ -917,6 +943,10 @@ int obs_reset_video(struct obs_video_info *ovi)
 	ovi->output_width  &= 0xFFFFFFFC;
 	ovi->output_height &= 0xFFFFFFFE;
 
+	/* callers that don't zero the structure can pass garbage here */
+	if (ovi->conversion_threads > MAX_CONVERSION_THREADS)
+		ovi->conversion_threads = 0;
+
 	if (!video->graphics) {
 		int errorcode = obs_init_graphics(ovi);
 		if (errorcode != OBS_VIDEO_SUCCESS) {
@@ -986,6 +1016,7 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 	ovi->base_height   = video->base_height;
 	ovi->gpu_conversion= video->gpu_conversion;
 	ovi->scale_type    = video->scale_type;
+	ovi->conversion_threads = video->conversion_threads;
 	ovi->colorspace    = info->colorspace;
 	ovi->range         = info->range;
 	ovi->output_width  = info->width;
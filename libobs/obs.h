@@ -174,6 +174,13 @@ struct obs_video_info {
 	enum video_range_type range;       /**< YUV range (if YUV) */
 
 	enum obs_scale_type scale_type;    /**< How to scale if scaling */
+
+	/**
+	 * Number of slices to split CPU-side frame conversion and copying
+	 * into (0 = automatic, based on the number of logical cores).
+	 * Values over 64 are treated as 0.
+	 */
+	uint32_t            conversion_threads;
 };
 
 /**
@@ -914,6 +921,29 @@ EXPORT void obs_source_set_deinterlace_field_order(obs_source_t *source,
 EXPORT enum obs_deinterlace_field_order obs_source_get_deinterlace_field_order(
 		const obs_source_t *source);
 
+/** What to do when an async source outputs frames faster than they're used */
+enum obs_async_drop_policy {
+	OBS_ASYNC_DROP_OLDEST,
+	OBS_ASYNC_DROP_NEWEST,
+	OBS_ASYNC_BLOCK
+};
+
+/**
+ * Sets the policy used when an async source's frame queue is full.  With
+ * OBS_ASYNC_BLOCK the producer waits up to timeout_ms for a queued frame to
+ * be used, and drops the new frame if none is.
+ */
+EXPORT void obs_source_set_async_drop_policy(obs_source_t *source,
+		enum obs_async_drop_policy policy, uint32_t timeout_ms);
+EXPORT enum obs_async_drop_policy obs_source_get_async_drop_policy(
+		const obs_source_t *source);
+
+/** Gets the number of async video frames dropped due to a full queue */
+EXPORT uint32_t obs_source_get_async_dropped_frames(obs_source_t *source);
+
+/** Gets the number of async video frames currently waiting to be shown */
+EXPORT size_t obs_source_get_async_queued_frames(obs_source_t *source);
+
 /* ------------------------------------------------------------------------- */
 /* Functions used by sources */
 
@@ -954,6 +984,21 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Gets a writable frame from the source's async frame pool so video can be
+ * written directly into it without an extra copy.  The caller must fill in
+ * the frame data and properties (timestamp, color matrix, etc.) and then
+ * either output it with obs_source_output_free_frame, or give it back with
+ * obs_source_release_frame.  Returns NULL if too many frames are queued.
+ */
+EXPORT struct obs_source_frame *obs_source_get_free_frame(
+		obs_source_t *source, enum video_format format,
+		uint32_t width, uint32_t height);
+
+/** Outputs a frame acquired with obs_source_get_free_frame */
+EXPORT void obs_source_output_free_frame(obs_source_t *source,
+		struct obs_source_frame *frame);
+
 /** Outputs audio data (always asynchronous) */
 EXPORT void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio);
@@ -1315,6 +1360,14 @@ EXPORT void obs_output_stop(obs_output_t *output);
  */
 #define OBS_OUTPUT_DELAY_PRESERVE (1<<0)
 
+/**
+ * Stores delayed packet data in temporary files once more than a small amount
+ * of it is buffered, rather than keeping all of it in memory.  Recommended
+ * for long delays at high bitrates.  Data that can't be read back from disk
+ * in time is dropped, and video then resumes at the next keyframe.
+ */
+#define OBS_OUTPUT_DELAY_DISK (1<<1)
+
 /**
  * Sets the current output delay, in seconds (if the output supports delay).
  *
@@ -1331,6 +1384,13 @@ EXPORT uint32_t obs_output_get_delay(const obs_output_t *output);
 /** If delay is active, gets the currently active delay value, in seconds. */
 EXPORT uint32_t obs_output_get_active_delay(const obs_output_t *output);
 
+/**
+ * Gets the amount of delayed packet data currently held in memory and in
+ * temporary files, in bytes.  Either pointer may be NULL.
+ */
+EXPORT void obs_output_get_delay_usage(const obs_output_t *output,
+		uint64_t *memory_bytes, uint64_t *disk_bytes);
+
 /** Forces the output to stop.  Usually only used with delay. */
 EXPORT void obs_output_force_stop(obs_output_t *output);
 
@@ -1438,6 +1498,12 @@ EXPORT void obs_output_set_reconnect_settings(obs_output_t *output,
 		int retry_count, int retry_sec);
 
 EXPORT uint64_t obs_output_get_total_bytes(const obs_output_t *output);
+
+/**
+ * Returns the congestion of the output's connection, from 0.0 to 1.0, or 0.0
+ * if the output does not report it
+ */
+EXPORT float obs_output_get_congestion(const obs_output_t *output);
 EXPORT int obs_output_get_frames_dropped(const obs_output_t *output);
 EXPORT int obs_output_get_total_frames(const obs_output_t *output);
 
@@ -1650,10 +1716,30 @@ EXPORT const char *obs_encoder_get_id(const obs_encoder_t *encoder);
 
 EXPORT uint32_t obs_get_encoder_caps(const char *encoder_id);
 
-/** Duplicates an encoder packet */
+/**
+ * Adds a reference to the data of an encoder packet.  Packet data is
+ * immutable and reference counted, so all outputs share the same payload.  If
+ * the source packet does not own its data (such as the packet given to an
+ * encoder callback, or one whose data was replaced), the data is first copied
+ * in to a new reference counted buffer.
+ */
+EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+
+/** Releases a packet's reference to its data */
+EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
+
+/**
+ * Gets how many packet data buffers have been newly allocated and how many
+ * were reused from the pool so far.  Either pointer may be NULL.
+ */
+EXPORT void obs_encoder_packet_get_pool_stats(long *allocs, long *reuses);
+
+/** Duplicates an encoder packet (same as obs_encoder_packet_ref) */
 EXPORT void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 		const struct encoder_packet *src);
 
+/** Frees a duplicated packet (same as obs_encoder_packet_release) */
 EXPORT void obs_free_encoder_packet(struct encoder_packet *packet);
 
 
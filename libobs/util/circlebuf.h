@@ -189,6 +189,24 @@ static inline void circlebuf_push_front(struct circlebuf *cb, const void *data,
 	}
 }
 
+/**
+ * Returns a pointer to the data at a byte offset from the front of the
+ * buffer.  For an array of elements, pass the element index multiplied by
+ * the element size.  Only valid for data that does not wrap around the end
+ * of the buffer, which is always the case for fixed-size elements that are
+ * pushed and popped one at a time.
+ */
+static inline void *circlebuf_data(struct circlebuf *cb, size_t offset)
+{
+	size_t position = cb->start_pos + offset;
+
+	assert(offset < cb->size);
+
+	if (position >= cb->capacity)
+		position -= cb->capacity;
+	return (uint8_t*)cb->data + position;
+}
+
 static inline void circlebuf_peek_front(struct circlebuf *cb, void *data,
 		size_t size)
 {
@@ -128,6 +128,12 @@ void os_cpu_usage_info_destroy(os_cpu_usage_info_t *info)
 		bfree(info);
 }
 
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
 #endif
 
 bool os_sleepto_ns(uint64_t time_target)
@@ -136,6 +142,22 @@ bool os_sleepto_ns(uint64_t time_target)
 	if (time_target < current)
 		return false;
 
+#if !defined(__APPLE__)
+	/* os_gettime_ns uses CLOCK_MONOTONIC, so sleep to the absolute target
+	 * time to avoid drifting by however long it takes to get here */
+	struct timespec target;
+	int ret;
+
+	target.tv_sec = (time_t)(time_target / 1000000000);
+	target.tv_nsec = (long)(time_target % 1000000000);
+
+	do {
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target,
+				NULL);
+	} while (ret == EINTR);
+
+	return true;
+#else
 	time_target -= current;
 
 	struct timespec req, remain;
@@ -150,6 +172,7 @@ bool os_sleepto_ns(uint64_t time_target)
 	}
 
 	return true;
+#endif
 }
 
 void os_sleep_ms(uint32_t duration)
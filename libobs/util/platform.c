@@ -25,6 +25,12 @@
 #include "utf8.h"
 #include "dstr.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -656,3 +662,80 @@ const char *os_get_path_extension(const char *path)
 
 	return path + pos;
 }
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+static inline void get_cpuid(int func, int sub_func, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, func, sub_func);
+#else
+	__cpuid_count(func, sub_func, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t query_cpu_features(void)
+{
+	uint32_t features = 0;
+	uint32_t regs[4];
+	uint32_t max_func;
+	bool os_saves_ymm = false;
+
+	get_cpuid(0, 0, regs);
+	max_func = regs[0];
+	if (max_func < 1)
+		return 0;
+
+	get_cpuid(1, 0, regs);
+	if (regs[3] & (1 << 26))
+		features |= OS_CPU_SSE2;
+	if (regs[2] & (1 << 9))
+		features |= OS_CPU_SSSE3;
+	if (regs[2] & (1 << 19))
+		features |= OS_CPU_SSE41;
+
+	/* AVX needs the OS to save the upper halves of the ymm registers */
+	if ((regs[2] & (1 << 27)) && (regs[2] & (1 << 28)))
+		os_saves_ymm = (get_xcr0() & 0x6) == 0x6;
+	if (os_saves_ymm)
+		features |= OS_CPU_AVX;
+
+	if (os_saves_ymm && max_func >= 7) {
+		get_cpuid(7, 0, regs);
+		if (regs[1] & (1 << 5))
+			features |= OS_CPU_AVX2;
+	}
+
+	return features;
+}
+#else
+static uint32_t query_cpu_features(void)
+{
+	return 0;
+}
+#endif
+
+#define CPU_FEATURES_QUERIED (1U << 31)
+
+uint32_t os_get_cpu_features(void)
+{
+	static volatile uint32_t cached_features = 0;
+	uint32_t features = cached_features;
+
+	if ((features & CPU_FEATURES_QUERIED) == 0) {
+		features = query_cpu_features() | CPU_FEATURES_QUERIED;
+		cached_features = features;
+	}
+
+	return features & ~CPU_FEATURES_QUERIED;
+}
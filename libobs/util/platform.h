@@ -91,6 +91,18 @@ EXPORT os_cpu_usage_info_t *os_cpu_usage_info_start(void);
 EXPORT double              os_cpu_usage_info_query(os_cpu_usage_info_t *info);
 EXPORT void                os_cpu_usage_info_destroy(os_cpu_usage_info_t *info);
 
+#define OS_CPU_SSE2  (1<<0)
+#define OS_CPU_SSSE3 (1<<1)
+#define OS_CPU_SSE41 (1<<2)
+#define OS_CPU_AVX   (1<<3)
+#define OS_CPU_AVX2  (1<<4)
+
+/** Returns the OS_CPU_* instruction set flags usable on this machine */
+EXPORT uint32_t os_get_cpu_features(void);
+
+/** Returns the number of logical processors available */
+EXPORT int os_get_logical_cores(void);
+
 typedef const void os_performance_token_t;
 EXPORT os_performance_token_t *os_request_high_performance(const char *reason);
 EXPORT void                   os_end_high_performance(os_performance_token_t *);
@@ -443,6 +443,29 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+void profile_record(const char *name, uint64_t time_delta)
+{
+	uint64_t end = os_gettime_ns();
+	if (!thread_enabled)
+		return;
+
+	profile_start(name);
+
+	profile_call *call = thread_context;
+	thread_context = call->parent;
+
+	call->start_time = end - time_delta;
+	call->end_time = end;
+#ifdef TRACK_OVERHEAD
+	call->overhead_end = os_gettime_ns();
+#endif
+
+	if (call->parent)
+		return;
+
+	merge_context(call);
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry*)second)->time_delta -
@@ -22,6 +22,9 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* records an already measured duration as a call of the given name */
+EXPORT void profile_record(const char *name, uint64_t time_delta);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
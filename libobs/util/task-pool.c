@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "task-pool.h"
+#include "threading.h"
+#include "profiler.h"
+#include "darray.h"
+#include "bmem.h"
+#include "base.h"
+
+struct task_job {
+	struct task_job  *next;
+
+	task_pool_func_t func;
+	void             *param;
+	const char       *profile_name;
+
+	size_t           count;
+	size_t           next_idx;
+	size_t           remaining;
+};
+
+struct task_pool {
+	pthread_mutex_t  mutex;
+	pthread_cond_t   work_cond;
+	pthread_cond_t   done_cond;
+
+	/* jobs that still have unclaimed slices */
+	struct task_job  *jobs;
+
+	char             *name;
+	bool             stop;
+	DARRAY(pthread_t) threads;
+};
+
+static void remove_job(struct task_pool *pool, struct task_job *job)
+{
+	struct task_job **cur = &pool->jobs;
+
+	while (*cur) {
+		if (*cur == job) {
+			*cur = job->next;
+			break;
+		}
+
+		cur = &(*cur)->next;
+	}
+}
+
+/* must be called with the pool mutex held, and unlocks it while the slice
+ * is being processed */
+static void process_slice(struct task_pool *pool, struct task_job *job)
+{
+	size_t idx = job->next_idx++;
+	if (job->next_idx == job->count)
+		remove_job(pool, job);
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (job->profile_name)
+		profile_start(job->profile_name);
+	job->func(job->param, idx);
+	if (job->profile_name)
+		profile_end(job->profile_name);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (--job->remaining == 0)
+		pthread_cond_broadcast(&pool->done_cond);
+}
+
+static void *task_pool_thread(void *param)
+{
+	struct task_pool *pool = param;
+
+	os_set_thread_name(pool->name);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	for (;;) {
+		while (!pool->stop && !pool->jobs)
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+		if (!pool->jobs)
+			break;
+
+		pthread_mutex_unlock(&pool->mutex);
+		profile_reenable_thread();
+		pthread_mutex_lock(&pool->mutex);
+
+		if (pool->jobs)
+			process_slice(pool, pool->jobs);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+task_pool_t *task_pool_create(const char *name, size_t threads)
+{
+	struct task_pool *pool = bzalloc(sizeof(struct task_pool));
+	pool->name = bstrdup(name ? name : "task pool");
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (pthread_cond_init(&pool->work_cond, NULL) != 0)
+		goto fail_work_cond;
+	if (pthread_cond_init(&pool->done_cond, NULL) != 0)
+		goto fail_done_cond;
+
+	for (size_t i = 0; i < threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, task_pool_thread, pool) != 0) {
+			blog(LOG_WARNING, "task_pool_create: Failed to create "
+			                  "thread %d of %d for '%s'",
+			                  (int)i + 1, (int)threads, pool->name);
+			break;
+		}
+
+		da_push_back(pool->threads, &thread);
+	}
+
+	return pool;
+
+fail_done_cond:
+	pthread_cond_destroy(&pool->work_cond);
+fail_work_cond:
+	pthread_mutex_destroy(&pool->mutex);
+fail_mutex:
+	bfree(pool->name);
+	bfree(pool);
+	return NULL;
+}
+
+void task_pool_destroy(task_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < pool->threads.num; i++)
+		pthread_join(pool->threads.array[i], NULL);
+
+	da_free(pool->threads);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->name);
+	bfree(pool);
+}
+
+size_t task_pool_threads(const task_pool_t *pool)
+{
+	return pool ? pool->threads.num : 0;
+}
+
+static inline void run_inline(task_pool_func_t func, void *param,
+		size_t count, const char *profile_name)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (profile_name)
+			profile_start(profile_name);
+		func(param, i);
+		if (profile_name)
+			profile_end(profile_name);
+	}
+}
+
+void task_pool_run(task_pool_t *pool, task_pool_func_t func, void *param,
+		size_t count, const char *profile_name)
+{
+	struct task_job job = {
+		.func         = func,
+		.param        = param,
+		.profile_name = profile_name,
+		.count        = count,
+		.remaining    = count
+	};
+	struct task_job **tail;
+
+	if (!count)
+		return;
+
+	if (!pool || !pool->threads.num || count == 1) {
+		run_inline(func, param, count, profile_name);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	tail = &pool->jobs;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = &job;
+
+	pthread_cond_broadcast(&pool->work_cond);
+
+	while (job.next_idx < job.count)
+		process_slice(pool, &job);
+	while (job.remaining)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *   Persistent pool of worker threads used to split a piece of work into a
+ * number of independent slices.  task_pool_run blocks until every slice has
+ * completed, and the calling thread processes slices as well, so a pool with
+ * no threads simply runs everything inline.  Safe to use from multiple
+ * threads at once.
+ */
+
+typedef struct task_pool task_pool_t;
+typedef void (*task_pool_func_t)(void *param, size_t idx);
+
+EXPORT task_pool_t *task_pool_create(const char *name, size_t threads);
+EXPORT void task_pool_destroy(task_pool_t *pool);
+
+EXPORT size_t task_pool_threads(const task_pool_t *pool);
+
+/**
+ * Calls func once for each slice index in [0, count), spread over the pool's
+ * worker threads and the calling thread.  If profile_name is non-NULL, each
+ * slice is profiled under that name (must be a static or stored string).
+ */
+EXPORT void task_pool_run(task_pool_t *pool, task_pool_func_t func,
+		void *param, size_t count, const char *profile_name);
+
+#ifdef __cplusplus
+}
+#endif
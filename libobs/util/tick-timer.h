@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include "platform.h"
+#include "profiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sleeps to absolute deadlines for periodic threads (video/audio ticks), and
+ * keeps track of how late they wake up.  Wake-up latency is recorded to the
+ * profiler under latency_name, if set.
+ */
+
+struct tick_timer {
+	const char *latency_name;
+	uint64_t   waits;
+	uint64_t   late_waits;
+	uint64_t   max_latency;
+};
+
+static inline void tick_timer_init(struct tick_timer *timer,
+		const char *latency_name)
+{
+	timer->latency_name = latency_name;
+	timer->waits        = 0;
+	timer->late_waits   = 0;
+	timer->max_latency  = 0;
+}
+
+/* returns false if the deadline had already passed */
+static inline bool tick_timer_sleepto(struct tick_timer *timer,
+		uint64_t deadline)
+{
+	bool on_time = os_sleepto_ns(deadline);
+	uint64_t cur_time = os_gettime_ns();
+	uint64_t latency = cur_time > deadline ? cur_time - deadline : 0;
+
+	timer->waits++;
+	if (!on_time)
+		timer->late_waits++;
+	if (latency > timer->max_latency)
+		timer->max_latency = latency;
+
+	if (timer->latency_name)
+		profile_record(timer->latency_name, latency);
+
+	return on_time;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,6 +20,7 @@ struct image_source {
 
 	char         *file;
 	bool         persistent;
+	uint64_t     gif_cache_limit;
 	time_t       file_timestamp;
 	float        update_time_elapsed;
 	uint64_t     last_time;
@@ -54,7 +55,8 @@ static void image_source_load(struct image_source *context)
 	if (file && *file) {
 		debug("loading texture '%s'", file);
 		context->file_timestamp = get_modified_timestamp(file);
-		gs_image_file_init(&context->image, file);
+		gs_image_file_init_limit(&context->image, file,
+				context->gif_cache_limit);
 		context->update_time_elapsed = 0;
 
 		obs_enter_graphics();
@@ -78,11 +80,14 @@ static void image_source_update(void *data, obs_data_t *settings)
 	struct image_source *context = data;
 	const char *file = obs_data_get_string(settings, "file");
 	const bool unload = obs_data_get_bool(settings, "unload");
+	const int cache_limit = (int)obs_data_get_int(settings,
+			"gif_cache_limit");
 
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
 	context->persistent = !unload;
+	context->gif_cache_limit = (uint64_t)cache_limit * 1024 * 1024;
 
 	/* Load the image if the source is persistent or showing */
 	if (context->persistent || obs_source_showing(context->source))
@@ -94,6 +99,8 @@ static void image_source_update(void *data, obs_data_t *settings)
 static void image_source_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_bool(settings, "unload", false);
+	obs_data_set_default_int(settings, "gif_cache_limit",
+			GS_IMAGE_FILE_DEFAULT_CACHE_LIMIT / (1024 * 1024));
 }
 
 static void image_source_show(void *data)
@@ -244,6 +251,9 @@ static obs_properties_t *image_source_properties(void *data)
 			OBS_PATH_FILE, image_filter, path.array);
 	obs_properties_add_bool(props,
 			"unload", obs_module_text("UnloadWhenNotShowing"));
+	obs_properties_add_int(props,
+			"gif_cache_limit", obs_module_text("GifCacheLimit"),
+			0, 4096, 16);
 	dstr_free(&path);
 
 	return props;
@@ -2,7 +2,12 @@
 #include <X11/Xatom.h>
 #include <X11/Xutil.h>
 #include <X11/extensions/Xcomposite.h>
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
 
+#include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 #include <pthread.h>
 
@@ -247,6 +252,53 @@ namespace XCompcap
 
 	static std::unordered_set<Window> changedWindows;
 	static pthread_mutex_t changeLock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef HAVE_XDAMAGE
+	static std::unordered_map<Window, XRectangle> damagedWindows;
+	static int damageEventBase = -1;
+	static bool damageChecked = false;
+
+	bool damageIsSupported()
+	{
+		PLock lock(&changeLock);
+
+		if (!damageChecked) {
+			int errorBase;
+
+			if (!XDamageQueryExtension(disp(), &damageEventBase,
+						&errorBase)) {
+				blog(LOG_INFO, "DAMAGE extension not "
+						"supported, copying full "
+						"frames");
+				damageEventBase = -1;
+			}
+
+			damageChecked = true;
+		}
+
+		return damageEventBase != -1;
+	}
+
+	static void addDamage(Window win, const XRectangle &area)
+	{
+		auto it = damagedWindows.find(win);
+
+		if (it == damagedWindows.end()) {
+			damagedWindows[win] = area;
+			return;
+		}
+
+		XRectangle &cur = it->second;
+		int right  = std::max(cur.x + cur.width,  area.x + area.width);
+		int bottom = std::max(cur.y + cur.height, area.y + area.height);
+
+		cur.x      = std::min(cur.x, area.x);
+		cur.y      = std::min(cur.y, area.y);
+		cur.width  = right - cur.x;
+		cur.height = bottom - cur.y;
+	}
+#endif
+
 	void processEvents()
 	{
 		PLock lock(&changeLock);
@@ -269,6 +321,15 @@ namespace XCompcap
 
 			if (ev.type == DestroyNotify)
 				changedWindows.insert(ev.xdestroywindow.event);
+
+#ifdef HAVE_XDAMAGE
+			if (damageEventBase != -1 &&
+			    ev.type == damageEventBase + XDamageNotify) {
+				XDamageNotifyEvent *dev =
+					(XDamageNotifyEvent*)&ev;
+				addDamage(dev->drawable, dev->area);
+			}
+#endif
 		}
 
 		XUnlockDisplay(disp());
@@ -288,6 +349,22 @@ namespace XCompcap
 		return false;
 	}
 
+#ifdef HAVE_XDAMAGE
+	bool getWindowDamage(Window win, XRectangle &area)
+	{
+		PLock lock(&changeLock);
+
+		auto it = damagedWindows.find(win);
+
+		if (it != damagedWindows.end()) {
+			area = it->second;
+			damagedWindows.erase(it);
+			return true;
+		}
+
+		return false;
+	}
+#endif
 }
 
 
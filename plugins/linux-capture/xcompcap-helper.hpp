@@ -100,4 +100,9 @@ namespace XCompcap
 
 	void processEvents();
 	bool windowWasReconfigured(Window win);
+
+#ifdef HAVE_XDAMAGE
+	bool damageIsSupported();
+	bool getWindowDamage(Window win, XRectangle &area);
+#endif
 }
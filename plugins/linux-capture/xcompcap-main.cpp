@@ -2,8 +2,12 @@
 #include <glad/glad_glx.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xcomposite.h>
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
 #include <pthread.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <obs-module.h>
@@ -89,6 +93,11 @@ obs_properties_t *XCompcapMain::properties()
 	obs_properties_add_bool(props, "exclude_alpha",
 			obs_module_text("ExcludeAlpha"));
 
+#ifdef HAVE_XDAMAGE
+	obs_properties_add_bool(props, "use_damage",
+			obs_module_text("UseDamage"));
+#endif
+
 	return props;
 }
 
@@ -104,6 +113,7 @@ void XCompcapMain::defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "show_cursor", true);
 	obs_data_set_default_bool(settings, "include_border", false);
 	obs_data_set_default_bool(settings, "exclude_alpha", false);
+	obs_data_set_default_bool(settings, "use_damage", true);
 }
 
 #define FIND_WINDOW_INTERVAL 2.0
@@ -148,6 +158,7 @@ struct XCompcapMain_private
 	bool lockX;
 	bool include_border;
 	bool exclude_alpha;
+	bool use_damage;
 
 	double window_check_time = 0.0;
 
@@ -160,6 +171,15 @@ struct XCompcapMain_private
 	gs_texture_t *tex;
 	gs_texture_t *gltex;
 
+	/* only the damaged part of the window is copied when the DAMAGE
+	 * extension is available */
+#ifdef HAVE_XDAMAGE
+	Damage damage = 0;
+#endif
+	bool full_copy = true;
+	uint64_t bytes_copied = 0;
+	uint64_t bytes_saved = 0;
+
 	pthread_mutex_t lock;
 	pthread_mutexattr_t lockattr;
 
@@ -250,6 +270,22 @@ static void xcc_cleanup(XCompcapMain_private *p)
 	PLock lock(&p->lock);
 	XDisplayLock xlock;
 
+	if (p->bytes_copied || p->bytes_saved) {
+		blog(LOG_INFO, "Copied %llu MB, %llu MB saved by only copying "
+				"damaged regions",
+				(unsigned long long)(p->bytes_copied >> 20),
+				(unsigned long long)(p->bytes_saved >> 20));
+		p->bytes_copied = 0;
+		p->bytes_saved = 0;
+	}
+
+#ifdef HAVE_XDAMAGE
+	if (p->damage) {
+		XDamageDestroy(xdisp, p->damage);
+		p->damage = 0;
+	}
+#endif
+
 	if (p->gltex) {
 		gs_texture_destroy(p->gltex);
 		p->gltex = 0;
@@ -301,6 +337,7 @@ void XCompcapMain::updateSettings(obs_data_t *settings)
 		p->show_cursor = obs_data_get_bool(settings, "show_cursor");
 		p->include_border = obs_data_get_bool(settings, "include_border");
 		p->exclude_alpha = obs_data_get_bool(settings, "exclude_alpha");
+		p->use_damage = obs_data_get_bool(settings, "use_damage");
 	} else {
 		p->win = prevWin;
 	}
@@ -458,8 +495,63 @@ void XCompcapMain::updateSettings(obs_data_t *settings)
 	glXBindTexImageEXT(xdisp, p->glxpixmap, GLX_FRONT_LEFT_EXT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+#ifdef HAVE_XDAMAGE
+	if (p->use_damage && XCompcap::damageIsSupported()) {
+		XRectangle area;
+
+		p->damage = XDamageCreate(xdisp, p->win,
+				XDamageReportBoundingBox);
+		XCompcap::getWindowDamage(p->win, area);
+	}
+#endif
+
+	p->full_copy = true;
 }
 
+#ifdef HAVE_XDAMAGE
+/* gets the part of the captured area that was damaged since the last copy,
+ * returns false if nothing needs to be copied */
+static bool xcc_get_copy_area(XCompcapMain_private *p, uint32_t srcX,
+		uint32_t srcY, uint32_t &x, uint32_t &y, uint32_t &cx,
+		uint32_t &cy)
+{
+	XRectangle area;
+	bool damaged = XCompcap::getWindowDamage(p->win, area);
+
+	/* anything that changes after this will be reported again, so it is
+	 * picked up by the next copy */
+	if (damaged)
+		XDamageSubtract(xdisp, p->damage, None, None);
+
+	if (p->full_copy) {
+		p->full_copy = false;
+		return true;
+	}
+
+	if (!damaged)
+		return false;
+
+	/* damage is relative to the inside of the border, the pixmap
+	 * includes it */
+	int left   = std::max(area.x + (int)p->border, (int)srcX);
+	int top    = std::max(area.y + (int)p->border, (int)srcY);
+	int right  = std::min(area.x + area.width + (int)p->border,
+			(int)(srcX + cx));
+	int bottom = std::min(area.y + area.height + (int)p->border,
+			(int)(srcY + cy));
+
+	if (right <= left || bottom <= top)
+		return false;
+
+	x  = left - srcX;
+	y  = top - srcY;
+	cx = right - left;
+	cy = bottom - top;
+	return true;
+}
+#endif
+
 void XCompcapMain::tick(float seconds)
 {
 	if (!obs_source_showing(p->source))
@@ -508,20 +600,34 @@ void XCompcapMain::tick(float seconds)
 		XSync(xdisp, 0);
 	}
 
-	if (p->include_border) {
+	uint32_t srcX = p->cur_cut_left;
+	uint32_t srcY = p->cur_cut_top;
+	uint32_t x = 0, y = 0, cx = width(), cy = height();
+	uint64_t full_size = (uint64_t)cx * cy * 4;
+	bool copy = true;
+
+	if (!p->include_border) {
+		srcX += p->border;
+		srcY += p->border;
+	}
+
+#ifdef HAVE_XDAMAGE
+	if (p->damage)
+		copy = xcc_get_copy_area(p, srcX, srcY, x, y, cx, cy);
+#endif
+
+	if (copy) {
 		gs_copy_texture_region(
-				p->tex, 0, 0,
+				p->tex, x, y,
 				p->gltex,
-				p->cur_cut_left,
-				p->cur_cut_top,
-				width(), height());
+				srcX + x,
+				srcY + y,
+				cx, cy);
+
+		p->bytes_copied += (uint64_t)cx * cy * 4;
+		p->bytes_saved  += full_size - (uint64_t)cx * cy * 4;
 	} else {
-		gs_copy_texture_region(
-				p->tex, 0, 0,
-				p->gltex,
-				p->cur_cut_left + p->border,
-				p->cur_cut_top + p->border,
-				width(), height());
+		p->bytes_saved  += full_size;
 	}
 
 	if (p->cursor && p->show_cursor) {
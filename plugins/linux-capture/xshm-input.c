@@ -19,11 +19,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdlib.h>
 #include <inttypes.h>
 #include <xcb/shm.h>
+#ifdef HAVE_XDAMAGE
+#include <xcb/damage.h>
+#endif
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
 
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -31,12 +36,39 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/*
+ * The screen is captured on a separate thread in to one of several shm
+ * segments, so that the X server round trip is never done on the video
+ * thread.  The video tick only uploads the most recently completed buffer.
+ * With three buffers the capture thread always has one to write in to, even
+ * while the tick is uploading one and another is waiting to be picked up.
+ */
+#define XSHM_BUFFERS 3
+
+/*
+ * When the DAMAGE extension is available only the bounding box of the area
+ * that changed since the last capture is fetched, and only that part of the
+ * texture is updated.  Each buffer holds the pixels of its rectangle packed
+ * at the start of the shm segment.
+ */
+struct xshm_rect {
+	int_fast32_t x;
+	int_fast32_t y;
+	int_fast32_t cx;
+	int_fast32_t cy;
+};
+
+struct xshm_buffer {
+	xcb_shm_t                           *shm;
+	xcb_xfixes_get_cursor_image_reply_t *cursor;
+	struct xshm_rect                    rect;
+};
+
 struct xshm_data {
 	obs_source_t     *source;
 
 	xcb_connection_t *xcb;
 	xcb_screen_t     *xcb_screen;
-	xcb_shm_t        *xshm;
 	xcb_xcursor_t    *cursor;
 
 	char             *server;
@@ -51,8 +83,88 @@ struct xshm_data {
 	bool             show_cursor;
 	bool             use_xinerama;
 	bool             advanced;
+	bool             use_damage;
+
+#ifdef HAVE_XDAMAGE
+	xcb_damage_damage_t damage;
+	uint8_t          damage_event;
+#endif
+	struct xshm_rect damaged;
+	bool             damage_pending;
+	bool             full_damage;
+	volatile bool    damage_failed;
+
+	struct xshm_buffer buffers[XSHM_BUFFERS];
+	pthread_mutex_t  buffer_mutex;
+	int              latest;
+	int              in_use;
+
+	pthread_t        capture_thread;
+	bool             capture_thread_active;
+	os_event_t       *stop_event;
+	int              capture_fps;
+	uint64_t         capture_interval_ns;
+
+	/* statistics, protected by buffer_mutex */
+	uint64_t         frames_captured;
+	uint64_t         frames_dropped;
+	uint64_t         frames_missed;
+	uint64_t         latency_total_ns;
+	uint64_t         latency_max_ns;
+	uint64_t         bytes_captured;
+	uint64_t         bytes_saved;
 };
 
+static inline bool xshm_rect_empty(const struct xshm_rect *rect)
+{
+	return rect->cx <= 0 || rect->cy <= 0;
+}
+
+static inline void xshm_rect_union(struct xshm_rect *dst,
+		const struct xshm_rect *src)
+{
+	int_fast32_t right, bottom;
+
+	if (xshm_rect_empty(src))
+		return;
+	if (xshm_rect_empty(dst)) {
+		*dst = *src;
+		return;
+	}
+
+	right  = (dst->x + dst->cx > src->x + src->cx) ?
+		dst->x + dst->cx : src->x + src->cx;
+	bottom = (dst->y + dst->cy > src->y + src->cy) ?
+		dst->y + dst->cy : src->y + src->cy;
+
+	if (src->x < dst->x)
+		dst->x = src->x;
+	if (src->y < dst->y)
+		dst->y = src->y;
+
+	dst->cx = right - dst->x;
+	dst->cy = bottom - dst->y;
+}
+
+static inline void xshm_rect_clip(struct xshm_rect *rect,
+		int_fast32_t width, int_fast32_t height)
+{
+	int_fast32_t right  = rect->x + rect->cx;
+	int_fast32_t bottom = rect->y + rect->cy;
+
+	if (rect->x < 0)
+		rect->x = 0;
+	if (rect->y < 0)
+		rect->y = 0;
+	if (right > width)
+		right = width;
+	if (bottom > height)
+		bottom = height;
+
+	rect->cx = right - rect->x;
+	rect->cy = bottom - rect->y;
+}
+
 /**
  * Resize the texture
  *
@@ -83,6 +195,12 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_xinerama_id)->present)
 		blog(LOG_INFO, "Missing Xinerama extension !");
 
+#ifdef HAVE_XDAMAGE
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing DAMAGE extension, capturing full "
+				"frames");
+#endif
+
 	return ok;
 }
 
@@ -143,6 +261,36 @@ static const char* xshm_getname(void *unused)
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->capture_thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->capture_thread, NULL);
+		os_event_reset(data->stop_event);
+		data->capture_thread_active = false;
+	}
+
+	if (data->frames_captured) {
+		blog(LOG_INFO, "Captured %"PRIu64" frames, %"PRIu64" dropped, "
+				"%"PRIu64" missed, average latency %"PRIu64
+				" us, max %"PRIu64" us",
+				data->frames_captured, data->frames_dropped,
+				data->frames_missed,
+				data->latency_total_ns / data->frames_captured
+					/ 1000,
+				data->latency_max_ns / 1000);
+		blog(LOG_INFO, "Fetched %"PRIu64" MB, %"PRIu64" MB saved by "
+				"only fetching damaged regions",
+				data->bytes_captured / (1024 * 1024),
+				data->bytes_saved / (1024 * 1024));
+	}
+
+	data->frames_captured  = 0;
+	data->frames_dropped   = 0;
+	data->frames_missed    = 0;
+	data->latency_total_ns = 0;
+	data->latency_max_ns   = 0;
+	data->bytes_captured   = 0;
+	data->bytes_saved      = 0;
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -156,11 +304,28 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
-	if (data->xshm) {
-		xshm_xcb_detach(data->xshm);
-		data->xshm = NULL;
+	for (size_t i = 0; i < XSHM_BUFFERS; i++) {
+		struct xshm_buffer *buf = &data->buffers[i];
+
+		if (buf->shm) {
+			xshm_xcb_detach(buf->shm);
+			buf->shm = NULL;
+		}
+
+		free(buf->cursor);
+		buf->cursor = NULL;
 	}
 
+	data->latest = -1;
+	data->in_use = -1;
+
+#ifdef HAVE_XDAMAGE
+	if (data->damage) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		data->damage = 0;
+	}
+#endif
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
@@ -172,6 +337,245 @@ static void xshm_capture_stop(struct xshm_data *data)
 	}
 }
 
+#ifdef HAVE_XDAMAGE
+/**
+ * Start tracking damage of the root window
+ */
+static bool xshm_init_damage(struct xshm_data *data)
+{
+	const xcb_query_extension_reply_t *ext;
+	xcb_damage_query_version_cookie_t ver_c;
+
+	ext = xcb_get_extension_data(data->xcb, &xcb_damage_id);
+	if (!ext || !ext->present)
+		return false;
+
+	ver_c = xcb_damage_query_version(data->xcb,
+			XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, ver_c, NULL));
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			XCB_DAMAGE_REPORT_LEVEL_BOUNDING_BOX);
+
+	data->damage_event   = ext->first_event + XCB_DAMAGE_NOTIFY;
+	data->damage_pending = false;
+	data->full_damage    = true;
+	return true;
+}
+
+/**
+ * Add the areas of all pending damage events to the damaged rectangle
+ */
+static void xshm_process_damage(struct xshm_data *data)
+{
+	xcb_generic_event_t *ev;
+
+	while ((ev = xcb_poll_for_event(data->xcb)) != NULL) {
+		if ((ev->response_type & ~0x80) == data->damage_event) {
+			xcb_damage_notify_event_t *dev = (void*)ev;
+			struct xshm_rect rect = {
+				dev->area.x - data->x_org,
+				dev->area.y - data->y_org,
+				dev->area.width,
+				dev->area.height
+			};
+
+			xshm_rect_clip(&rect, data->width, data->height);
+			xshm_rect_union(&data->damaged, &rect);
+			data->damage_pending = true;
+		}
+
+		free(ev);
+	}
+}
+
+static inline bool xshm_using_damage(struct xshm_data *data)
+{
+	if (data->damage && os_atomic_load_bool(&data->damage_failed)) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		data->damage = 0;
+	}
+
+	return data->damage != 0;
+}
+
+#else
+
+/* built without xcb-damage, always capture full frames */
+static inline bool xshm_init_damage(struct xshm_data *data)
+{
+	UNUSED_PARAMETER(data);
+	return false;
+}
+
+static inline void xshm_process_damage(struct xshm_data *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static inline bool xshm_using_damage(struct xshm_data *data)
+{
+	UNUSED_PARAMETER(data);
+	return false;
+}
+#endif
+
+/**
+ * Capture the screen in to a buffer that is not waiting to be uploaded or
+ * being uploaded, and make it the latest buffer
+ */
+static void xshm_capture_frame(struct xshm_data *data)
+{
+	struct xshm_buffer                   *buf = NULL;
+	int                                  idx = -1;
+	struct xshm_rect                     rect = {0};
+	struct xshm_rect                     full = {0};
+	uint64_t                             start, latency;
+	uint64_t                             full_size, size;
+	xcb_shm_get_image_cookie_t           img_c;
+	xcb_shm_get_image_reply_t            *img_r = NULL;
+	xcb_xfixes_get_cursor_image_cookie_t cur_c;
+	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+
+	full.cx = data->width;
+	full.cy = data->height;
+
+	if (xshm_using_damage(data)) {
+		xshm_process_damage(data);
+		rect = data->full_damage ? full : data->damaged;
+	} else {
+		rect = full;
+	}
+
+	pthread_mutex_lock(&data->buffer_mutex);
+	for (int i = 0; i < XSHM_BUFFERS; i++) {
+		if (i != data->latest && i != data->in_use) {
+			idx = i;
+			break;
+		}
+	}
+
+	/* the latest buffer is going to be replaced before it was uploaded,
+	 * so its area has to be fetched again as well */
+	if (data->latest >= 0)
+		xshm_rect_union(&rect, &data->buffers[data->latest].rect);
+	pthread_mutex_unlock(&data->buffer_mutex);
+
+	buf = &data->buffers[idx];
+	start = os_gettime_ns();
+
+	/* anything that changes after this will be reported again, so it is
+	 * picked up by the next capture */
+#ifdef HAVE_XDAMAGE
+	if (data->damage && data->damage_pending)
+		xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+				XCB_NONE);
+#endif
+
+	data->damaged.cx     = 0;
+	data->damaged.cy     = 0;
+	data->damage_pending = false;
+	data->full_damage    = false;
+
+	if (!xshm_rect_empty(&rect))
+		img_c = xcb_shm_get_image_unchecked(data->xcb,
+				data->xcb_screen->root,
+				data->x_org + rect.x, data->y_org + rect.y,
+				rect.cx, rect.cy, ~0,
+				XCB_IMAGE_FORMAT_Z_PIXMAP, buf->shm->seg, 0);
+	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+
+	if (!xshm_rect_empty(&rect))
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+
+	latency = os_gettime_ns() - start;
+
+	if (!img_r && !xshm_rect_empty(&rect)) {
+		free(cur_r);
+		data->full_damage = true;
+		return;
+	}
+
+	full_size = (uint64_t)full.cx * full.cy * 4;
+	size = xshm_rect_empty(&rect) ? 0 : (uint64_t)rect.cx * rect.cy * 4;
+
+	pthread_mutex_lock(&data->buffer_mutex);
+
+	free(buf->cursor);
+	buf->cursor = cur_r;
+	buf->rect   = rect;
+
+	if (data->latest >= 0)
+		data->frames_dropped++;
+	data->latest = idx;
+
+	data->frames_captured++;
+	data->latency_total_ns += latency;
+	if (latency > data->latency_max_ns)
+		data->latency_max_ns = latency;
+
+	data->bytes_captured += size;
+	data->bytes_saved    += full_size - size;
+
+	pthread_mutex_unlock(&data->buffer_mutex);
+
+	free(img_r);
+}
+
+/**
+ * Capture thread, captures at the capture rate independently of the
+ * video tick
+ */
+static void *xshm_capture_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+
+	const uint64_t interval = data->capture_interval_ns;
+	uint64_t next = os_gettime_ns();
+
+	os_set_thread_name("xshm-input: capture");
+
+	for (;;) {
+		uint64_t now;
+
+		if (obs_source_showing(data->source))
+			xshm_capture_frame(data);
+		else if (xshm_using_damage(data))
+			xshm_process_damage(data);
+
+		next += interval;
+		now = os_gettime_ns();
+
+		/* skip the intervals that were missed instead of trying to
+		 * catch up on them */
+		if (now >= next + interval) {
+			uint64_t missed = (now - next) / interval;
+
+			pthread_mutex_lock(&data->buffer_mutex);
+			data->frames_missed += missed;
+			pthread_mutex_unlock(&data->buffer_mutex);
+
+			next += missed * interval;
+		}
+
+		if (now < next) {
+			unsigned long ms = (unsigned long)
+				((next - now) / 1000000);
+			if (os_event_timedwait(data->stop_event, ms) == 0)
+				break;
+
+			os_sleepto_ns(next);
+
+		} else if (os_event_try(data->stop_event) == 0) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
 /**
  * Start the capture
  */
@@ -196,12 +600,19 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm = xshm_xcb_attach(data->xcb, data->width, data->height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
+	for (size_t i = 0; i < XSHM_BUFFERS; i++) {
+		data->buffers[i].shm = xshm_xcb_attach(data->xcb,
+				data->width, data->height);
+		if (!data->buffers[i].shm) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
 	}
 
+	data->damage_failed = false;
+	if (data->use_damage)
+		xshm_init_damage(data);
+
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->x_org, data->y_org);
 
@@ -211,6 +622,13 @@ static void xshm_capture_start(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	if (pthread_create(&data->capture_thread, NULL, xshm_capture_thread,
+				data) != 0) {
+		blog(LOG_ERROR, "failed to create capture thread !");
+		goto fail;
+	}
+
+	data->capture_thread_active = true;
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -228,7 +646,22 @@ static void xshm_update(void *vptr, obs_data_t *settings)
 	data->screen_id   = obs_data_get_int(settings, "screen");
 	data->show_cursor = obs_data_get_bool(settings, "show_cursor");
 	data->advanced    = obs_data_get_bool(settings, "advanced");
+	data->use_damage  = obs_data_get_bool(settings, "use_damage");
 	data->server      = bstrdup(obs_data_get_string(settings, "server"));
+	data->capture_fps = (int)obs_data_get_int(settings, "capture_fps");
+
+	if (data->capture_fps > 0) {
+		data->capture_interval_ns = 1000000000ULL /
+			(uint64_t)data->capture_fps;
+	} else {
+		struct obs_video_info ovi;
+
+		if (obs_get_video_info(&ovi) && ovi.fps_num)
+			data->capture_interval_ns = 1000000000ULL *
+				ovi.fps_den / ovi.fps_num;
+		else
+			data->capture_interval_ns = 1000000000ULL / 30;
+	}
 
 	xshm_capture_start(data);
 }
@@ -241,6 +674,8 @@ static void xshm_defaults(obs_data_t *defaults)
 	obs_data_set_default_int(defaults, "screen", 0);
 	obs_data_set_default_bool(defaults, "show_cursor", true);
 	obs_data_set_default_bool(defaults, "advanced", false);
+	obs_data_set_default_int(defaults, "capture_fps", 0);
+	obs_data_set_default_bool(defaults, "use_damage", true);
 }
 
 /**
@@ -339,6 +774,12 @@ static obs_properties_t *xshm_properties(void *vptr)
 			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
 	obs_properties_add_bool(props, "show_cursor",
 			obs_module_text("CaptureCursor"));
+	obs_properties_add_int(props, "capture_fps",
+			obs_module_text("CaptureFPS"), 0, 240, 1);
+#ifdef HAVE_XDAMAGE
+	obs_properties_add_bool(props, "use_damage",
+			obs_module_text("UseDamage"));
+#endif
 	obs_property_t *advanced = obs_properties_add_bool(props, "advanced",
 			obs_module_text("AdvancedSettings"));
 	obs_property_t *server = obs_properties_add_text(props, "server",
@@ -367,62 +808,122 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	os_event_destroy(data->stop_event);
+	pthread_mutex_destroy(&data->buffer_mutex);
 	bfree(data);
 }
 
+/**
+ * Get the capture statistics
+ */
+static void xshm_get_capture_stats(void *vptr, calldata_t *cd)
+{
+	XSHM_DATA(vptr);
+
+	pthread_mutex_lock(&data->buffer_mutex);
+
+	calldata_set_int(cd, "captured", (long long)data->frames_captured);
+	calldata_set_int(cd, "dropped", (long long)data->frames_dropped);
+	calldata_set_int(cd, "missed", (long long)data->frames_missed);
+	calldata_set_int(cd, "latency_us", data->frames_captured ?
+			(long long)(data->latency_total_ns /
+				data->frames_captured / 1000) : 0);
+	calldata_set_int(cd, "max_latency_us",
+			(long long)(data->latency_max_ns / 1000));
+	calldata_set_int(cd, "captured_mb",
+			(long long)(data->bytes_captured / (1024 * 1024)));
+	calldata_set_int(cd, "saved_mb",
+			(long long)(data->bytes_saved / (1024 * 1024)));
+
+	pthread_mutex_unlock(&data->buffer_mutex);
+}
+
 /**
  * Create the capture
  */
 static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+
 	data->source = source;
+	data->latest = -1;
+	data->in_use = -1;
+
+	if (pthread_mutex_init(&data->buffer_mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail_event;
+
+	proc_handler_add(ph, "void get_capture_stats(out int captured, "
+			"out int dropped, out int missed, out int latency_us, "
+			"out int max_latency_us, out int captured_mb, "
+			"out int saved_mb)",
+			xshm_get_capture_stats, data);
 
 	xshm_update(data, settings);
 
 	return data;
+
+fail_event:
+	pthread_mutex_destroy(&data->buffer_mutex);
+fail_mutex:
+	bfree(data);
+	return NULL;
 }
 
 /**
- * Prepare the capture data
+ * Upload the latest captured buffer, if there is a new one
  */
 static void xshm_video_tick(void *vptr, float seconds)
 {
 	UNUSED_PARAMETER(seconds);
 	XSHM_DATA(vptr);
 
+	struct xshm_buffer *buf;
+
 	if (!data->texture)
 		return;
-	if (!obs_source_showing(data->source))
-		return;
 
-	xcb_shm_get_image_cookie_t           img_c;
-	xcb_shm_get_image_reply_t            *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+	pthread_mutex_lock(&data->buffer_mutex);
+	data->in_use = data->latest;
+	data->latest = -1;
+	pthread_mutex_unlock(&data->buffer_mutex);
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-			data->x_org, data->y_org, data->width, data->height,
-			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
-
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	if (data->in_use < 0)
+		return;
 
-	if (!img_r)
-		goto exit;
+	buf = &data->buffers[data->in_use];
 
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *) data->xshm->data,
-		data->width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
+	if (xshm_rect_empty(&buf->rect)) {
+		/* nothing changed, only the cursor needs updating */
+
+	} else if (buf->rect.cx == data->width &&
+	           buf->rect.cy == data->height) {
+		gs_texture_set_image(data->texture, (void *) buf->shm->data,
+			data->width * 4, false);
+
+	} else if (!gs_texture_set_image_region(data->texture,
+				buf->rect.x, buf->rect.y,
+				buf->rect.cx, buf->rect.cy,
+				(void *) buf->shm->data,
+				buf->rect.cx * 4)) {
+		/* the renderer can't update part of a texture, so fall back
+		 * to fetching full frames */
+		blog(LOG_WARNING, "Partial texture updates not supported, "
+				"capturing full frames");
+		os_atomic_set_bool(&data->damage_failed, true);
+	}
+
+	xcb_xcursor_update(data->cursor, buf->cursor);
 
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
-	free(cur_r);
+	pthread_mutex_lock(&data->buffer_mutex);
+	data->in_use = -1;
+	pthread_mutex_unlock(&data->buffer_mutex);
 }
 
 /**
@@ -0,0 +1,253 @@
+/*
+Copyright (C) 2026 by agent <agent@local>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#include "v4l2-decoder.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
+
+/* more decoding threads only add latency */
+#define MAX_DECODER_THREADS 4
+
+int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt)
+{
+	enum AVCodecID id;
+	AVCodec *codec;
+	int threads;
+
+	memset(decoder, 0, sizeof(struct v4l2_decoder));
+
+	switch (pixfmt) {
+	case V4L2_PIX_FMT_MJPEG:
+	case V4L2_PIX_FMT_JPEG:  id = AV_CODEC_ID_MJPEG; break;
+	case V4L2_PIX_FMT_H264:  id = AV_CODEC_ID_H264;  break;
+	default:
+		return -1;
+	}
+
+	avcodec_register_all();
+
+	codec = avcodec_find_decoder(id);
+	if (!codec) {
+		blog(LOG_ERROR, "failed to find %s decoder",
+				avcodec_get_name(id));
+		return -1;
+	}
+
+	decoder->context = avcodec_alloc_context3(codec);
+	if (!decoder->context)
+		goto fail;
+
+	threads = os_get_logical_cores();
+	if (threads > MAX_DECODER_THREADS)
+		threads = MAX_DECODER_THREADS;
+
+	decoder->context->thread_count = threads;
+	decoder->context->thread_type  = FF_THREAD_FRAME;
+
+	if (avcodec_open2(decoder->context, codec, NULL) < 0) {
+		blog(LOG_ERROR, "failed to open %s decoder",
+				avcodec_get_name(id));
+		goto fail;
+	}
+
+	decoder->frame = av_frame_alloc();
+	if (!decoder->frame)
+		goto fail;
+
+	blog(LOG_INFO, "Decoding %s with %d threads", avcodec_get_name(id),
+			decoder->context->thread_count);
+	return 0;
+
+fail:
+	v4l2_destroy_decoder(decoder);
+	return -1;
+}
+
+void v4l2_destroy_decoder(struct v4l2_decoder *decoder)
+{
+	if (decoder->context) {
+		avcodec_close(decoder->context);
+		av_free(decoder->context);
+	}
+
+	if (decoder->frame)
+		av_frame_free(&decoder->frame);
+
+	bfree(decoder->packet);
+	bfree(decoder->packed);
+
+	memset(decoder, 0, sizeof(struct v4l2_decoder));
+}
+
+/*
+ * The decoder needs zeroed padding after the data, which the mapped v4l2
+ * buffers do not have
+ */
+static void copy_packet(struct v4l2_decoder *decoder, const uint8_t *data,
+		size_t size)
+{
+	size_t new_size = size + FF_INPUT_BUFFER_PADDING_SIZE;
+
+	if (decoder->packet_size < new_size) {
+		decoder->packet = brealloc(decoder->packet, new_size);
+		decoder->packet_size = new_size;
+	}
+
+	memcpy(decoder->packet, data, size);
+	memset(decoder->packet + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+}
+
+/*
+ * obs has no planar 4:2:2 format, so pack it in to YUY2
+ */
+static void pack_yuv422p(struct v4l2_decoder *decoder, AVFrame *frame,
+		struct obs_source_frame *out)
+{
+	/* odd widths still need the chroma of the last column, so rows are
+	 * rounded up to whole pixel pairs */
+	int    pairs    = frame->width / 2;
+	size_t linesize = (size_t)(frame->width + 1) / 2 * 4;
+	size_t size     = linesize * frame->height;
+
+	if (decoder->packed_size < size) {
+		decoder->packed = brealloc(decoder->packed, size);
+		decoder->packed_size = size;
+	}
+
+	for (int y = 0; y < frame->height; y++) {
+		const uint8_t *lum = frame->data[0] + y * frame->linesize[0];
+		const uint8_t *u   = frame->data[1] + y * frame->linesize[1];
+		const uint8_t *v   = frame->data[2] + y * frame->linesize[2];
+		uint8_t *dst       = decoder->packed + y * linesize;
+
+		for (int x = 0; x < pairs; x++) {
+			*(dst++) = lum[x * 2];
+			*(dst++) = u[x];
+			*(dst++) = lum[x * 2 + 1];
+			*(dst++) = v[x];
+		}
+
+		/* the trailing luma sample is repeated for the padding */
+		if (frame->width & 1) {
+			*(dst++) = lum[pairs * 2];
+			*(dst++) = u[pairs];
+			*(dst++) = lum[pairs * 2];
+			*(dst++) = v[pairs];
+		}
+	}
+
+	memset(out->data, 0, sizeof(out->data));
+	memset(out->linesize, 0, sizeof(out->linesize));
+	out->data[0]     = decoder->packed;
+	out->linesize[0] = (uint32_t)linesize;
+}
+
+static inline enum video_format convert_pixel_format(int f)
+{
+	switch (f) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P: return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P: return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P: return VIDEO_FORMAT_I444;
+	case AV_PIX_FMT_NV12:     return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:  return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_GRAY8:    return VIDEO_FORMAT_Y800;
+	default:;
+	}
+
+	return VIDEO_FORMAT_NONE;
+}
+
+static inline bool is_planar_422(int f)
+{
+	return f == AV_PIX_FMT_YUV422P || f == AV_PIX_FMT_YUVJ422P;
+}
+
+static inline bool is_full_range(AVFrame *frame)
+{
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return frame->color_range == AVCOL_RANGE_JPEG;
+	}
+}
+
+int v4l2_decode_frame(struct v4l2_decoder *decoder, const uint8_t *data,
+		size_t size, uint64_t timestamp, struct obs_source_frame *out)
+{
+	AVPacket packet;
+	AVFrame *frame = decoder->frame;
+	enum video_format format;
+	bool full_range;
+	int got_frame = 0;
+
+	copy_packet(decoder, data, size);
+
+	av_init_packet(&packet);
+	packet.data = decoder->packet;
+	packet.size = (int)size;
+	packet.pts  = (int64_t)timestamp;
+
+	if (avcodec_decode_video2(decoder->context, frame, &got_frame,
+				&packet) < 0)
+		return -1;
+	if (!got_frame)
+		return 0;
+
+	format = convert_pixel_format(frame->format);
+	if (format == VIDEO_FORMAT_NONE) {
+		blog(LOG_ERROR, "unsupported decoded pixel format %d",
+				frame->format);
+		return -1;
+	}
+
+	if (is_planar_422(frame->format)) {
+		pack_yuv422p(decoder, frame, out);
+	} else {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			out->data[i]     = frame->data[i];
+			out->linesize[i] = frame->linesize[i];
+		}
+	}
+
+	full_range = is_full_range(frame);
+
+	if (out->format != format || out->full_range != full_range) {
+		out->format     = format;
+		out->full_range = full_range;
+		video_format_get_parameters(VIDEO_CS_DEFAULT,
+				full_range ? VIDEO_RANGE_FULL :
+					VIDEO_RANGE_PARTIAL,
+				out->color_matrix, out->color_range_min,
+				out->color_range_max);
+	}
+
+	out->width     = frame->width;
+	out->height    = frame->height;
+	out->timestamp = (uint64_t)frame->pkt_pts;
+	return 1;
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2026 by agent <agent@local>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <linux/videodev2.h>
+
+#include <obs-module.h>
+#include <libavcodec/avcodec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Data structure for the decoder of compressed formats
+ */
+struct v4l2_decoder {
+	/** codec context, NULL if the decoder is not initialized */
+	AVCodecContext *context;
+	/** decoded frame */
+	AVFrame *frame;
+
+	/** padded copy of the compressed data */
+	uint8_t *packet;
+	size_t packet_size;
+
+	/** buffer for formats that need to be packed for obs */
+	uint8_t *packed;
+	size_t packed_size;
+};
+
+/**
+ * Check if a v4l2 pixel format is a compressed format that can be decoded
+ *
+ * @param format v4l2 format id
+ *
+ * @return true if the format can be decoded
+ */
+static inline bool v4l2_is_compressed_format(uint_fast32_t format)
+{
+	switch (format) {
+	case V4L2_PIX_FMT_MJPEG:
+	case V4L2_PIX_FMT_JPEG:
+	case V4L2_PIX_FMT_H264:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Initialize the decoder for a compressed format
+ *
+ * @param decoder the decoder structure
+ * @param pixfmt v4l2 pixel format of the compressed data
+ *
+ * @return negative on failure
+ */
+int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt);
+
+/**
+ * Free the decoder
+ *
+ * @param decoder the decoder structure
+ */
+void v4l2_destroy_decoder(struct v4l2_decoder *decoder);
+
+/**
+ * Decode a compressed frame
+ *
+ * Decoding is done with frame threading, so the frame that is returned is
+ * usually not the frame of the data that was passed in, but the oldest frame
+ * the decoder has finished.  The timestamp of that frame is returned in
+ * out->timestamp.  The data of the output frame is only valid until the next
+ * call.
+ *
+ * @param decoder the decoder structure
+ * @param data compressed frame data
+ * @param size size of the compressed frame data
+ * @param timestamp timestamp of the compressed frame
+ * @param out output frame
+ *
+ * @return negative on error, 0 if no frame was output, 1 if a frame was output
+ */
+int v4l2_decode_frame(struct v4l2_decoder *decoder, const uint8_t *data,
+		size_t size, uint64_t timestamp, struct obs_source_frame *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -30,9 +30,15 @@ int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
 
 	memset(&enq, 0, sizeof(enq));
 	enq.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	enq.memory = V4L2_MEMORY_MMAP;
+	enq.memory = buf->memory;
 
 	for (enq.index = 0; enq.index < buf->count; ++enq.index) {
+		if (enq.memory == V4L2_MEMORY_USERPTR) {
+			enq.m.userptr = (unsigned long)
+					buf->info[enq.index].start;
+			enq.length    = buf->info[enq.index].length;
+		}
+
 		if (v4l2_ioctl(dev, VIDIOC_QBUF, &enq) < 0) {
 			blog(LOG_ERROR, "unable to queue buffer");
 			return -1;
@@ -81,8 +87,9 @@ int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
 		return -1;
 	}
 
-	buf->count = req.count;
-	buf->info  = bzalloc(req.count * sizeof(struct v4l2_mmap_info));
+	buf->count  = req.count;
+	buf->memory = req.memory;
+	buf->info   = bzalloc(req.count * sizeof(struct v4l2_mmap_info));
 
 	memset(&map, 0, sizeof(map));
 	map.type   = req.type;
@@ -108,9 +115,38 @@ int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
 	return 0;
 }
 
+int_fast32_t v4l2_create_userptr(int_fast32_t dev,
+		struct v4l2_buffer_data *buf)
+{
+	struct v4l2_requestbuffers req;
+
+	memset(&req, 0, sizeof(req));
+	req.count  = 4;
+	req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	req.memory = V4L2_MEMORY_USERPTR;
+
+	if (v4l2_ioctl(dev, VIDIOC_REQBUFS, &req) < 0) {
+		blog(LOG_INFO, "Device does not support user pointer buffers");
+		return -1;
+	}
+
+	if (req.count < 2) {
+		blog(LOG_ERROR, "Device returned less than 2 buffers");
+		return -1;
+	}
+
+	buf->count  = req.count;
+	buf->memory = req.memory;
+	buf->info   = bzalloc(req.count * sizeof(struct v4l2_mmap_info));
+
+	return 0;
+}
+
 int_fast32_t v4l2_destroy_mmap(struct v4l2_buffer_data *buf)
 {
 	for(uint_fast32_t i = 0; i < buf->count; ++i) {
+		if (buf->memory != V4L2_MEMORY_MMAP)
+			break;
 		if (buf->info[i].start != MAP_FAILED && buf->info[i].start != 0)
 			v4l2_munmap(buf->info[i].start, buf->info[i].length);
 	}
@@ -119,6 +155,7 @@ int_fast32_t v4l2_destroy_mmap(struct v4l2_buffer_data *buf)
 		bfree(buf->info);
 		buf->count = 0;
 	}
+	buf->memory = 0;
 
 	return 0;
 }
@@ -155,7 +192,7 @@ int_fast32_t v4l2_get_input_caps(int_fast32_t dev, int input, uint32_t *caps)
 }
 
 int_fast32_t v4l2_set_format(int_fast32_t dev, int *resolution,
-		int *pixelformat, int *bytesperline)
+		int *pixelformat, int *bytesperline, uint32_t *sizeimage)
 {
 	bool set = false;
 	int width, height;
@@ -188,6 +225,8 @@ int_fast32_t v4l2_set_format(int_fast32_t dev, int *resolution,
 	*resolution   = v4l2_pack_tuple(fmt.fmt.pix.width, fmt.fmt.pix.height);
 	*pixelformat  = fmt.fmt.pix.pixelformat;
 	*bytesperline = fmt.fmt.pix.bytesperline;
+	if (sizeimage)
+		*sizeimage = fmt.fmt.pix.sizeimage;
 	return 0;
 }
 
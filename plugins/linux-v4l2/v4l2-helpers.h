@@ -43,6 +43,8 @@ struct v4l2_mmap_info {
 struct v4l2_buffer_data {
 	/** number of mapped buffers */
 	uint_fast32_t count;
+	/** memory type of the buffers (mmap or user pointer) */
+	uint32_t memory;
 	/** memory info for mapped buffers */
 	struct v4l2_mmap_info *info;
 };
@@ -172,8 +174,8 @@ static void v4l2_unpack_tuple(int *a, int *b, int packed)
 /**
  * Start the video capture on the device.
  *
- * This enqueues the memory mapped buffers and instructs the device to start
- * the video stream.
+ * This enqueues the memory mapped or user pointer buffers and instructs the
+ * device to start the video stream.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
@@ -203,9 +205,27 @@ int_fast32_t v4l2_stop_capture(int_fast32_t dev);
  */
 int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf);
 
+/**
+ * Request user pointer buffers
+ *
+ * This tries to request at least 2, preferably 4, buffers that are backed by
+ * application memory. The caller has to fill in the start address and length
+ * for every buffer before the capture is started.
+ *
+ * @param dev handle for the v4l2 device
+ * @param buf buffer data
+ *
+ * @return negative on failure
+ */
+int_fast32_t v4l2_create_userptr(int_fast32_t dev,
+		struct v4l2_buffer_data *buf);
+
 /**
  * Destroy the memory mapping for buffers
  *
+ * For user pointer buffers only the buffer info is freed, the memory itself
+ * is owned by the caller.
+ *
  * @param buf buffer data
  *
  * @return negative on failure
@@ -238,18 +258,20 @@ int_fast32_t v4l2_get_input_caps(int_fast32_t dev, int input, uint32_t *caps);
 /**
  * Set the video format on the device.
  *
- * If the action succeeds resolution, pixelformat and bytesperline are set
- * to the used values.
+ * If the action succeeds resolution, pixelformat, bytesperline and
+ * sizeimage are set to the used values.
  *
  * @param dev handle for the v4l2 device
  * @param resolution packed value of the resolution or -1 to leave as is
  * @param pixelformat index of the pixelformat or -1 to leave as is
  * @param bytesperline this will be set accordingly on success
+ * @param sizeimage if not NULL this will be set to the buffer size the
+ *                  driver requires for a frame
  *
  * @return negative on failure
  */
 int_fast32_t v4l2_set_format(int_fast32_t dev, int *resolution,
-		int *pixelformat, int *bytesperline);
+		int *pixelformat, int *bytesperline, uint32_t *sizeimage);
 
 /**
  * Set the framerate on the device.
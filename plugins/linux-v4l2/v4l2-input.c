@@ -33,6 +33,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/bmem.h>
 #include <util/dstr.h>
 #include <util/platform.h>
+#include <media-io/video-frame.h>
 #include <obs-module.h>
 
 #include "v4l2-helpers.h"
@@ -41,6 +42,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "v4l2-udev.h"
 #endif
 
+#if HAVE_DECODER
+#include "v4l2-decoder.h"
+#endif
+
 /* The new dv timing api was introduced in Linux 3.4
  * Currently we simply disable dv timings when this is not defined */
 #if !defined(VIDIOC_ENUM_DV_TIMINGS) || !defined(V4L2_IN_CAP_DV_TIMINGS)
@@ -75,6 +80,7 @@ struct v4l2_data {
 	int dv_timing;
 	int resolution;
 	int framerate;
+	bool userptr;
 
 	/* internal data */
 	obs_source_t *source;
@@ -85,9 +91,30 @@ struct v4l2_data {
 	int width;
 	int height;
 	int linesize;
+	uint32_t sizeimage;
 	struct v4l2_buffer_data buffers;
+	struct obs_source_frame **frames;
+
+#if HAVE_DECODER
+	struct v4l2_decoder decoder;
+#endif
 };
 
+/**
+ * Check if a v4l2 pixel format can be captured, either directly or by
+ * decoding it
+ */
+static inline bool v4l2_format_supported(uint_fast32_t format)
+{
+	if (v4l2_to_obs_video_format(format) != VIDEO_FORMAT_NONE)
+		return true;
+#if HAVE_DECODER
+	if (v4l2_is_compressed_format(format))
+		return true;
+#endif
+	return false;
+}
+
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
@@ -142,6 +169,177 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+/**
+ * Check if a frame from the async frame pool has the exact memory layout
+ * the device writes its frames in
+ */
+static bool v4l2_frame_layout_matches(const struct obs_source_frame *frame,
+		const struct obs_source_frame *ref, const size_t *plane_offsets)
+{
+	for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i) {
+		if (!ref->linesize[i])
+			break;
+		if (frame->linesize[i] != ref->linesize[i])
+			return false;
+		if ((size_t)(frame->data[i] - frame->data[0]) !=
+				plane_offsets[i])
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Give the frames backing the user pointer buffers back to the frame pool
+ *
+ * This must only be called when the buffers are no longer queued on the
+ * device.
+ */
+static void v4l2_release_frames(struct v4l2_data *data)
+{
+	if (!data->frames)
+		return;
+
+	for (uint_fast32_t i = 0; i < data->buffers.count; ++i)
+		obs_source_release_frame(data->source, data->frames[i]);
+
+	bfree(data->frames);
+	data->frames = NULL;
+}
+
+/**
+ * Set up user pointer buffers backed by frames from the async frame pool
+ *
+ * The device then captures directly into memory that is handed to obs
+ * without being copied again. This is only possible if the layout of the
+ * pooled frames is exactly the one the device uses, which is usually the
+ * case for packed formats, and if the pooled frames are at least as large as
+ * the buffer size the driver asks for.
+ */
+static bool v4l2_init_userptr(struct v4l2_data *data)
+{
+	struct obs_source_frame ref;
+	struct obs_source_frame *frame;
+	size_t plane_offsets[MAX_AV_PLANES];
+	bool match;
+
+	v4l2_prep_obs_frame(data, &ref, plane_offsets);
+	if (ref.format == VIDEO_FORMAT_NONE)
+		return false;
+
+	frame = obs_source_get_free_frame(data->source, ref.format,
+			ref.width, ref.height);
+	if (!frame)
+		return false;
+
+	match = v4l2_frame_layout_matches(frame, &ref, plane_offsets);
+	obs_source_release_frame(data->source, frame);
+
+	if (!match) {
+		blog(LOG_INFO, "Frame layout does not match the device, "
+				"not using user pointer buffers");
+		return false;
+	}
+
+	if (video_frame_get_size(ref.format, ref.width, ref.height) <
+			data->sizeimage) {
+		blog(LOG_INFO, "Device needs %"PRIu32" byte buffers, larger "
+				"than pooled frames, not using user pointer "
+				"buffers", data->sizeimage);
+		return false;
+	}
+
+	if (v4l2_create_userptr(data->dev, &data->buffers) < 0)
+		return false;
+
+	data->frames = bzalloc(data->buffers.count *
+			sizeof(struct obs_source_frame *));
+
+	for (uint_fast32_t i = 0; i < data->buffers.count; ++i) {
+		frame = obs_source_get_free_frame(data->source, ref.format,
+				ref.width, ref.height);
+		if (!frame)
+			goto fail;
+
+		data->frames[i] = frame;
+		data->buffers.info[i].start  = frame->data[0];
+		data->buffers.info[i].length = data->sizeimage;
+	}
+
+	return true;
+fail:
+	v4l2_release_frames(data);
+	v4l2_destroy_mmap(&data->buffers);
+	return false;
+}
+
+/**
+ * Replace the user pointer buffers with mapped buffers
+ *
+ * Used when the device refuses the user pointer buffers once they are
+ * queued.
+ */
+static bool v4l2_fallback_to_mmap(struct v4l2_data *data)
+{
+	struct v4l2_requestbuffers req;
+
+	blog(LOG_INFO, "Unable to queue user pointer buffers, falling back "
+			"to mapped buffers");
+
+	/* dequeues any buffers that were queued before the failure */
+	v4l2_stop_capture(data->dev);
+	v4l2_release_frames(data);
+	v4l2_destroy_mmap(&data->buffers);
+
+	memset(&req, 0, sizeof(req));
+	req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	req.memory = V4L2_MEMORY_USERPTR;
+	v4l2_ioctl(data->dev, VIDIOC_REQBUFS, &req);
+
+	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+		blog(LOG_ERROR, "Failed to map buffers");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Output the frame a user pointer buffer was captured into
+ *
+ * The buffer is given a fresh frame from the pool before it is queued again.
+ * If no free frame is available the captured frame is dropped instead and
+ * the buffer is queued again with the same memory.
+ */
+static bool v4l2_output_userptr(struct v4l2_data *data,
+		struct v4l2_buffer *buf, const struct obs_source_frame *out)
+{
+	struct obs_source_frame *frame = data->frames[buf->index];
+	struct obs_source_frame *next;
+
+	next = obs_source_get_free_frame(data->source, out->format,
+			out->width, out->height);
+	if (!next)
+		return false;
+
+	frame->timestamp  = out->timestamp;
+	frame->full_range = out->full_range;
+	memcpy(frame->color_matrix, out->color_matrix,
+			sizeof(frame->color_matrix));
+	memcpy(frame->color_range_min, out->color_range_min,
+			sizeof(frame->color_range_min));
+	memcpy(frame->color_range_max, out->color_range_max,
+			sizeof(frame->color_range_max));
+	obs_source_output_free_frame(data->source, frame);
+
+	data->frames[buf->index] = next;
+	data->buffers.info[buf->index].start = next->data[0];
+
+	buf->m.userptr = (unsigned long) next->data[0];
+	buf->length    = data->buffers.info[buf->index].length;
+	return true;
+}
+
 /*
  * Worker thread to get video data
  */
@@ -153,13 +351,18 @@ static void *v4l2_thread(void *vptr)
 	uint8_t *start;
 	uint64_t frames;
 	uint64_t first_ts;
+	uint64_t decode_skipped = 0;
+	uint64_t userptr_dropped = 0;
 	struct timeval tv;
 	struct v4l2_buffer buf;
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
-		goto exit;
+	if (v4l2_start_capture(data->dev, &data->buffers) < 0) {
+		if (!data->frames || !v4l2_fallback_to_mmap(data) ||
+		    v4l2_start_capture(data->dev, &data->buffers) < 0)
+			goto exit;
+	}
 
 	frames   = 0;
 	first_ts = 0;
@@ -183,7 +386,7 @@ static void *v4l2_thread(void *vptr)
 		}
 
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		buf.memory = V4L2_MEMORY_MMAP;
+		buf.memory = data->buffers.memory;
 
 		if (v4l2_ioctl(data->dev, VIDIOC_DQBUF, &buf) < 0) {
 			if (errno == EAGAIN)
@@ -198,9 +401,28 @@ static void *v4l2_thread(void *vptr)
 		out.timestamp -= first_ts;
 
 		start = (uint8_t *) data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+
+#if HAVE_DECODER
+		if (data->decoder.context) {
+			/* the decoder copies the data, so the buffer can be
+			 * queued again right away */
+			if (v4l2_decode_frame(&data->decoder, start,
+					buf.bytesused, out.timestamp, &out) > 0)
+				obs_source_output_video(data->source, &out);
+			else
+				decode_skipped++;
+		} else
+#endif
+		if (data->frames) {
+			/* the frame is handed to obs as is, the buffer gets
+			 * new memory from the pool */
+			if (!v4l2_output_userptr(data, &buf, &out))
+				userptr_dropped++;
+		} else {
+			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+				out.data[i] = start + plane_offsets[i];
+			obs_source_output_video(data->source, &out);
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
@@ -211,6 +433,12 @@ static void *v4l2_thread(void *vptr)
 	}
 
 	blog(LOG_INFO, "Stopped capture after %"PRIu64" frames", frames);
+	if (decode_skipped)
+		blog(LOG_INFO, "%"PRIu64" frames were not output by the "
+				"decoder", decode_skipped);
+	if (userptr_dropped)
+		blog(LOG_INFO, "%"PRIu64" frames were dropped because no "
+				"free frame was available", userptr_dropped);
 
 exit:
 	v4l2_stop_capture(data->dev);
@@ -232,6 +460,7 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "resolution", -1);
 	obs_data_set_default_int(settings, "framerate", -1);
 	obs_data_set_default_bool(settings, "buffering", true);
+	obs_data_set_default_bool(settings, "userptr", false);
 }
 
 /**
@@ -388,8 +617,7 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
 			dstr_cat(&buffer, " (Emulated)");
 
-		if (v4l2_to_obs_video_format(fmt.pixelformat)
-				!= VIDEO_FORMAT_NONE) {
+		if (v4l2_format_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 					fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -761,6 +989,8 @@ static obs_properties_t *v4l2_properties(void *vptr)
 
 	obs_properties_add_bool(props,
 			"buffering", obs_module_text("UseBuffering"));
+	obs_properties_add_bool(props,
+			"userptr", obs_module_text("UseUserptr"));
 
 	obs_data_t *settings = obs_source_get_settings(data->source);
 	v4l2_device_list(device_list, settings);
@@ -784,8 +1014,13 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+	v4l2_release_frames(data);
 	v4l2_destroy_mmap(&data->buffers);
 
+#if HAVE_DECODER
+	v4l2_destroy_decoder(&data->decoder);
+#endif
+
 	if (data->dev != -1) {
 		v4l2_close(data->dev);
 		data->dev = -1;
@@ -823,7 +1058,7 @@ static void v4l2_destroy(void *vptr)
  * - tries to open the device
  * - sets pixelformat and requested resolution
  * - sets the requested framerate
- * - maps the buffers
+ * - maps the buffers or sets up user pointer buffers
  * - starts the capture thread
  */
 static void v4l2_init(struct v4l2_data *data)
@@ -870,14 +1105,21 @@ static void v4l2_init(struct v4l2_data *data)
 
 	/* set pixel format and resolution */
 	if (v4l2_set_format(data->dev, &data->resolution, &data->pixfmt,
-			&data->linesize) < 0) {
+			&data->linesize, &data->sizeimage) < 0) {
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (!v4l2_format_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
+#if HAVE_DECODER
+	if (v4l2_is_compressed_format(data->pixfmt) &&
+	    v4l2_init_decoder(&data->decoder, data->pixfmt) < 0) {
+		blog(LOG_ERROR, "Failed to initialize decoder");
+		goto fail;
+	}
+#endif
 	v4l2_unpack_tuple(&data->width, &data->height, data->resolution);
 	blog(LOG_INFO, "Resolution: %dx%d", data->width, data->height);
 	blog(LOG_INFO, "Pixelformat: %s", V4L2_FOURCC_STR(data->pixfmt));
@@ -891,8 +1133,10 @@ static void v4l2_init(struct v4l2_data *data)
 	v4l2_unpack_tuple(&fps_num, &fps_denom, data->framerate);
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
-	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	/* set up user pointer buffers if requested, else map buffers */
+	if (data->userptr && v4l2_init_userptr(data)) {
+		blog(LOG_INFO, "Capturing into user pointer buffers");
+	} else if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
@@ -943,6 +1187,7 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->dv_timing  = obs_data_get_int(settings, "dv_timing");
 	data->resolution = obs_data_get_int(settings, "resolution");
 	data->framerate  = obs_data_get_int(settings, "framerate");
+	data->userptr    = obs_data_get_bool(settings, "userptr");
 
 	v4l2_update_source_flags(data, settings);
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Shared memory ring buffer used to send packets to ffmpeg-mux instead of
+ * stdin.  The same ffm_packet_info + data stream that would go through the
+ * pipe is written into the ring by the output (the only writer) and read
+ * back by ffmpeg-mux (the only reader).  Each side sleeps on a futex when
+ * the ring is full or empty, and only wakes the other side if it is actually
+ * waiting.
+ *
+ * The ring is created with memfd_create and the descriptor is inherited by
+ * the ffmpeg-mux process, which is passed its number on the command line.
+ * Only available on Linux; everything else uses the pipe.
+ */
+
+#ifdef __linux__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define FFM_SHM_SUPPORTED 1
+
+#define FFM_SHM_MAGIC       0x4d484646 /* "FFHM" */
+#define FFM_SHM_DATA_OFFSET 4096
+#define FFM_SHM_RING_SIZE   (16 * 1024 * 1024)
+
+struct ffm_shm_header {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t data_size;
+
+	/* total number of bytes written/read, the ring offset is the value
+	 * modulo data_size */
+	uint64_t write_pos;
+	uint64_t read_pos;
+
+	/* futex words, incremented each time the matching position moves */
+	uint32_t write_seq;
+	uint32_t read_seq;
+
+	uint32_t writer_waiting;
+	uint32_t reader_waiting;
+
+	/* set by the writer once it has written its last packet, and by the
+	 * reader when it exits */
+	uint32_t closed;
+	uint32_t reader_closed;
+
+	/* file write statistics, updated by ffmpeg-mux when it does its own
+	 * file writing */
+	uint64_t disk_bytes;
+	uint64_t disk_write_ns;
+	uint64_t disk_max_latency_ns;
+};
+
+static inline uint8_t *ffm_shm_data(struct ffm_shm_header *shm)
+{
+	return (uint8_t*)shm + FFM_SHM_DATA_OFFSET;
+}
+
+static inline void ffm_futex_wait(uint32_t *addr, uint32_t val,
+		int timeout_ms)
+{
+	struct timespec ts;
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static inline void ffm_futex_wake(uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static inline uint64_t ffm_shm_readable(struct ffm_shm_header *shm)
+{
+	return __atomic_load_n(&shm->write_pos, __ATOMIC_SEQ_CST) -
+		__atomic_load_n(&shm->read_pos, __ATOMIC_SEQ_CST);
+}
+
+static inline uint64_t ffm_shm_writable(struct ffm_shm_header *shm)
+{
+	return shm->data_size - ffm_shm_readable(shm);
+}
+
+static inline bool ffm_shm_closed(struct ffm_shm_header *shm)
+{
+	return __atomic_load_n(&shm->closed, __ATOMIC_SEQ_CST) != 0;
+}
+
+static inline void ffm_shm_advance(uint64_t *pos, uint32_t *seq,
+		uint32_t *waiting, uint64_t size)
+{
+	__atomic_add_fetch(pos, size, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+		ffm_futex_wake(seq);
+}
+
+static inline void ffm_shm_advance_write(struct ffm_shm_header *shm,
+		uint64_t size)
+{
+	ffm_shm_advance(&shm->write_pos, &shm->write_seq,
+			&shm->reader_waiting, size);
+}
+
+static inline void ffm_shm_advance_read(struct ffm_shm_header *shm,
+		uint64_t size)
+{
+	ffm_shm_advance(&shm->read_pos, &shm->read_seq,
+			&shm->writer_waiting, size);
+}
+
+static inline bool ffm_shm_reader_closed(struct ffm_shm_header *shm)
+{
+	return __atomic_load_n(&shm->reader_closed, __ATOMIC_SEQ_CST) != 0;
+}
+
+static inline void ffm_shm_close(struct ffm_shm_header *shm)
+{
+	__atomic_store_n(&shm->closed, 1, __ATOMIC_SEQ_CST);
+	ffm_shm_advance_write(shm, 0);
+}
+
+static inline void ffm_shm_close_reader(struct ffm_shm_header *shm)
+{
+	__atomic_store_n(&shm->reader_closed, 1, __ATOMIC_SEQ_CST);
+	ffm_shm_advance_read(shm, 0);
+}
+
+/* waits (once, for at most timeout_ms) for at least size bytes to become
+ * writable, and returns the number of writable bytes */
+static inline uint64_t ffm_shm_wait_writable(struct ffm_shm_header *shm,
+		uint64_t size, int timeout_ms)
+{
+	uint64_t avail = ffm_shm_writable(shm);
+	uint32_t seq;
+
+	if (avail >= size || ffm_shm_reader_closed(shm))
+		return avail;
+
+	__atomic_store_n(&shm->writer_waiting, 1, __ATOMIC_SEQ_CST);
+	seq = __atomic_load_n(&shm->read_seq, __ATOMIC_SEQ_CST);
+
+	if (ffm_shm_writable(shm) < size && !ffm_shm_reader_closed(shm))
+		ffm_futex_wait(&shm->read_seq, seq, timeout_ms);
+
+	__atomic_store_n(&shm->writer_waiting, 0, __ATOMIC_SEQ_CST);
+	return ffm_shm_writable(shm);
+}
+
+/* waits (once, for at most timeout_ms) for at least size bytes to become
+ * readable or for the ring to be closed, and returns the number of readable
+ * bytes */
+static inline uint64_t ffm_shm_wait_readable(struct ffm_shm_header *shm,
+		uint64_t size, int timeout_ms)
+{
+	uint64_t avail = ffm_shm_readable(shm);
+	uint32_t seq;
+
+	if (avail >= size || ffm_shm_closed(shm))
+		return avail;
+
+	__atomic_store_n(&shm->reader_waiting, 1, __ATOMIC_SEQ_CST);
+	seq = __atomic_load_n(&shm->write_seq, __ATOMIC_SEQ_CST);
+
+	if (ffm_shm_readable(shm) < size && !ffm_shm_closed(shm))
+		ffm_futex_wait(&shm->write_seq, seq, timeout_ms);
+
+	__atomic_store_n(&shm->reader_waiting, 0, __ATOMIC_SEQ_CST);
+	return ffm_shm_readable(shm);
+}
+
+#endif
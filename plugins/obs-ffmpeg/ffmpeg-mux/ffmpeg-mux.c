@@ -14,6 +14,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
@@ -26,6 +30,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
+
+#ifdef FFM_SHM_SUPPORTED
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#define FILE_IO_SUPPORTED 1
+#endif
 
 #include <libavformat/avformat.h>
 
@@ -75,6 +94,8 @@ struct main_params {
 	int fps_den;
 	char *acodec;
 	char *muxer_settings;
+	int shm_fd;
+	char *file_io;
 };
 
 struct audio_params {
@@ -89,6 +110,8 @@ struct header {
 	int size;
 };
 
+struct file_io;
+
 struct ffmpeg_mux {
 	AVFormatContext        *output;
 	AVStream               *video_stream;
@@ -100,6 +123,16 @@ struct ffmpeg_mux {
 	int                    num_audio_streams;
 	bool                   initialized;
 	char error[4096];
+
+#ifdef FILE_IO_SUPPORTED
+	struct file_io         *io;
+#endif
+
+#ifdef FFM_SHM_SUPPORTED
+	struct ffm_shm_header  *shm;
+	size_t                 shm_size;
+	uint64_t               shm_pending;
+#endif
 };
 
 static void header_free(struct header *header)
@@ -107,9 +140,18 @@ static void header_free(struct header *header)
 	free(header->data);
 }
 
+#ifdef FILE_IO_SUPPORTED
+static void file_io_close(struct ffmpeg_mux *ffm);
+#endif
+
 static void free_avformat(struct ffmpeg_mux *ffm)
 {
 	if (ffm->output) {
+#ifdef FILE_IO_SUPPORTED
+		if (ffm->io)
+			file_io_close(ffm);
+		else
+#endif
 		if ((ffm->output->oformat->flags & AVFMT_NOFILE) == 0)
 			avio_close(ffm->output->pb);
 
@@ -148,6 +190,13 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 		free(ffm->audio);
 	}
 
+#ifdef FFM_SHM_SUPPORTED
+	if (ffm->shm) {
+		ffm_shm_close_reader(ffm->shm);
+		munmap(ffm->shm, ffm->shm_size);
+	}
+#endif
+
 	memset(ffm, 0, sizeof(*ffm));
 }
 
@@ -252,6 +301,21 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	params->shm_fd = -1;
+
+	/* optional trailing "name=value" options */
+	while (*argc) {
+		char *opt;
+		get_opt_str(argc, argv, &opt, "option");
+
+		if (strncmp(opt, "shm=", 4) == 0)
+			params->shm_fd = atoi(opt + 4);
+		else if (strncmp(opt, "io=", 3) == 0)
+			params->file_io = opt + 3;
+		else
+			printf("Unknown option: '%s'\n", opt);
+	}
+
 	return true;
 }
 
@@ -389,11 +453,122 @@ static void ffmpeg_mux_header(struct ffmpeg_mux *ffm, uint8_t *data,
 	}
 }
 
-static size_t safe_read(void *vdata, size_t size)
+#ifdef FFM_SHM_SUPPORTED
+#define SHM_WAIT_MS 100
+
+static bool open_shm(struct ffmpeg_mux *ffm)
+{
+	struct ffm_shm_header *shm;
+	struct stat st;
+	int fd = ffm->params.shm_fd;
+
+	if (fstat(fd, &st) != 0 ||
+	    (size_t)st.st_size <= FFM_SHM_DATA_OFFSET) {
+		puts("Invalid shared memory descriptor");
+		close(fd);
+		return false;
+	}
+
+	shm = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (shm == MAP_FAILED) {
+		puts("Failed to map shared memory");
+		return false;
+	}
+
+	if (shm->magic != FFM_SHM_MAGIC ||
+	    shm->data_size > (size_t)st.st_size - FFM_SHM_DATA_OFFSET) {
+		puts("Invalid shared memory header");
+		munmap(shm, (size_t)st.st_size);
+		return false;
+	}
+
+	ffm->shm = shm;
+	ffm->shm_size = (size_t)st.st_size;
+	return true;
+}
+
+/* nothing is written to stdin while using shared memory, so any event on it
+ * means the output has closed it or gone away */
+static bool stdin_closed(void)
+{
+	struct pollfd pfd = {.fd = 0, .events = POLLIN};
+	return poll(&pfd, 1, 0) != 0;
+}
+
+/* waits until size bytes are readable.  if the output stops writing first,
+ * returns false */
+static bool shm_wait(struct ffmpeg_mux *ffm, uint64_t size)
+{
+	struct ffm_shm_header *shm = ffm->shm;
+
+	while (ffm_shm_wait_readable(shm, size, SHM_WAIT_MS) < size) {
+		if (ffm_shm_closed(shm) || stdin_closed())
+			return ffm_shm_readable(shm) >= size;
+	}
+
+	return true;
+}
+
+static size_t shm_read(struct ffmpeg_mux *ffm, uint8_t *data, size_t size)
+{
+	struct ffm_shm_header *shm = ffm->shm;
+	uint8_t *ring = ffm_shm_data(shm);
+	size_t total = size;
+
+	while (size > 0) {
+		uint64_t pos;
+		size_t chunk;
+
+		if (!shm_wait(ffm, 1))
+			return 0;
+
+		pos = shm->read_pos % shm->data_size;
+		chunk = (size_t)ffm_shm_readable(shm);
+		if (chunk > size)
+			chunk = size;
+		if (chunk > shm->data_size - pos)
+			chunk = (size_t)(shm->data_size - pos);
+
+		memcpy(data, ring + pos, chunk);
+		ffm_shm_advance_read(shm, chunk);
+
+		size -= chunk;
+		data += chunk;
+	}
+
+	return total;
+}
+
+/* returns the packet data in place if it is stored contiguously in the ring.
+ * it is released once the packet has been muxed */
+static uint8_t *shm_peek(struct ffmpeg_mux *ffm, size_t size)
+{
+	struct ffm_shm_header *shm = ffm->shm;
+	uint64_t pos = shm->read_pos % shm->data_size;
+
+	if (pos + size > shm->data_size || !shm_wait(ffm, size))
+		return NULL;
+
+	ffm->shm_pending = size;
+	return ffm_shm_data(shm) + pos;
+}
+#endif
+
+static size_t safe_read(struct ffmpeg_mux *ffm, void *vdata, size_t size)
 {
 	uint8_t *data = vdata;
 	size_t  total = size;
 
+#ifdef FFM_SHM_SUPPORTED
+	if (ffm->shm)
+		return shm_read(ffm, data, size);
+#else
+	(void)ffm;
+#endif
+
 	while (size > 0) {
 		size_t in_size = fread(data, 1, size, stdin);
 		if (in_size == 0)
@@ -406,15 +581,42 @@ static size_t safe_read(void *vdata, size_t size)
 	return total;
 }
 
+static uint8_t *read_packet_data(struct ffmpeg_mux *ffm,
+		struct resize_buf *rb, size_t size)
+{
+#ifdef FFM_SHM_SUPPORTED
+	if (ffm->shm) {
+		uint8_t *data = shm_peek(ffm, size);
+		if (data)
+			return data;
+	}
+#endif
+
+	resize_buf_resize(rb, size);
+	return safe_read(ffm, rb->buf, size) == size ? rb->buf : NULL;
+}
+
+static inline void release_packet_data(struct ffmpeg_mux *ffm)
+{
+#ifdef FFM_SHM_SUPPORTED
+	if (ffm->shm_pending) {
+		ffm_shm_advance_read(ffm->shm, ffm->shm_pending);
+		ffm->shm_pending = 0;
+	}
+#else
+	(void)ffm;
+#endif
+}
+
 static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
 {
 	struct ffm_packet_info info = {0};
 
-	bool success = safe_read(&info, sizeof(info)) == sizeof(info);
+	bool success = safe_read(ffm, &info, sizeof(info)) == sizeof(info);
 	if (success) {
 		uint8_t *data = malloc(info.size);
 
-		if (safe_read(data, info.size) == info.size) {
+		if (safe_read(ffm, data, info.size) == info.size) {
 			ffmpeg_mux_header(ffm, data, &info);
 		} else {
 			success = false;
@@ -447,12 +649,390 @@ static inline bool ffmpeg_mux_get_extra_data(struct ffmpeg_mux *ffm)
 #pragma warning(disable : 4996)
 #endif
 
+#ifdef FILE_IO_SUPPORTED
+/*
+ * Optional file writing that bypasses avio_open, used for high bitrate
+ * recordings where the default small buffered writes thrash the page cache:
+ *
+ *  - data is collected into large aligned blocks before being written
+ *  - the file is preallocated in large chunks as it grows
+ *  - "direct" writes the full blocks with O_DIRECT
+ *  - "nocache" writes normally but drops written data from the page cache
+ *
+ * Writes that land behind the current block (the muxer going back to fill
+ * in sizes, etc) go through a normal descriptor, and writes that land inside
+ * the block are patched into it.
+ *
+ * Some muxer options make the muxer open the file again to read it back
+ * (mov/mp4 "faststart"), so the pending block is written out whenever the
+ * muxer opens another file.  Without the io_open callback that can't be
+ * detected, so these modes are not used with such options.
+ */
+
+#define FILE_IO_HAS_IO_OPEN \
+	(LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 25, 100))
+
+#define FILE_IO_BLOCK_SIZE   (4 * 1024 * 1024)
+#define FILE_IO_ALIGNMENT    4096
+#define FILE_IO_PREALLOC     (64 * 1024 * 1024)
+#define FILE_IO_AVIO_SIZE    (256 * 1024)
+
+struct file_io {
+	int      fd;
+	int      direct_fd;
+	bool     nocache;
+
+	uint8_t  *block;
+	int64_t  block_start;
+	size_t   block_used;
+
+	int64_t  pos;
+	int64_t  size;
+	int64_t  allocated;
+	int64_t  dropped;
+
+#if FILE_IO_HAS_IO_OPEN
+	int (*io_open)(struct AVFormatContext *s, AVIOContext **pb,
+			const char *url, int flags, AVDictionary **options);
+#endif
+
+	struct ffm_shm_header *stats;
+	uint64_t bytes;
+	uint64_t write_ns;
+	uint64_t max_latency_ns;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void file_io_update_stats(struct file_io *io, size_t size,
+		uint64_t latency)
+{
+	io->bytes += size;
+	io->write_ns += latency;
+	if (latency > io->max_latency_ns)
+		io->max_latency_ns = latency;
+
+#ifdef FFM_SHM_SUPPORTED
+	if (io->stats) {
+		__atomic_store_n(&io->stats->disk_bytes, io->bytes,
+				__ATOMIC_RELAXED);
+		__atomic_store_n(&io->stats->disk_write_ns, io->write_ns,
+				__ATOMIC_RELAXED);
+		__atomic_store_n(&io->stats->disk_max_latency_ns,
+				io->max_latency_ns, __ATOMIC_RELAXED);
+	}
+#endif
+}
+
+static bool file_io_pwrite(struct file_io *io, int fd, const uint8_t *data,
+		size_t size, int64_t offset)
+{
+	uint64_t start_time = get_time_ns();
+	size_t total = size;
+
+	while (size > 0) {
+		ssize_t ret = pwrite(fd, data, size, (off_t)offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			printf("Failed to write to file: %s\n", strerror(errno));
+			return false;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+		offset += ret;
+	}
+
+	file_io_update_stats(io, total, get_time_ns() - start_time);
+	return true;
+}
+
+static void file_io_preallocate(struct file_io *io, int64_t end)
+{
+	if (end <= io->allocated)
+		return;
+
+	/* keep the file size as-is so readers still see the real size */
+	if (fallocate(io->fd, FALLOC_FL_KEEP_SIZE, io->allocated,
+				FILE_IO_PREALLOC) == 0) {
+		io->allocated += FILE_IO_PREALLOC;
+	} else {
+		/* not supported by the file system, don't try again */
+		io->allocated = INT64_MAX;
+	}
+}
+
+/* waits for everything before offset to be written back, then removes it
+ * from the page cache */
+static void file_io_drop_cache(struct file_io *io, int64_t offset)
+{
+	if (offset <= io->dropped)
+		return;
+
+	sync_file_range(io->fd, io->dropped, offset - io->dropped,
+			SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+			SYNC_FILE_RANGE_WAIT_AFTER);
+	posix_fadvise(io->fd, io->dropped, offset - io->dropped,
+			POSIX_FADV_DONTNEED);
+	io->dropped = offset;
+}
+
+static bool file_io_flush_block(struct file_io *io)
+{
+	int64_t start = io->block_start;
+	size_t size = io->block_used;
+	bool direct;
+	int fd;
+
+	if (!size)
+		return true;
+
+	direct = io->direct_fd != -1 && size == FILE_IO_BLOCK_SIZE &&
+		(start % FILE_IO_ALIGNMENT) == 0;
+	fd = direct ? io->direct_fd : io->fd;
+
+	while (io->allocated < start + (int64_t)size)
+		file_io_preallocate(io, start + (int64_t)size);
+
+	if (!file_io_pwrite(io, fd, io->block, size, start))
+		return false;
+
+	if (io->nocache) {
+		/* start writeback of this block, and drop the previous one
+		 * which should be done writing by now */
+		sync_file_range(io->fd, start, (off_t)size,
+				SYNC_FILE_RANGE_WRITE);
+		file_io_drop_cache(io, start);
+	}
+
+	io->block_start += (int64_t)size;
+	io->block_used = 0;
+	return true;
+}
+
+static int file_io_write(void *opaque, uint8_t *data, int data_size)
+{
+	struct file_io *io = opaque;
+	size_t size = (size_t)data_size;
+
+	while (size > 0) {
+		int64_t block_end = io->block_start + (int64_t)io->block_used;
+		size_t n;
+
+		if (io->pos < io->block_start) {
+			n = (size_t)(io->block_start - io->pos);
+			if (n > size)
+				n = size;
+
+			if (!file_io_pwrite(io, io->fd, data, n, io->pos))
+				return AVERROR(EIO);
+
+		} else if (io->pos <= block_end) {
+			size_t offset = (size_t)(io->pos - io->block_start);
+
+			n = FILE_IO_BLOCK_SIZE - offset;
+			if (n > size)
+				n = size;
+
+			memcpy(io->block + offset, data, n);
+			if (offset + n > io->block_used)
+				io->block_used = offset + n;
+
+			if (io->block_used == FILE_IO_BLOCK_SIZE &&
+			    !file_io_flush_block(io))
+				return AVERROR(EIO);
+
+		} else {
+			/* skipped past the end of the block, so start a new
+			 * one from here */
+			if (!file_io_flush_block(io))
+				return AVERROR(EIO);
+
+			io->block_start = io->pos;
+			continue;
+		}
+
+		io->pos += (int64_t)n;
+		data += n;
+		size -= n;
+
+		if (io->pos > io->size)
+			io->size = io->pos;
+	}
+
+	return data_size;
+}
+
+static int64_t file_io_seek(void *opaque, int64_t offset, int whence)
+{
+	struct file_io *io = opaque;
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case SEEK_SET:    io->pos = offset; break;
+	case SEEK_CUR:    io->pos += offset; break;
+	case SEEK_END:    io->pos = io->size + offset; break;
+	case AVSEEK_SIZE: return io->size;
+	default:          return -1;
+	}
+
+	return io->pos;
+}
+
+#if FILE_IO_HAS_IO_OPEN
+/* the muxer is about to open a file, possibly to read back what was
+ * written so far, so write out the pending block first */
+static int file_io_open_nested(struct AVFormatContext *s, AVIOContext **pb,
+		const char *url, int flags, AVDictionary **options)
+{
+	struct ffmpeg_mux *ffm = s->opaque;
+	struct file_io *io = ffm->io;
+
+	avio_flush(s->pb);
+	if (!file_io_flush_block(io))
+		return AVERROR(EIO);
+
+	return io->io_open(s, pb, url, flags, options);
+}
+#endif
+
+static bool file_io_open(struct ffmpeg_mux *ffm)
+{
+	const char *mode = ffm->params.file_io;
+	struct file_io *io;
+	uint8_t *avio_buf;
+	void *block;
+
+	if (strcmp(mode, "direct") != 0 && strcmp(mode, "nocache") != 0) {
+		printf("Unknown file writing mode '%s'\n", mode);
+		return false;
+	}
+
+#if !FILE_IO_HAS_IO_OPEN
+	if (ffm->params.muxer_settings &&
+	    strstr(ffm->params.muxer_settings, "faststart")) {
+		printf("File writing mode '%s' can't be used with "
+				"faststart, using normal writes\n", mode);
+		return false;
+	}
+#endif
+
+	if (posix_memalign(&block, FILE_IO_ALIGNMENT, FILE_IO_BLOCK_SIZE) != 0)
+		return false;
+
+	io = calloc(1, sizeof(*io));
+	if (!io) {
+		free(block);
+		return false;
+	}
+
+	io->block = block;
+	io->direct_fd = -1;
+	io->nocache = strcmp(mode, "nocache") == 0;
+#ifdef FFM_SHM_SUPPORTED
+	io->stats = ffm->shm;
+#endif
+
+	io->fd = open(ffm->params.file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			0644);
+	if (io->fd == -1) {
+		printf("Couldn't open '%s', %s\n", ffm->params.file,
+				strerror(errno));
+		goto fail;
+	}
+
+	if (!io->nocache) {
+		io->direct_fd = open(ffm->params.file,
+				O_WRONLY | O_DIRECT | O_CLOEXEC);
+		if (io->direct_fd == -1)
+			printf("O_DIRECT not supported for '%s', using "
+					"normal writes\n", ffm->params.file);
+	}
+
+	avio_buf = av_malloc(FILE_IO_AVIO_SIZE);
+	ffm->output->pb = avio_alloc_context(avio_buf, FILE_IO_AVIO_SIZE, 1,
+			io, NULL, file_io_write, file_io_seek);
+	if (!ffm->output->pb) {
+		av_free(avio_buf);
+		goto fail;
+	}
+
+#if FILE_IO_HAS_IO_OPEN
+	io->io_open = ffm->output->io_open;
+	ffm->output->io_open = file_io_open_nested;
+	ffm->output->opaque = ffm;
+#endif
+
+	ffm->io = io;
+	return true;
+
+fail:
+	if (io->fd != -1)
+		close(io->fd);
+	if (io->direct_fd != -1)
+		close(io->direct_fd);
+	free(io->block);
+	free(io);
+	return false;
+}
+
+static void file_io_close(struct ffmpeg_mux *ffm)
+{
+	struct file_io *io = ffm->io;
+	AVIOContext *pb = ffm->output->pb;
+
+	avio_flush(pb);
+	file_io_flush_block(io);
+
+	/* remove anything preallocated past the end */
+	if (ftruncate(io->fd, io->size) != 0)
+		printf("Failed to truncate file: %s\n", strerror(errno));
+
+	if (io->nocache) {
+		fdatasync(io->fd);
+		file_io_drop_cache(io, io->size);
+	}
+
+	if (io->write_ns)
+		printf("Wrote %lld MB at %lld MB/s, max write latency %lld "
+				"ms\n",
+				(long long)(io->bytes / 1000000),
+				(long long)(io->bytes * 1000 / io->write_ns),
+				(long long)(io->max_latency_ns / 1000000));
+
+#if FILE_IO_HAS_IO_OPEN
+	ffm->output->io_open = io->io_open;
+#endif
+
+	if (io->direct_fd != -1)
+		close(io->direct_fd);
+	close(io->fd);
+	free(io->block);
+	free(io);
+
+	av_freep(&pb->buffer);
+	av_freep(&ffm->output->pb);
+	ffm->io = NULL;
+}
+#endif
+
 static inline int open_output_file(struct ffmpeg_mux *ffm)
 {
 	AVOutputFormat *format = ffm->output->oformat;
 	int ret;
 
 	if ((format->flags & AVFMT_NOFILE) == 0) {
+#ifdef FILE_IO_SUPPORTED
+		if (ffm->params.file_io && file_io_open(ffm)) {
+			ret = 0;
+		} else
+#endif
 		ret = avio_open(&ffm->output->pb, ffm->params.file,
 				AVIO_FLAG_WRITE);
 		if (ret < 0) {
@@ -551,6 +1131,11 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 			calloc(1, sizeof(struct header) * ffm->params.tracks);
 	}
 
+#ifdef FFM_SHM_SUPPORTED
+	if (ffm->params.shm_fd >= 0 && !open_shm(ffm))
+		return FFM_ERROR;
+#endif
+
 	av_register_all();
 
 	if (!ffmpeg_mux_get_extra_data(ffm))
@@ -668,11 +1253,12 @@ int main(int argc, char *argv[])
 		return ret;
 	}
 
-	while (!fail && safe_read(&info, sizeof(info)) == sizeof(info)) {
-		resize_buf_resize(&rb, info.size);
+	while (!fail && safe_read(&ffm, &info, sizeof(info)) == sizeof(info)) {
+		uint8_t *data = read_packet_data(&ffm, &rb, info.size);
 
-		if (safe_read(rb.buf, info.size) == info.size) {
-			ffmpeg_mux_packet(&ffm, rb.buf, &info);
+		if (data) {
+			ffmpeg_mux_packet(&ffm, data, &info);
+			release_packet_data(&ffm);
 		} else {
 			fail = true;
 		}
@@ -17,12 +17,20 @@
 
 #include <obs-module.h>
 #include <obs-avc.h>
+#include <util/circlebuf.h>
 #include <util/dstr.h>
+#include <util/platform.h>
 #include <util/pipe.h>
 #include <util/threading.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "ffmpeg-mux/ffmpeg-mux-shm.h"
+
+#ifdef FFM_SHM_SUPPORTED
+#include <sys/mman.h>
+#endif
 
 #include <libavformat/avformat.h>
+#include <time.h>
 
 #define do_log(level, format, ...) \
 	blog(level, "[ffmpeg muxer: '%s'] " format, \
@@ -31,6 +39,8 @@
 #define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 
+#define DEFAULT_MAX_QUEUE_MB 256
+
 struct ffmpeg_muxer {
 	obs_output_t      *output;
 	os_process_pipe_t *pipe;
@@ -40,6 +50,49 @@ struct ffmpeg_muxer {
 	volatile bool     active;
 	volatile bool     stopping;
 	volatile bool     capturing;
+
+#ifdef FFM_SHM_SUPPORTED
+	struct ffm_shm_header *shm;
+	size_t            shm_size;
+	int               shm_fd;
+#endif
+	float             congestion;
+
+	/* packets are written to the muxer from their own thread so that a
+	 * slow disk does not block the encoders */
+	pthread_t         write_thread;
+	bool              write_thread_active;
+	os_sem_t          *write_sem;
+	volatile bool     queue_full;
+
+	/* protected by write_mutex */
+	pthread_mutex_t   write_mutex;
+	struct circlebuf  packets;
+	size_t            queued_bytes;
+	size_t            max_queued_bytes;
+	size_t            peak_queued_bytes;
+	uint64_t          write_latency_ns;
+	uint64_t          max_write_latency_ns;
+
+	/* file write statistics reported back by ffmpeg-mux */
+	uint64_t          disk_bytes;
+	uint64_t          disk_write_ns;
+	uint64_t          disk_max_latency_ns;
+
+	/* replay buffer, the packets are protected by replay_mutex */
+	pthread_mutex_t   replay_mutex;
+	struct circlebuf  replay_packets;
+	int64_t           replay_size;
+	int64_t           max_replay_size;
+	int64_t           max_replay_time;
+	int               keyframes;
+	bool              has_video;
+	int64_t           save_ts; /* protected by write_mutex */
+	struct dstr       save_path;
+	DARRAY(struct encoder_packet) mux_packets;
+	pthread_t         mux_thread;
+	bool              mux_thread_joinable;
+	volatile bool     muxing;
 };
 
 static const char *ffmpeg_mux_getname(void *unused)
@@ -48,21 +101,211 @@ static const char *ffmpeg_mux_getname(void *unused)
 	return obs_module_text("FFmpegMuxer");
 }
 
+#ifdef FFM_SHM_SUPPORTED
+/* the ring is full and the muxer has made no progress for this long, so it
+ * is assumed to have crashed or hung */
+#define SHM_WAIT_MS            100
+#define SHM_STALL_TIMEOUT_NS   10000000000ULL
+
+static bool create_shm(struct ffmpeg_muxer *stream)
+{
+	size_t size = FFM_SHM_DATA_OFFSET + FFM_SHM_RING_SIZE;
+	struct ffm_shm_header *shm;
+	int fd;
+
+	/* not close-on-exec, the descriptor is inherited by ffmpeg-mux */
+	fd = (int)syscall(SYS_memfd_create, "obs-ffmpeg-mux", 0);
+	if (fd == -1)
+		return false;
+
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		return false;
+	}
+
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	shm->magic = FFM_SHM_MAGIC;
+	shm->data_size = FFM_SHM_RING_SIZE;
+
+	stream->shm = shm;
+	stream->shm_size = size;
+	stream->shm_fd = fd;
+	return true;
+}
+
+static void close_shm_fd(struct ffmpeg_muxer *stream)
+{
+	if (stream->shm_fd != -1) {
+		close(stream->shm_fd);
+		stream->shm_fd = -1;
+	}
+}
+
+static void free_shm(struct ffmpeg_muxer *stream)
+{
+	close_shm_fd(stream);
+
+	if (stream->shm) {
+		munmap(stream->shm, stream->shm_size);
+		stream->shm = NULL;
+	}
+}
+
+static bool shm_write(struct ffmpeg_muxer *stream, const uint8_t *data,
+		size_t size)
+{
+	struct ffm_shm_header *shm = stream->shm;
+	uint8_t *ring = ffm_shm_data(shm);
+	uint64_t stall_start = 0;
+
+	while (size > 0) {
+		uint64_t avail = ffm_shm_wait_writable(shm, 1, SHM_WAIT_MS);
+		uint64_t pos = shm->write_pos % shm->data_size;
+		size_t chunk;
+
+		if (ffm_shm_reader_closed(shm))
+			return false;
+
+		if (!avail) {
+			uint64_t t = os_gettime_ns();
+
+			if (!stall_start) {
+				stall_start = t;
+			} else if (t - stall_start > SHM_STALL_TIMEOUT_NS) {
+				warn("Muxer stopped reading packets");
+				return false;
+			}
+			continue;
+		}
+
+		stall_start = 0;
+
+		chunk = size;
+		if (chunk > avail)
+			chunk = (size_t)avail;
+		if (chunk > shm->data_size - pos)
+			chunk = (size_t)(shm->data_size - pos);
+
+		memcpy(ring + pos, data, chunk);
+		ffm_shm_advance_write(shm, chunk);
+
+		size -= chunk;
+		data += chunk;
+	}
+
+	stream->congestion =
+		(float)ffm_shm_readable(shm) / (float)shm->data_size;
+	return true;
+}
+
+/* must be called with write_mutex held */
+static void update_disk_stats(struct ffmpeg_muxer *stream)
+{
+	struct ffm_shm_header *shm = stream->shm;
+
+	if (shm) {
+		stream->disk_bytes = __atomic_load_n(&shm->disk_bytes,
+				__ATOMIC_RELAXED);
+		stream->disk_write_ns = __atomic_load_n(&shm->disk_write_ns,
+				__ATOMIC_RELAXED);
+		stream->disk_max_latency_ns = __atomic_load_n(
+				&shm->disk_max_latency_ns, __ATOMIC_RELAXED);
+	}
+}
+#endif
+
+static size_t mux_write(struct ffmpeg_muxer *stream, const uint8_t *data,
+		size_t size)
+{
+#ifdef FFM_SHM_SUPPORTED
+	if (stream->shm)
+		return shm_write(stream, data, size) ? size : 0;
+#endif
+	return os_process_pipe_write(stream->pipe, data, size);
+}
+
+static void free_packets(struct ffmpeg_muxer *stream)
+{
+	pthread_mutex_lock(&stream->write_mutex);
+
+	while (stream->packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+		obs_free_encoder_packet(&packet);
+	}
+
+	stream->queued_bytes = 0;
+	pthread_mutex_unlock(&stream->write_mutex);
+}
+
+static void join_write_thread(struct ffmpeg_muxer *stream)
+{
+	if (stream->write_thread_active) {
+		pthread_join(stream->write_thread, NULL);
+		stream->write_thread_active = false;
+	}
+}
+
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
+
+	if (stream->write_thread_active) {
+		stream->stop_ts = 0;
+		os_atomic_set_bool(&stream->stopping, true);
+		os_sem_post(stream->write_sem);
+		join_write_thread(stream);
+	}
+
+	free_packets(stream);
 	os_process_pipe_destroy(stream->pipe);
+#ifdef FFM_SHM_SUPPORTED
+	free_shm(stream);
+#endif
 	dstr_free(&stream->path);
+	os_sem_destroy(stream->write_sem);
+	pthread_mutex_destroy(&stream->write_mutex);
+	circlebuf_free(&stream->packets);
 	bfree(stream);
 }
 
+static void ffmpeg_mux_get_queue_stats(void *data, calldata_t *cd);
+static void ffmpeg_mux_get_disk_stats(void *data, calldata_t *cd);
+
 static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
 	stream->output = output;
+	pthread_mutex_init_value(&stream->write_mutex);
+#ifdef FFM_SHM_SUPPORTED
+	stream->shm_fd = -1;
+#endif
+
+	if (pthread_mutex_init(&stream->write_mutex, NULL) != 0)
+		goto fail;
+
+	proc_handler_add(ph, "void get_queue_stats(out int queued_bytes, "
+			"out int queued_packets, out int max_queued_bytes, "
+			"out int write_latency_ms, "
+			"out int max_write_latency_ms)",
+			ffmpeg_mux_get_queue_stats, stream);
+	proc_handler_add(ph, "void get_disk_stats(out int written_mb, "
+			"out int write_mbps, out int max_write_latency_ms)",
+			ffmpeg_mux_get_disk_stats, stream);
 
 	UNUSED_PARAMETER(settings);
 	return stream;
+
+fail:
+	ffmpeg_mux_destroy(stream);
+	return NULL;
 }
 
 #ifdef _WIN32
@@ -177,6 +420,19 @@ static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
 	dstr_free(&mux);
 }
 
+static void add_file_io_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	const char *file_io = obs_data_get_string(settings, "file_io");
+
+	if (strcmp(file_io, "direct") == 0 || strcmp(file_io, "nocache") == 0) {
+		info("Using '%s' file writing", file_io);
+		dstr_catf(cmd, "io=%s ", file_io);
+	}
+
+	obs_data_release(settings);
+}
+
 static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
@@ -211,51 +467,149 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd)
 	}
 
 	add_muxer_params(cmd, stream);
+	add_file_io_params(cmd, stream);
+
+#ifdef FFM_SHM_SUPPORTED
+	if (stream->shm)
+		dstr_catf(cmd, "shm=%d ", stream->shm_fd);
+#endif
+}
+
+/* starts ffmpeg-mux for the file in stream->path */
+static bool start_pipe(struct ffmpeg_muxer *stream)
+{
+	struct dstr cmd;
+
+#ifdef FFM_SHM_SUPPORTED
+	if (!create_shm(stream))
+		warn("Failed to create shared memory, using the pipe instead");
+#endif
+
+	build_command_line(stream, &cmd);
+	stream->pipe = os_process_pipe_create(cmd.array, "w");
+	dstr_free(&cmd);
+
+#ifdef FFM_SHM_SUPPORTED
+	/* ffmpeg-mux has its own copy of the descriptor now */
+	close_shm_fd(stream);
+#endif
+
+	if (!stream->pipe) {
+		warn("Failed to create process pipe");
+#ifdef FFM_SHM_SUPPORTED
+		free_shm(stream);
+#endif
+		return false;
+	}
+
+	return true;
+}
+
+/* waits for ffmpeg-mux to finish writing the file, and returns its exit
+ * code */
+static int close_pipe(struct ffmpeg_muxer *stream)
+{
+	int ret;
+
+#ifdef FFM_SHM_SUPPORTED
+	if (stream->shm)
+		ffm_shm_close(stream->shm);
+#endif
+	ret = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+#ifdef FFM_SHM_SUPPORTED
+	/* ffmpeg-mux has exited, so these are the final values */
+	pthread_mutex_lock(&stream->write_mutex);
+	update_disk_stats(stream);
+	pthread_mutex_unlock(&stream->write_mutex);
+	free_shm(stream);
+#endif
+	return ret;
+}
+
+static void *write_thread(void *data);
+static int deactivate(struct ffmpeg_muxer *stream);
+
+static bool init_write_thread(struct ffmpeg_muxer *stream)
+{
+	join_write_thread(stream);
+	free_packets(stream);
+
+	os_sem_destroy(stream->write_sem);
+	if (os_sem_init(&stream->write_sem, 0) != 0) {
+		warn("Failed to create write semaphore");
+		return false;
+	}
+
+	os_atomic_set_bool(&stream->queue_full, false);
+	stream->peak_queued_bytes = 0;
+	stream->write_latency_ns = 0;
+	stream->max_write_latency_ns = 0;
+	stream->disk_bytes = 0;
+	stream->disk_write_ns = 0;
+	stream->disk_max_latency_ns = 0;
+	return true;
 }
 
 static bool ffmpeg_mux_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 	obs_data_t *settings;
-	struct dstr cmd;
 	const char *path;
+	int max_queue_mb;
 
 	if (!obs_output_can_begin_data_capture(stream->output, 0))
 		return false;
 	if (!obs_output_initialize_encoders(stream->output, 0))
 		return false;
+	if (!init_write_thread(stream))
+		return false;
 
 	settings = obs_output_get_settings(stream->output);
 	path = obs_data_get_string(settings, "path");
 	dstr_copy(&stream->path, path);
 	dstr_replace(&stream->path, "\"", "\"\"");
+	max_queue_mb = (int)obs_data_get_int(settings, "max_queue_mb");
 	obs_data_release(settings);
 
-	build_command_line(stream, &cmd);
-	stream->pipe = os_process_pipe_create(cmd.array, "w");
-	dstr_free(&cmd);
+	if (max_queue_mb <= 0)
+		max_queue_mb = DEFAULT_MAX_QUEUE_MB;
+	stream->max_queued_bytes = (size_t)max_queue_mb * 1024 * 1024;
 
-	if (!stream->pipe) {
-		warn("Failed to create process pipe");
+	if (!start_pipe(stream))
 		return false;
-	}
+
+	stream->congestion = 0.0f;
 
 	/* write headers and start capture */
 	os_atomic_set_bool(&stream->active, true);
 	os_atomic_set_bool(&stream->capturing, true);
+
+	if (pthread_create(&stream->write_thread, NULL, write_thread,
+				stream) != 0) {
+		warn("Failed to create write thread");
+		deactivate(stream);
+		return false;
+	}
+
+	stream->write_thread_active = true;
 	obs_output_begin_data_capture(stream->output, 0);
 
 	info("Writing file '%s'...", stream->path.array);
 	return true;
 }
 
+static inline bool queue_full(struct ffmpeg_muxer *stream)
+{
+	return os_atomic_load_bool(&stream->queue_full);
+}
+
 static int deactivate(struct ffmpeg_muxer *stream)
 {
 	int ret = -1;
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		ret = close_pipe(stream);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -278,6 +632,11 @@ static void ffmpeg_mux_stop(void *data, uint64_t ts)
 		stream->stop_ts = (int64_t)ts / 1000LL;
 		os_atomic_set_bool(&stream->stopping, true);
 		os_atomic_set_bool(&stream->capturing, false);
+
+		/* wake the write thread so it stops even if no more packets
+		 * arrive */
+		if (ts == 0 && stream->write_sem)
+			os_sem_post(stream->write_sem);
 	}
 }
 
@@ -310,18 +669,15 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 		.keyframe = packet->keyframe
 	};
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t*)&info,
-			sizeof(info));
+	ret = mux_write(stream, (const uint8_t*)&info, sizeof(info));
 	if (ret != sizeof(info)) {
-		warn("os_process_pipe_write for info structure failed");
-		signal_failure(stream);
+		warn("mux_write for info structure failed");
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
+	ret = mux_write(stream, packet->data, packet->size);
 	if (ret != packet->size) {
-		warn("os_process_pipe_write for packet data failed");
-		signal_failure(stream);
+		warn("mux_write for packet data failed");
 		return false;
 	}
 
@@ -375,28 +731,200 @@ static bool send_headers(struct ffmpeg_muxer *stream)
 	return true;
 }
 
-static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
+static bool get_next_packet(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
 {
-	struct ffmpeg_muxer *stream = data;
+	bool new_packet = false;
 
-	if (!active(stream))
-		return;
+	pthread_mutex_lock(&stream->write_mutex);
+	if (stream->packets.size) {
+		circlebuf_pop_front(&stream->packets, packet, sizeof(*packet));
+		stream->queued_bytes -= packet->size;
+		new_packet = true;
+	}
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	return new_packet;
+}
+
+static bool write_queued_packet(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	uint64_t start_time = os_gettime_ns();
+	uint64_t latency;
 
 	if (!stream->sent_headers) {
-		if (!send_headers(stream))
-			return;
+		if (!send_headers(stream)) {
+			signal_failure(stream);
+			return false;
+		}
 
 		stream->sent_headers = true;
 	}
 
-	if (stopping(stream)) {
-		if (packet->sys_dts_usec >= stream->stop_ts) {
-			deactivate(stream);
-			return;
+	if (!write_packet(stream, packet)) {
+		signal_failure(stream);
+		return false;
+	}
+
+	latency = os_gettime_ns() - start_time;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	stream->write_latency_ns = latency;
+	if (latency > stream->max_write_latency_ns)
+		stream->max_write_latency_ns = latency;
+#ifdef FFM_SHM_SUPPORTED
+	update_disk_stats(stream);
+#endif
+	pthread_mutex_unlock(&stream->write_mutex);
+	return true;
+}
+
+static void *write_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	os_set_thread_name("ffmpeg-mux: write_thread");
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		struct encoder_packet packet;
+		bool success;
+
+		if (queue_full(stream))
+			break;
+		if (stopping(stream) && stream->stop_ts == 0)
+			break;
+
+		if (!get_next_packet(stream, &packet))
+			continue;
+
+		if (stopping(stream)) {
+			if (packet.sys_dts_usec >= stream->stop_ts) {
+				obs_free_encoder_packet(&packet);
+				break;
+			}
 		}
+
+		success = write_queued_packet(stream, &packet);
+		obs_free_encoder_packet(&packet);
+
+		/* the failure has already been signaled */
+		if (!success)
+			break;
+	}
+
+	if (active(stream))
+		deactivate(stream);
+
+	info("Peak write queue size: %d KB, max write latency: %d ms",
+			(int)(stream->peak_queued_bytes / 1024),
+			(int)(stream->max_write_latency_ns / 1000000));
+
+	if (stream->disk_write_ns)
+		info("Wrote %d MB to disk at %d MB/s, max disk write "
+				"latency: %d ms",
+				(int)(stream->disk_bytes / 1000000),
+				(int)(stream->disk_bytes * 1000 /
+					stream->disk_write_ns),
+				(int)(stream->disk_max_latency_ns / 1000000));
+
+	free_packets(stream);
+	return NULL;
+}
+
+static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
+{
+	struct ffmpeg_muxer *stream = data;
+	struct encoder_packet new_packet;
+	bool added = false;
+
+	if (!active(stream) || queue_full(stream))
+		return;
+
+	obs_duplicate_encoder_packet(&new_packet, packet);
+
+	pthread_mutex_lock(&stream->write_mutex);
+
+	if (stream->queued_bytes + packet->size <= stream->max_queued_bytes) {
+		circlebuf_push_back(&stream->packets, &new_packet,
+				sizeof(new_packet));
+		stream->queued_bytes += packet->size;
+		if (stream->queued_bytes > stream->peak_queued_bytes)
+			stream->peak_queued_bytes = stream->queued_bytes;
+		added = true;
+	}
+
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	if (!added) {
+		obs_free_encoder_packet(&new_packet);
+
+		warn("Write queue exceeded %d MB, the muxer is not keeping up",
+				(int)(stream->max_queued_bytes / 1024 / 1024));
+
+		os_atomic_set_bool(&stream->queue_full, true);
+		os_atomic_set_bool(&stream->capturing, false);
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_QUEUE_FULL);
 	}
 
-	write_packet(stream, packet);
+	os_sem_post(stream->write_sem);
+}
+
+static void ffmpeg_mux_get_queue_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	calldata_set_int(cd, "queued_bytes", (long long)stream->queued_bytes);
+	calldata_set_int(cd, "queued_packets", (long long)
+			(stream->packets.size / sizeof(struct encoder_packet)));
+	calldata_set_int(cd, "max_queued_bytes",
+			(long long)stream->max_queued_bytes);
+	calldata_set_int(cd, "write_latency_ms",
+			(long long)(stream->write_latency_ns / 1000000));
+	calldata_set_int(cd, "max_write_latency_ms",
+			(long long)(stream->max_write_latency_ns / 1000000));
+	pthread_mutex_unlock(&stream->write_mutex);
+}
+
+static void ffmpeg_mux_get_disk_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_muxer *stream = data;
+	long long mbps = 0;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	if (stream->disk_write_ns)
+		mbps = (long long)(stream->disk_bytes * 1000 /
+				stream->disk_write_ns);
+
+	calldata_set_int(cd, "written_mb",
+			(long long)(stream->disk_bytes / 1000000));
+	calldata_set_int(cd, "write_mbps", mbps);
+	calldata_set_int(cd, "max_write_latency_ms",
+			(long long)(stream->disk_max_latency_ns / 1000000));
+	pthread_mutex_unlock(&stream->write_mutex);
+}
+
+static void ffmpeg_mux_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, "max_queue_mb",
+			DEFAULT_MAX_QUEUE_MB);
+	obs_data_set_default_string(defaults, "file_io", "default");
+}
+
+static float ffmpeg_mux_congestion(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	float congestion = stream->congestion;
+	float queue_usage = 0.0f;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	if (stream->max_queued_bytes)
+		queue_usage = (float)stream->queued_bytes /
+			(float)stream->max_queued_bytes;
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	return queue_usage > congestion ? queue_usage : congestion;
 }
 
 static obs_properties_t *ffmpeg_mux_properties(void *unused)
@@ -404,10 +932,23 @@ static obs_properties_t *ffmpeg_mux_properties(void *unused)
 	UNUSED_PARAMETER(unused);
 
 	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
 
 	obs_properties_add_text(props, "path",
 			obs_module_text("FilePath"),
 			OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, "max_queue_mb",
+			obs_module_text("MaxQueueSize"), 16, 8192, 16);
+
+	p = obs_properties_add_list(props, "file_io",
+			obs_module_text("FileIO"),
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, obs_module_text("FileIO.Default"),
+			"default");
+	obs_property_list_add_string(p, obs_module_text("FileIO.NoCache"),
+			"nocache");
+	obs_property_list_add_string(p, obs_module_text("FileIO.Direct"),
+			"direct");
 	return props;
 }
 
@@ -422,5 +963,427 @@ struct obs_output_info ffmpeg_muxer = {
 	.start          = ffmpeg_mux_start,
 	.stop           = ffmpeg_mux_stop,
 	.encoded_packet = ffmpeg_mux_data,
-	.get_properties = ffmpeg_mux_properties
+	.get_defaults   = ffmpeg_mux_defaults,
+	.get_properties = ffmpeg_mux_properties,
+	.get_congestion = ffmpeg_mux_congestion
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *replay_buffer_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("ReplayBuffer");
+}
+
+static void free_replay_packets(struct ffmpeg_muxer *stream)
+{
+	while (stream->replay_packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->replay_packets, &packet,
+				sizeof(packet));
+		obs_free_encoder_packet(&packet);
+	}
+
+	stream->replay_size = 0;
+	stream->keyframes = 0;
+}
+
+static void free_mux_packets(struct ffmpeg_muxer *stream)
+{
+	for (size_t i = 0; i < stream->mux_packets.num; i++)
+		obs_free_encoder_packet(&stream->mux_packets.array[i]);
+	da_free(stream->mux_packets);
+}
+
+static void join_mux_thread(struct ffmpeg_muxer *stream)
+{
+	if (stream->mux_thread_joinable) {
+		pthread_join(stream->mux_thread, NULL);
+		stream->mux_thread_joinable = false;
+	}
+}
+
+static void replay_buffer_destroy(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	join_mux_thread(stream);
+	free_replay_packets(stream);
+	circlebuf_free(&stream->replay_packets);
+	pthread_mutex_destroy(&stream->replay_mutex);
+	dstr_free(&stream->save_path);
+	ffmpeg_mux_destroy(stream);
+}
+
+static void generate_replay_path(struct ffmpeg_muxer *stream,
+		struct dstr *path)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	const char *dir = obs_data_get_string(settings, "directory");
+	const char *format = obs_data_get_string(settings, "format");
+	const char *ext = obs_data_get_string(settings, "extension");
+	time_t now = time(NULL);
+	char name[256];
+
+	if (!strftime(name, sizeof(name), format, localtime(&now)))
+		strcpy(name, "Replay");
+
+	dstr_copy(path, dir);
+	dstr_replace(path, "\\", "/");
+	if (path->len && dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+	dstr_catf(path, "%s.%s", name, ext);
+
+	obs_data_release(settings);
+}
+
+static void replay_buffer_save(void *data, calldata_t *cd)
+{
+	struct ffmpeg_muxer *stream = data;
+	const char *path = calldata_string(cd, "path");
+	bool success = false;
+
+	pthread_mutex_lock(&stream->write_mutex);
+
+	if (!active(stream)) {
+		warn("Tried to save the replay buffer while it is not active");
+
+	} else if (os_atomic_load_bool(&stream->muxing) || stream->save_ts) {
+		warn("Tried to save the replay buffer while it is already "
+		     "being saved");
+
+	} else {
+		if (path && *path)
+			dstr_copy(&stream->save_path, path);
+		else
+			generate_replay_path(stream, &stream->save_path);
+
+		/* save once everything encoded up to now has arrived */
+		stream->save_ts = (int64_t)(os_gettime_ns() / 1000);
+		success = true;
+	}
+
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	calldata_set_bool(cd, "success", success);
+	calldata_set_string(cd, "saved_path",
+			success ? stream->save_path.array : "");
+}
+
+static void signal_saved(struct ffmpeg_muxer *stream, const char *path,
+		bool success)
+{
+	signal_handler_t *sh = obs_output_get_signal_handler(stream->output);
+	struct calldata params;
+	uint8_t stack[256];
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
+	calldata_set_ptr(&params, "output", stream->output);
+	calldata_set_string(&params, "path", path);
+	calldata_set_bool(&params, "success", success);
+	signal_handler_signal(sh, "saved", &params);
+}
+
+static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct ffmpeg_muxer *stream = ffmpeg_mux_create(settings, output);
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	signal_handler_t *sh = obs_output_get_signal_handler(output);
+
+	if (!stream)
+		return NULL;
+
+	if (pthread_mutex_init(&stream->replay_mutex, NULL) != 0) {
+		ffmpeg_mux_destroy(stream);
+		return NULL;
+	}
+
+	proc_handler_add(ph, "void save(in string path, out bool success, "
+			"out string saved_path)",
+			replay_buffer_save, stream);
+	signal_handler_add(sh, "void saved(ptr output, string path, "
+			"bool success)");
+	return stream;
+}
+
+static bool replay_buffer_start(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	obs_data_t *settings;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	join_mux_thread(stream);
+	free_replay_packets(stream);
+
+	settings = obs_output_get_settings(stream->output);
+	stream->max_replay_time =
+		obs_data_get_int(settings, "max_time_sec") * 1000000LL;
+	stream->max_replay_size =
+		obs_data_get_int(settings, "max_size_mb") * (1024 * 1024);
+	obs_data_release(settings);
+
+	stream->has_video = !!obs_output_get_video_encoder(stream->output);
+
+	pthread_mutex_lock(&stream->write_mutex);
+	stream->save_ts = 0;
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	os_atomic_set_bool(&stream->active, true);
+	os_atomic_set_bool(&stream->capturing, true);
+	obs_output_begin_data_capture(stream->output, 0);
+	return true;
+}
+
+static void replay_buffer_stop(void *data, uint64_t ts)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	if (!active(stream))
+		return;
+
+	os_atomic_set_bool(&stream->active, false);
+	os_atomic_set_bool(&stream->capturing, false);
+	obs_output_end_data_capture(stream->output);
+
+	/* the encoders are stopped on another thread, so a packet can still
+	 * be coming in.  it sees that the buffer isn't active once it has
+	 * the lock, so nothing is added after this */
+	pthread_mutex_lock(&stream->replay_mutex);
+	free_replay_packets(stream);
+	circlebuf_free(&stream->replay_packets);
+	pthread_mutex_unlock(&stream->replay_mutex);
+
+	UNUSED_PARAMETER(ts);
+}
+
+static void *replay_buffer_mux_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	bool success = false;
+	int ret;
+
+	os_set_thread_name("replay-buffer: mux_thread");
+
+	dstr_copy_dstr(&stream->path, &stream->save_path);
+	dstr_replace(&stream->path, "\"", "\"\"");
+
+	if (!start_pipe(stream))
+		goto finish;
+
+	if (!send_headers(stream)) {
+		warn("Could not write headers for file '%s'",
+				stream->save_path.array);
+		goto close;
+	}
+
+	for (size_t i = 0; i < stream->mux_packets.num; i++) {
+		if (!write_packet(stream, &stream->mux_packets.array[i])) {
+			warn("Could not write packet for file '%s'",
+					stream->save_path.array);
+			goto close;
+		}
+	}
+
+	success = true;
+
+close:
+	ret = close_pipe(stream);
+	if (ret != 0)
+		success = false;
+
+finish:
+	if (success)
+		info("Wrote replay buffer to '%s'", stream->save_path.array);
+	else
+		warn("Failed to write replay buffer to '%s'",
+				stream->save_path.array);
+
+	free_mux_packets(stream);
+	signal_saved(stream, stream->save_path.array, success);
+	os_atomic_set_bool(&stream->muxing, false);
+	return NULL;
+}
+
+/* shares every buffered packet with the mux thread and starts it.  the
+ * buffer itself keeps running */
+static void start_save(struct ffmpeg_muxer *stream)
+{
+	size_t num = stream->replay_packets.size /
+		sizeof(struct encoder_packet);
+
+	join_mux_thread(stream);
+
+	da_reserve(stream->mux_packets, num);
+	for (size_t i = 0; i < num; i++) {
+		struct encoder_packet *packet = circlebuf_data(
+				&stream->replay_packets,
+				i * sizeof(struct encoder_packet));
+		struct encoder_packet *ref = da_push_back_new(
+				stream->mux_packets);
+		obs_duplicate_encoder_packet(ref, packet);
+	}
+
+	os_atomic_set_bool(&stream->muxing, true);
+
+	if (pthread_create(&stream->mux_thread, NULL,
+				replay_buffer_mux_thread, stream) != 0) {
+		warn("Failed to create replay buffer mux thread");
+		free_mux_packets(stream);
+		signal_saved(stream, stream->save_path.array, false);
+		os_atomic_set_bool(&stream->muxing, false);
+		return;
+	}
+
+	stream->mux_thread_joinable = true;
+}
+
+static inline bool is_purge_point(struct ffmpeg_muxer *stream,
+		const struct encoder_packet *packet)
+{
+	if (stream->has_video)
+		return packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+	return true;
+}
+
+static inline int64_t buffered_time(struct ffmpeg_muxer *stream)
+{
+	struct encoder_packet *first;
+	struct encoder_packet *last;
+
+	first = circlebuf_data(&stream->replay_packets, 0);
+	last = circlebuf_data(&stream->replay_packets,
+			stream->replay_packets.size - sizeof(*last));
+	return last->sys_dts_usec - first->sys_dts_usec;
+}
+
+static inline bool over_limit(struct ffmpeg_muxer *stream)
+{
+	return (stream->max_replay_size &&
+	        stream->replay_size > stream->max_replay_size) ||
+	       (stream->max_replay_time &&
+	        buffered_time(stream) > stream->max_replay_time);
+}
+
+static void pop_replay_packet(struct ffmpeg_muxer *stream)
+{
+	struct encoder_packet packet;
+
+	circlebuf_pop_front(&stream->replay_packets, &packet, sizeof(packet));
+
+	if (stream->has_video && is_purge_point(stream, &packet))
+		stream->keyframes--;
+	stream->replay_size -= (int64_t)packet.size;
+	obs_free_encoder_packet(&packet);
+}
+
+/* removes whole groups of pictures from the front while the buffer is over
+ * its limits, so it always starts on a keyframe */
+static void purge(struct ffmpeg_muxer *stream)
+{
+	while (over_limit(stream)) {
+		struct encoder_packet *front;
+
+		/* always keep the newest group of pictures or packet */
+		if (stream->has_video && stream->keyframes <= 1)
+			break;
+		if (stream->replay_packets.size <= sizeof(*front))
+			break;
+
+		do {
+			pop_replay_packet(stream);
+			front = circlebuf_data(&stream->replay_packets, 0);
+		} while (!is_purge_point(stream, front));
+	}
+}
+
+static void replay_buffer_data(void *data, struct encoder_packet *packet)
+{
+	struct ffmpeg_muxer *stream = data;
+	struct encoder_packet ref;
+	bool save = false;
+
+	if (!active(stream))
+		return;
+
+	pthread_mutex_lock(&stream->replay_mutex);
+
+	if (!active(stream))
+		goto unlock;
+
+	/* don't start the buffer in the middle of a group of pictures */
+	if (!stream->replay_packets.size && !is_purge_point(stream, packet))
+		goto unlock;
+
+	obs_duplicate_encoder_packet(&ref, packet);
+	circlebuf_push_back(&stream->replay_packets, &ref, sizeof(ref));
+	stream->replay_size += (int64_t)ref.size;
+	if (stream->has_video && is_purge_point(stream, &ref))
+		stream->keyframes++;
+
+	purge(stream);
+
+	pthread_mutex_lock(&stream->write_mutex);
+	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
+		stream->save_ts = 0;
+		save = true;
+	}
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	if (save)
+		start_save(stream);
+
+unlock:
+	pthread_mutex_unlock(&stream->replay_mutex);
+}
+
+static void replay_buffer_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, "max_time_sec", 15);
+	obs_data_set_default_int(defaults, "max_size_mb", 512);
+	obs_data_set_default_string(defaults, "format",
+			"Replay %Y-%m-%d %H-%M-%S");
+	obs_data_set_default_string(defaults, "extension", "mp4");
+	obs_data_set_default_string(defaults, "file_io", "default");
+}
+
+static obs_properties_t *replay_buffer_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_int(props, "max_time_sec",
+			obs_module_text("MaxTimeSec"), 1, 21600, 1);
+	obs_properties_add_int(props, "max_size_mb",
+			obs_module_text("MaxSizeMB"), 0, 65536, 1);
+	obs_properties_add_path(props, "directory",
+			obs_module_text("Directory"),
+			OBS_PATH_DIRECTORY, NULL, NULL);
+	obs_properties_add_text(props, "format",
+			obs_module_text("FilenameFormat"),
+			OBS_TEXT_DEFAULT);
+	obs_properties_add_text(props, "extension",
+			obs_module_text("Extension"),
+			OBS_TEXT_DEFAULT);
+	return props;
+}
+
+struct obs_output_info replay_buffer = {
+	.id             = "replay_buffer",
+	.flags          = OBS_OUTPUT_AV |
+	                  OBS_OUTPUT_ENCODED |
+	                  OBS_OUTPUT_MULTI_TRACK,
+	.get_name       = replay_buffer_getname,
+	.create         = replay_buffer_create,
+	.destroy        = replay_buffer_destroy,
+	.start          = replay_buffer_start,
+	.stop           = replay_buffer_stop,
+	.encoded_packet = replay_buffer_data,
+	.get_defaults   = replay_buffer_defaults,
+	.get_properties = replay_buffer_properties
 };
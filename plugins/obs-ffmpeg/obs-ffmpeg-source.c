@@ -42,8 +42,6 @@ struct ffmpeg_source {
 	int sws_width;
 	int sws_height;
 	enum AVPixelFormat sws_format;
-	uint8_t *sws_data;
-	int sws_linesize;
 	obs_source_t *source;
 
 	char *input;
@@ -137,17 +135,6 @@ bool update_sws_context(struct ffmpeg_source *s, AVFrame *frame)
 
 		}
 
-		if (s->sws_data != NULL)
-			bfree(s->sws_data);
-		s->sws_data = bzalloc(frame->width * frame->height * 4);
-		if (s->sws_data == NULL) {
-			FF_BLOG(LOG_ERROR, "unable to allocate sws "
-					"pixel data with size %d",
-					frame->width * frame->height * 4);
-			goto fail;
-		}
-
-		s->sws_linesize = frame->width * 4;
 		s->sws_width = frame->width;
 		s->sws_height = frame->height;
 		s->sws_format = frame->format;
@@ -160,11 +147,6 @@ fail:
 		sws_freeContext(s->sws_ctx);
 	s->sws_ctx = NULL;
 
-	if (s->sws_data)
-		bfree(s->sws_data);
-	s->sws_data = NULL;
-
-	s->sws_linesize = 0;
 	s->sws_width = 0;
 	s->sws_height = 0;
 	s->sws_format = 0;
@@ -175,24 +157,33 @@ fail:
 static bool video_frame_scale(struct ff_frame *frame,
 		struct ffmpeg_source *s, struct obs_source_frame *obs_frame)
 {
+	struct obs_source_frame *out;
+	int linesize;
+
 	if (!update_sws_context(s, frame->frame))
 		return false;
 
+	/* scale directly into a frame from the source's pool rather than
+	 * scaling to an intermediate buffer that then has to be copied */
+	out = obs_source_get_free_frame(s->source, VIDEO_FORMAT_BGRA,
+			obs_frame->width, obs_frame->height);
+	if (!out)
+		return true;
+
+	linesize = (int)out->linesize[0];
+
 	sws_scale(
 		s->sws_ctx,
 		(uint8_t const *const *)frame->frame->data,
 		frame->frame->linesize,
 		0,
 		frame->frame->height,
-		&s->sws_data,
-		&s->sws_linesize
+		&out->data[0],
+		&linesize
 	);
 
-	obs_frame->data[0]     = s->sws_data;
-	obs_frame->linesize[0] = s->sws_linesize;
-	obs_frame->format      = VIDEO_FORMAT_BGRA;
-
-	obs_source_output_video(s->source, obs_frame);
+	out->timestamp = obs_frame->timestamp;
+	obs_source_output_free_frame(s->source, out);
 
 	return true;
 }
@@ -642,7 +633,6 @@ static void ffmpeg_source_destroy(void *data)
 
 	if (s->sws_ctx != NULL)
 		sws_freeContext(s->sws_ctx);
-	bfree(s->sws_data);
 	bfree(s->input);
 	bfree(s->input_format);
 	bfree(s);
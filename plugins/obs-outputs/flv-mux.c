@@ -261,3 +261,21 @@ void flv_packet_mux(struct encoder_packet *packet,
 	*output = data.bytes.array;
 	*size   = data.bytes.num;
 }
+
+void flv_packet_mux_buffer(struct encoder_packet *packet,
+		struct array_output_data *buffer, bool is_header)
+{
+	struct array_output_data unused;
+	struct serializer s;
+
+	/* array_output_serializer_init clears the output data, so point the
+	 * serializer at the existing buffer afterward to keep its memory */
+	array_output_serializer_init(&s, &unused);
+	s.data = buffer;
+	buffer->bytes.num = 0;
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		flv_video(&s, packet, is_header);
+	else
+		flv_audio(&s, packet, is_header);
+}
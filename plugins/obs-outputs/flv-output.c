@@ -38,6 +38,8 @@ struct flv_output {
 	bool         active;
 	bool         sent_headers;
 	int64_t      last_packet_ts;
+
+	struct array_output_data mux_buffer;
 };
 
 static const char *flv_output_getname(void *unused)
@@ -56,6 +58,7 @@ static void flv_output_destroy(void *data)
 		flv_output_stop(data, 0);
 
 	dstr_free(&stream->path);
+	array_output_serializer_free(&stream->mux_buffer);
 	bfree(stream);
 }
 
@@ -91,15 +94,13 @@ static void flv_output_stop(void *data, uint64_t ts)
 static int write_packet(struct flv_output *stream,
 		struct encoder_packet *packet, bool is_header)
 {
-	uint8_t *data;
-	size_t  size;
 	int     ret = 0;
 
 	stream->last_packet_ts = get_ms_time(packet, packet->dts);
 
-	flv_packet_mux(packet, &data, &size, is_header);
-	fwrite(data, 1, size, stream->file);
-	bfree(data);
+	flv_packet_mux_buffer(packet, &stream->mux_buffer, is_header);
+	fwrite(stream->mux_buffer.bytes.array, 1,
+			stream->mux_buffer.bytes.num, stream->file);
 	obs_free_encoder_packet(packet);
 
 	return ret;
@@ -146,6 +146,10 @@ static void HandleClientBW(RTMP *r, const RTMPPacket *packet);
 
 static int ReadN(RTMP *r, char *buffer, int n);
 static int WriteN(RTMP *r, const char *buffer, int n);
+static int CanWriteV(RTMP *r);
+static int WriteChunksV(RTMP *r, const char *header, int hSize,
+                        const char *body, int nSize, int nChunkSize,
+                        char c, int cSize, int nChannel);
 
 static void DecodeTEA(AVal *key, AVal *text);
 
@@ -1452,6 +1456,170 @@ WriteN(RTMP *r, const char *buffer, int n)
     return n == 0;
 }
 
+#ifdef _WIN32
+typedef WSABUF RTMPIOVec;
+#define IOV_BASE(v)	((v).buf)
+#define IOV_LEN(v)	((v).len)
+#define IOV_SET(v, p, n)	((v).buf = (char *)(p), (v).len = (ULONG)(n))
+#else
+typedef struct iovec RTMPIOVec;
+#define IOV_BASE(v)	((char *)(v).iov_base)
+#define IOV_LEN(v)	((v).iov_len)
+#define IOV_SET(v, p, n)	((v).iov_base = (void *)(p), (v).iov_len = (size_t)(n))
+#endif
+
+/* chunks per vectored write, each chunk taking a header and a body slice */
+#define RTMP_MAX_IOV_CHUNKS 64
+
+/* vectored writes go straight to the socket, so anything that has to see or
+ * transform the outgoing bytes first needs the regular WriteN path */
+static int
+CanWriteV(RTMP *r)
+{
+    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+        return FALSE;
+    if (r->m_bCustomSend && r->m_customSendFunc)
+        return FALSE;
+#ifdef CRYPTO
+    if (r->Link.rc4keyOut)
+        return FALSE;
+#ifndef NO_SSL
+    if (r->m_sb.sb_ssl)
+        return FALSE;
+#endif
+#endif
+    return TRUE;
+}
+
+static int
+RTMPSockBuf_SendV(RTMPSockBuf *sb, RTMPIOVec *iov, int count)
+{
+#if defined(RTMP_NETSTACK_DUMP)
+    int i;
+    for (i = 0; i < count; i++)
+        fwrite(IOV_BASE(iov[i]), 1, IOV_LEN(iov[i]), netstackdump);
+#endif
+
+#ifdef _WIN32
+    DWORD sent = 0;
+    if (WSASend(sb->sb_socket, iov, (DWORD)count, &sent, 0, NULL, NULL) != 0)
+        return -1;
+    return (int)sent;
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    return (int)sendmsg(sb->sb_socket, &msg, 0);
+#endif
+}
+
+static int
+WriteNV(RTMP *r, RTMPIOVec *iov, int count)
+{
+    while (count > 0)
+    {
+        int nBytes = RTMPSockBuf_SendV(&r->m_sb, iov, count);
+
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d buffers)", __FUNCTION__,
+                     sockerr, count);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            return FALSE;
+
+        /* skip past whatever was fully sent and resume partial writes
+         * from the middle of the current buffer */
+        while (count > 0 && nBytes >= (int)IOV_LEN(*iov))
+        {
+            nBytes -= (int)IOV_LEN(*iov);
+            iov++;
+            count--;
+        }
+
+        if (count > 0 && nBytes > 0)
+            IOV_SET(*iov, IOV_BASE(*iov) + nBytes, IOV_LEN(*iov) - nBytes);
+    }
+
+    return TRUE;
+}
+
+/* sends the chunks of a packet with one vectored write per batch of chunks.
+ * continuation chunk headers are built in a scratch area rather than in
+ * front of each slice of the body, so the body is never modified and may be
+ * a buffer owned by the caller */
+static int
+WriteChunksV(RTMP *r, const char *header, int hSize, const char *body,
+             int nSize, int nChunkSize, char c, int cSize, int nChannel)
+{
+    RTMPIOVec iov[RTMP_MAX_IOV_CHUNKS * 2];
+    char headers[RTMP_MAX_IOV_CHUNKS][3];
+    int count = 0;
+    int chunks = 0;
+
+    for (;;)
+    {
+        int len = nSize < nChunkSize ? nSize : nChunkSize;
+        char *next;
+
+        RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)header, hSize);
+        RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)body, len);
+
+        if (hSize)
+        {
+            IOV_SET(iov[count], header, hSize);
+            count++;
+        }
+        if (len)
+        {
+            IOV_SET(iov[count], body, len);
+            count++;
+        }
+
+        body += len;
+        nSize -= len;
+        chunks++;
+
+        if (nSize <= 0)
+            break;
+
+        if (chunks == RTMP_MAX_IOV_CHUNKS)
+        {
+            if (!WriteNV(r, iov, count))
+                return FALSE;
+            count = 0;
+            chunks = 0;
+        }
+
+        next = headers[chunks];
+        next[0] = (0xc0 | c);
+        hSize = 1;
+        if (cSize)
+        {
+            int tmp = nChannel - 64;
+            next[1] = tmp & 0xff;
+            hSize++;
+            if (cSize == 2)
+            {
+                next[2] = tmp >> 8;
+                hSize++;
+            }
+        }
+        header = next;
+    }
+
+    return WriteNV(r, iov, count);
+}
+
 #define SAVC(x)	static const AVal av_##x = AVC(#x)
 
 SAVC(app);
@@ -3937,6 +4105,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     char *buffer, *tbuf = NULL, *toff = NULL;
     int nChunkSize;
     int tlen;
+    int vectored = CanWriteV(r);
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
@@ -3981,7 +4150,9 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     cSize = 0;
     t = packet->m_nTimeStamp - last;
 
-    if (packet->m_body)
+    /* vectored writes keep the header apart from the body, which may not
+     * have any room in front of it */
+    if (packet->m_body && !vectored)
     {
         header = packet->m_body - nSize;
         hend = packet->m_body;
@@ -4053,8 +4224,16 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
 
     RTMP_Log(RTMP_LOGDEBUG2, "%s: fd=%d, size=%d", __FUNCTION__, (int)r->m_sb.sb_socket,
              nSize);
+    if (vectored)
+    {
+        if (!WriteChunksV(r, header, hSize, buffer, nSize, nChunkSize, c,
+                          cSize, packet->m_nChannel))
+            return FALSE;
+        nSize = 0;
+        hSize = 0;
+    }
     /* send all chunks in one HTTP request */
-    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+    else if (r->Link.protocol & RTMP_FEATURE_HTTP)
     {
         int chunks = (nSize+nChunkSize-1) / nChunkSize;
         if (chunks > 1)
@@ -5203,6 +5382,23 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
                 pkt->m_headerType = RTMP_PACKET_SIZE_MEDIUM;
             }
 
+            /* the whole tag is already in the caller's buffer, so send the
+             * body straight from it rather than copying it in to a packet */
+            if (pkt->m_packetType != RTMP_PACKET_TYPE_INFO &&
+                    s2 >= (int)pkt->m_nBodySize && CanWriteV(r))
+            {
+                RTMPPacket direct = *pkt;
+                direct.m_body = (char *)buf;
+                ret = RTMP_SendPacket(r, &direct, FALSE);
+                if (!ret)
+                    return -1;
+                buf += pkt->m_nBodySize + 4;
+                s2 -= pkt->m_nBodySize + 4;
+                if (s2 < 0)
+                    break;
+                continue;
+            }
+
             if (!RTMPPacket_Alloc(pkt, pkt->m_nBodySize))
             {
                 RTMP_Log(RTMP_LOGDEBUG, "%s, failed to allocate packet", __FUNCTION__);
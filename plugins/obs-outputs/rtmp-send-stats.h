@@ -0,0 +1,132 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Send capacity estimation for the rtmp stream.  The socket is blocking, so
+ * the time spent in each write is the time spent waiting for the socket to
+ * become writable.  The fraction of time spent blocked is the congestion, and
+ * the rate at which data went out while blocked is the capacity of the
+ * connection.
+ *
+ * The caller passes in the current time and does any locking.
+ */
+
+/* send statistics are gathered over windows of this length */
+#define SEND_STATS_WINDOW_NS 1000000000ULL
+
+struct send_stats {
+	uint64_t send_start_ns;
+	size_t   send_size;
+	uint64_t window_start_ns;
+	uint64_t window_bytes;
+	uint64_t window_busy_ns;
+	uint64_t capacity_bps;
+	float    congestion;
+	int      rtt_ms;
+};
+
+static inline void send_stats_reset(struct send_stats *stats,
+		uint64_t cur_time)
+{
+	stats->send_start_ns   = 0;
+	stats->send_size       = 0;
+	stats->window_start_ns = cur_time;
+	stats->window_bytes    = 0;
+	stats->window_busy_ns  = 0;
+	stats->capacity_bps    = 0;
+	stats->congestion      = 0.0f;
+	stats->rtt_ms          = -1;
+}
+
+static inline void send_stats_begin(struct send_stats *stats, size_t size,
+		uint64_t cur_time)
+{
+	stats->send_start_ns = cur_time;
+	stats->send_size     = size;
+}
+
+/* whether the write ending at cur_time will complete a window, so the caller
+ * knows when to fetch the rtt for send_stats_end */
+static inline bool send_stats_window_done(const struct send_stats *stats,
+		uint64_t cur_time)
+{
+	return cur_time - stats->window_start_ns >= SEND_STATS_WINDOW_NS;
+}
+
+/* returns true if this completed a window and updated the statistics */
+static inline bool send_stats_end(struct send_stats *stats, size_t size,
+		uint64_t cur_time, int rtt_ms)
+{
+	uint64_t elapsed;
+	uint64_t busy_ns;
+
+	stats->window_bytes   += size;
+	stats->window_busy_ns += cur_time - stats->send_start_ns;
+	stats->send_start_ns   = 0;
+	stats->send_size       = 0;
+
+	elapsed = cur_time - stats->window_start_ns;
+	if (elapsed < SEND_STATS_WINDOW_NS)
+		return false;
+
+	busy_ns = stats->window_busy_ns;
+	if (busy_ns) {
+		uint64_t capacity = stats->window_bytes * 8ULL *
+			1000000000ULL / busy_ns;
+		stats->capacity_bps = stats->capacity_bps ?
+			(stats->capacity_bps * 3 + capacity) / 4 :
+			capacity;
+	}
+
+	stats->congestion = busy_ns >= elapsed ?
+		1.0f : (float)((double)busy_ns / (double)elapsed);
+	stats->rtt_ms = rtt_ms;
+
+	stats->window_start_ns = cur_time;
+	stats->window_bytes    = 0;
+	stats->window_busy_ns  = 0;
+	return true;
+}
+
+/* estimates how long it will take to send everything that is queued, based
+ * on the measured capacity of the connection.  a write that is still blocked
+ * caps the capacity, so a stalled connection is noticed before the write
+ * returns.  returns -1 if the capacity hasn't been measured yet */
+static inline int64_t send_stats_estimate_usec(const struct send_stats *stats,
+		size_t buffered_bytes, uint64_t cur_time)
+{
+	uint64_t capacity = stats->capacity_bps;
+	uint64_t pending = buffered_bytes + stats->send_size;
+
+	if (stats->send_start_ns) {
+		uint64_t blocked_ns = cur_time - stats->send_start_ns;
+		uint64_t bound = blocked_ns ? (uint64_t)stats->send_size *
+			8ULL * 1000000000ULL / blocked_ns : 0;
+
+		if (blocked_ns && (!capacity || bound < capacity))
+			capacity = bound;
+	}
+
+	if (!capacity)
+		return -1;
+
+	return (int64_t)(pending * 8ULL * 1000000ULL / capacity);
+}
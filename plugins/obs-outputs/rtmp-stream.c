@@ -26,6 +26,7 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "rtmp-send-stats.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -33,6 +34,10 @@
 #include <sys/ioctl.h>
 #endif
 
+#ifdef __linux__
+#include <netinet/tcp.h>
+#endif
+
 #define do_log(level, format, ...) \
 	blog(level, "[rtmp stream: '%s'] " format, \
 			obs_output_get_name(stream->output), ##__VA_ARGS__)
@@ -59,11 +64,27 @@ struct droptest_info {
 };
 #endif
 
+/* video packets below this drop priority can be dropped, and are indexed by
+ * their drop priority */
+#define DROPPABLE_PRIORITIES OBS_NAL_PRIORITY_HIGHEST
+
+struct queued_packet {
+	struct encoder_packet packet;
+	bool                  dropped;
+};
+
 struct rtmp_stream {
 	obs_output_t     *output;
 
+	/* queued packets are identified by a sequence number, which is their
+	 * position in the queue plus the sequence number of the first one.
+	 * dropped packets are freed straight away but only removed from the
+	 * queue once they reach the front */
 	pthread_mutex_t  packets_mutex;
 	struct circlebuf packets;
+	uint64_t         first_packet_seq;
+	size_t           num_packets;
+	struct circlebuf droppable[DROPPABLE_PRIORITIES];
 	bool             sent_headers;
 
 	volatile bool    connecting;
@@ -95,6 +116,14 @@ struct rtmp_stream {
 
 	uint64_t         total_bytes_sent;
 	int              dropped_frames;
+	uint64_t         dropped_bytes;
+
+	/* send statistics (protected by packets_mutex) */
+	size_t           buffered_bytes;
+	struct send_stats send_stats;
+
+	/* reused for every packet muxed by the send thread */
+	struct array_output_data mux_buffer;
 
 #ifdef TEST_FRAMEDROPS
 	struct circlebuf droptest_info;
@@ -119,6 +148,8 @@ static void log_rtmp(int level, const char *format, va_list args)
 }
 
 static inline size_t num_buffered_packets(struct rtmp_stream *stream);
+static bool pop_queued_packet(struct rtmp_stream *stream,
+		struct encoder_packet *packet);
 
 static inline void free_packets(struct rtmp_stream *stream)
 {
@@ -131,10 +162,17 @@ static inline void free_packets(struct rtmp_stream *stream)
 		info("Freeing %d remaining packets", (int)num_packets);
 
 	while (stream->packets.size) {
-		struct encoder_packet packet;
-		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
-		obs_free_encoder_packet(&packet);
+		struct queued_packet entry;
+		circlebuf_pop_front(&stream->packets, &entry, sizeof(entry));
+		if (!entry.dropped)
+			obs_free_encoder_packet(&entry.packet);
 	}
+	for (size_t i = 0; i < DROPPABLE_PRIORITIES; i++)
+		circlebuf_free(&stream->droppable[i]);
+
+	stream->first_packet_seq = 0;
+	stream->num_packets = 0;
+	stream->buffered_bytes = 0;
 	pthread_mutex_unlock(&stream->packets_mutex);
 }
 
@@ -191,6 +229,7 @@ static void rtmp_stream_destroy(void *data)
 		os_sem_destroy(stream->send_sem);
 		pthread_mutex_destroy(&stream->packets_mutex);
 		circlebuf_free(&stream->packets);
+		array_output_serializer_free(&stream->mux_buffer);
 #ifdef TEST_FRAMEDROPS
 		circlebuf_free(&stream->droptest_info);
 #endif
@@ -198,8 +237,11 @@ static void rtmp_stream_destroy(void *data)
 	}
 }
 
+static void rtmp_stream_get_send_stats(void *data, calldata_t *cd);
+
 static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 {
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
@@ -213,6 +255,11 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 
+	proc_handler_add(ph, "void get_send_stats(out int capacity_kbps, "
+			"out int rtt_ms, out float congestion, "
+			"out int buffered_bytes, out int dropped_bytes)",
+			rtmp_stream_get_send_stats, stream);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 
@@ -260,11 +307,7 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	bool new_packet = false;
 
 	pthread_mutex_lock(&stream->packets_mutex);
-	if (stream->packets.size) {
-		circlebuf_pop_front(&stream->packets, packet,
-				sizeof(struct encoder_packet));
-		new_packet = true;
-	}
+	new_packet = pop_queued_packet(stream, packet);
 	pthread_mutex_unlock(&stream->packets_mutex);
 
 	return new_packet;
@@ -341,6 +384,49 @@ static void droptest_cap_data_rate(struct rtmp_stream *stream, size_t size)
 }
 #endif
 
+static int get_tcp_rtt_ms(struct rtmp_stream *stream)
+{
+#ifdef __linux__
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+
+	if (getsockopt(stream->rtmp.m_sb.sb_socket, IPPROTO_TCP, TCP_INFO,
+				&info, &len) == 0)
+		return (int)(info.tcpi_rtt / 1000);
+#else
+	UNUSED_PARAMETER(stream);
+#endif
+	return -1;
+}
+
+static inline void reset_send_stats(struct rtmp_stream *stream)
+{
+	pthread_mutex_lock(&stream->packets_mutex);
+	send_stats_reset(&stream->send_stats, os_gettime_ns());
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
+static inline void begin_send(struct rtmp_stream *stream, size_t size)
+{
+	pthread_mutex_lock(&stream->packets_mutex);
+	send_stats_begin(&stream->send_stats, size, os_gettime_ns());
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
+static void end_send(struct rtmp_stream *stream, size_t size)
+{
+	uint64_t cur_time = os_gettime_ns();
+	int rtt_ms = -1;
+
+	/* only the send thread changes the window start */
+	if (send_stats_window_done(&stream->send_stats, cur_time))
+		rtt_ms = get_tcp_rtt_ms(stream);
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	send_stats_end(&stream->send_stats, size, cur_time, rtt_ms);
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
 static int send_packet(struct rtmp_stream *stream,
 		struct encoder_packet *packet, bool is_header, size_t idx)
 {
@@ -361,14 +447,17 @@ static int send_packet(struct rtmp_stream *stream,
 			return -1;
 	}
 
-	flv_packet_mux(packet, &data, &size, is_header);
+	flv_packet_mux_buffer(packet, &stream->mux_buffer, is_header);
+	data = stream->mux_buffer.bytes.array;
+	size = stream->mux_buffer.bytes.num;
 
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
 
+	begin_send(stream, size);
 	ret = RTMP_Write(&stream->rtmp, (char*)data, (int)size, (int)idx);
-	bfree(data);
+	end_send(stream, size);
 
 	obs_free_encoder_packet(packet);
 
@@ -420,6 +509,11 @@ static void *send_thread(void *data)
 		info("User stopped the stream");
 	}
 
+	if (stream->send_stats.capacity_bps)
+		info("Measured send capacity: %"PRIu64" kbps, last RTT: %d ms",
+				stream->send_stats.capacity_bps / 1000,
+				stream->send_stats.rtt_ms);
+
 	RTMP_Close(&stream->rtmp);
 
 	if (!stopping(stream)) {
@@ -551,6 +645,7 @@ static int init_send(struct rtmp_stream *stream)
 #endif
 
 	reset_semaphore(stream);
+	reset_send_stats(stream);
 
 	ret = pthread_create(&stream->send_thread, NULL, send_thread, stream);
 	if (ret != 0) {
@@ -714,6 +809,7 @@ static bool init_connect(struct rtmp_stream *stream)
 	os_atomic_set_bool(&stream->disconnected, false);
 	stream->total_bytes_sent = 0;
 	stream->dropped_frames   = 0;
+	stream->dropped_bytes    = 0;
 	stream->min_drop_dts_usec= 0;
 	stream->min_priority     = 0;
 
@@ -782,65 +878,139 @@ static bool rtmp_stream_start(void *data)
 			stream) == 0;
 }
 
+static inline bool is_droppable(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO &&
+		packet->drop_priority >= 0 &&
+		packet->drop_priority < DROPPABLE_PRIORITIES;
+}
+
+static inline struct queued_packet *get_queued_packet(
+		struct rtmp_stream *stream, uint64_t seq)
+{
+	size_t idx = (size_t)(seq - stream->first_packet_seq);
+	return circlebuf_data(&stream->packets,
+			idx * sizeof(struct queued_packet));
+}
+
 static inline bool add_packet(struct rtmp_stream *stream,
 		struct encoder_packet *packet)
 {
-	circlebuf_push_back(&stream->packets, packet,
-			sizeof(struct encoder_packet));
+	struct queued_packet entry = {*packet, false};
+	uint64_t seq = stream->first_packet_seq +
+		stream->packets.size / sizeof(struct queued_packet);
+
+	circlebuf_push_back(&stream->packets, &entry, sizeof(entry));
+
+	if (is_droppable(packet))
+		circlebuf_push_back(&stream->droppable[packet->drop_priority],
+				&seq, sizeof(seq));
+
+	stream->num_packets++;
+	stream->buffered_bytes += packet->size;
 	stream->last_dts_usec = packet->dts_usec;
 	return true;
 }
 
+/* removes packets that were already dropped from the front of the queue */
+static inline void pop_dropped_packets(struct rtmp_stream *stream)
+{
+	while (stream->packets.size) {
+		struct queued_packet *entry = get_queued_packet(stream,
+				stream->first_packet_seq);
+		if (!entry->dropped)
+			break;
+
+		circlebuf_pop_front(&stream->packets, NULL, sizeof(*entry));
+		stream->first_packet_seq++;
+	}
+}
+
+static bool pop_queued_packet(struct rtmp_stream *stream,
+		struct encoder_packet *packet)
+{
+	struct queued_packet entry;
+
+	pop_dropped_packets(stream);
+	if (!stream->packets.size)
+		return false;
+
+	circlebuf_pop_front(&stream->packets, &entry, sizeof(entry));
+	stream->first_packet_seq++;
+
+	/* packets leave the queue in order, so this packet is also the first
+	 * one in its priority index */
+	if (is_droppable(&entry.packet))
+		circlebuf_pop_front(
+				&stream->droppable[entry.packet.drop_priority],
+				NULL, sizeof(uint64_t));
+
+	stream->num_packets--;
+	stream->buffered_bytes -= entry.packet.size;
+	*packet = entry.packet;
+	return true;
+}
+
+static inline bool peek_first_packet(struct rtmp_stream *stream,
+		struct encoder_packet *packet)
+{
+	pop_dropped_packets(stream);
+	if (!stream->packets.size)
+		return false;
+
+	*packet = get_queued_packet(stream, stream->first_packet_seq)->packet;
+	return true;
+}
+
 static inline size_t num_buffered_packets(struct rtmp_stream *stream)
 {
-	return stream->packets.size / sizeof(struct encoder_packet);
+	return stream->num_packets;
 }
 
+/* drops every queued video packet below the given priority.  only the
+ * packets that are actually dropped are touched, via the priority index */
 static void drop_frames(struct rtmp_stream *stream, const char *name,
 		int highest_priority, int64_t *p_min_dts_usec)
 {
-	struct circlebuf new_buf            = {0};
-	uint64_t         last_drop_dts_usec = 0;
-	int              num_frames_dropped = 0;
+	int      num_frames_dropped = 0;
+	uint64_t num_bytes_dropped  = 0;
 
-#ifdef _DEBUG
-	int start_packets = (int)num_buffered_packets(stream);
-#else
+#ifndef _DEBUG
 	UNUSED_PARAMETER(name);
 #endif
 
-	circlebuf_reserve(&new_buf, sizeof(struct encoder_packet) * 8);
-
-	while (stream->packets.size) {
-		struct encoder_packet packet;
-		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+	for (int i = 0; i < highest_priority && i < DROPPABLE_PRIORITIES; i++) {
+		struct circlebuf *index = &stream->droppable[i];
 
-		last_drop_dts_usec = packet.dts_usec;
+		while (index->size) {
+			struct queued_packet *entry;
+			uint64_t seq;
 
-		/* do not drop audio data or video keyframes */
-		if (packet.type          == OBS_ENCODER_AUDIO ||
-		    packet.drop_priority >= highest_priority) {
-			circlebuf_push_back(&new_buf, &packet, sizeof(packet));
+			circlebuf_pop_front(index, &seq, sizeof(seq));
+			entry = get_queued_packet(stream, seq);
 
-		} else {
 			num_frames_dropped++;
-			obs_free_encoder_packet(&packet);
+			num_bytes_dropped += entry->packet.size;
+			stream->buffered_bytes -= entry->packet.size;
+			stream->num_packets--;
+
+			obs_free_encoder_packet(&entry->packet);
+			entry->dropped = true;
 		}
 	}
 
-	circlebuf_free(&stream->packets);
-	stream->packets = new_buf;
+	pop_dropped_packets(stream);
 
 	if (stream->min_priority < highest_priority)
 		stream->min_priority = highest_priority;
 
-	*p_min_dts_usec = last_drop_dts_usec;
+	*p_min_dts_usec = stream->last_dts_usec;
 
 	stream->dropped_frames += num_frames_dropped;
+	stream->dropped_bytes  += num_bytes_dropped;
 #ifdef _DEBUG
-	debug("Dropped %s, prev packet count: %d, new packet count: %d",
-			name,
-			start_packets,
+	debug("Dropped %s: %d frames, %"PRIu64" bytes, new packet count: %d",
+			name, num_frames_dropped, num_bytes_dropped,
 			(int)num_buffered_packets(stream));
 #endif
 }
@@ -863,15 +1033,20 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	if (num_packets < 5)
 		return;
 
-	circlebuf_peek_front(&stream->packets, &first, sizeof(first));
+	if (!peek_first_packet(stream, &first))
+		return;
 
 	/* do not drop frames if frames were just dropped within this time */
 	if (first.dts_usec < *p_min_dts_usec)
 		return;
 
-	/* if the amount of time stored in the buffered packets waiting to be
-	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	/* if the amount of time it will take to send the buffered packets is
+	 * higher than threshold, drop frames.  until the capacity of the
+	 * connection is known, use the duration of the buffered packets */
+	buffer_duration_usec = send_stats_estimate_usec(&stream->send_stats,
+			stream->buffered_bytes, os_gettime_ns());
+	if (buffer_duration_usec < 0)
+		buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
 
 	if (buffer_duration_usec > drop_threshold) {
 		debug("buffer_duration_usec: %lld", buffer_duration_usec);
@@ -975,6 +1150,34 @@ static int rtmp_stream_dropped_frames(void *data)
 	return stream->dropped_frames;
 }
 
+static float rtmp_stream_congestion(void *data)
+{
+	struct rtmp_stream *stream = data;
+	float congestion;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	congestion = stream->send_stats.congestion;
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	return congestion;
+}
+
+static void rtmp_stream_get_send_stats(void *data, calldata_t *cd)
+{
+	struct rtmp_stream *stream = data;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	calldata_set_int(cd, "capacity_kbps",
+			(long long)(stream->send_stats.capacity_bps / 1000));
+	calldata_set_int(cd, "rtt_ms", stream->send_stats.rtt_ms);
+	calldata_set_float(cd, "congestion", stream->send_stats.congestion);
+	calldata_set_int(cd, "buffered_bytes",
+			(long long)stream->buffered_bytes);
+	calldata_set_int(cd, "dropped_bytes",
+			(long long)stream->dropped_bytes);
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
 struct obs_output_info rtmp_output_info = {
 	.id                 = "rtmp_output",
 	.flags              = OBS_OUTPUT_AV |
@@ -990,5 +1193,6 @@ struct obs_output_info rtmp_output_info = {
 	.get_defaults       = rtmp_stream_defaults,
 	.get_properties     = rtmp_stream_properties,
 	.get_total_bytes    = rtmp_stream_total_bytes_sent,
-	.get_dropped_frames = rtmp_stream_dropped_frames
+	.get_dropped_frames = rtmp_stream_dropped_frames,
+	.get_congestion     = rtmp_stream_congestion
 };
@@ -54,6 +54,7 @@ static void CreateOBS()
 	ovi.base_height     = cy;
 	ovi.output_width    = cx;
 	ovi.output_height   = cy;
+	ovi.conversion_threads = 0;
 
 	if (obs_reset_video(&ovi) != 0)
 		throw "Couldn't initialize video";
@@ -0,0 +1,346 @@
+#include <math.h>
+#include <util/platform.h>
+#include <media-io/audio-math.h>
+#include <media-io/audio-math-simd.h>
+
+#include "unit-test.h"
+
+/*
+ * Checks the SSE and AVX audio buffer functions against the scalar loops
+ * they replaced, for every count up to a few vectors so the remainder
+ * handling is covered, and with NaN, infinity and signed zero samples for
+ * clamping.  Results have to be bit-identical.  The silence check is tested
+ * with a non-zero sample at every position.
+ *
+ * Run with "--bench" to also time each version on 1024 frame planes, the
+ * size of one audio tick.
+ */
+
+typedef void (*add_func)(float *dst, const float *src, size_t count);
+typedef void (*add_mul_func)(float *dst, const float *src, const float *mul,
+		size_t count);
+typedef void (*mul_func)(float *data, const float *mul, size_t count);
+typedef void (*scale_func)(float *data, float vol, size_t count);
+typedef void (*clamp_func)(float *data, size_t count);
+typedef bool (*silent_func)(const float *data, size_t count);
+
+struct audio_math_funcs {
+	const char   *name;
+	uint32_t     cpu_flag;
+	add_func     add;
+	add_mul_func add_mul;
+	mul_func     mul;
+	scale_func   scale;
+	clamp_func   clamp;
+	silent_func  silent;
+};
+
+/* ------------------------------------------------------------------------- */
+/* the scalar loops from before vectorizing                                  */
+
+static void audio_mix_add_c(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+static void audio_mix_add_mul_c(float *dst, const float *src,
+		const float *mul, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i] * mul[i];
+}
+
+static void audio_mix_mul_c(float *data, const float *mul, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] *= mul[i];
+}
+
+static void audio_mix_scale_c(float *data, float vol, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] *= vol;
+}
+
+static void audio_mix_clamp_c(float *data, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		float val = data[i];
+		val = (val >  1.0f) ?  1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		data[i] = val;
+	}
+}
+
+static bool audio_mix_silent_c(const float *data, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (data[i] != 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+static const struct audio_math_funcs scalar = {
+	"scalar", 0,
+	audio_mix_add_c,
+	audio_mix_add_mul_c,
+	audio_mix_mul_c,
+	audio_mix_scale_c,
+	audio_mix_clamp_c,
+	audio_mix_silent_c
+};
+
+static const struct audio_math_funcs simd_versions[] = {
+	{
+		"sse", OS_CPU_SSE2,
+		audio_mix_add_sse,
+		audio_mix_add_mul_sse,
+		audio_mix_mul_sse,
+		audio_mix_scale_sse,
+		audio_mix_clamp_sse,
+		audio_mix_silent_sse
+	},
+	{
+		"avx", OS_CPU_AVX,
+		audio_mix_add_avx,
+		audio_mix_add_mul_avx,
+		audio_mix_mul_avx,
+		audio_mix_scale_avx,
+		audio_mix_clamp_avx,
+		audio_mix_silent_avx
+	}
+};
+
+#define SIMD_VERSIONS (sizeof(simd_versions) / sizeof(simd_versions[0]))
+
+/* ------------------------------------------------------------------------- */
+
+#define MAX_COUNT 1024
+#define GUARD     8
+
+static uint32_t random_state = 1;
+
+static float random_sample(float range)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return ((float)(random_state >> 8) / (float)(1 << 24) * 2.0f - 1.0f) *
+		range;
+}
+
+static void fill_random(float *data, size_t count, float range)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] = random_sample(range);
+}
+
+/* samples that the clamp has to get exactly like the scalar loop does */
+static void add_special_values(float *data, size_t count)
+{
+	static const float special[] = {
+		NAN, -NAN, INFINITY, -INFINITY, 0.0f, -0.0f,
+		1.0f, -1.0f, 1.0000001f, -1.0000001f, 1e30f, -1e30f
+	};
+	size_t special_count = sizeof(special) / sizeof(special[0]);
+
+	for (size_t i = 0; i < count; i += 3)
+		data[i] = special[(i / 3) % special_count];
+}
+
+struct test_data {
+	float src[MAX_COUNT + GUARD];
+	float mul[MAX_COUNT + GUARD];
+	float dst[MAX_COUNT + GUARD];
+	float expected[MAX_COUNT + GUARD];
+};
+
+static void check_same(const char *func, const struct audio_math_funcs *funcs,
+		const struct test_data *data, size_t count)
+{
+	bool same = memcmp(data->dst, data->expected,
+			sizeof(data->dst)) == 0;
+
+	if (!same)
+		fprintf(stderr, "%s %s differs for %u samples\n",
+				funcs->name, func, (unsigned)count);
+	check(same);
+}
+
+static void test_version(const struct audio_math_funcs *funcs,
+		struct test_data *data, size_t count)
+{
+	float start[MAX_COUNT + GUARD];
+
+	fill_random(start, MAX_COUNT + GUARD, 2.0f);
+	fill_random(data->src, MAX_COUNT + GUARD, 2.0f);
+	fill_random(data->mul, MAX_COUNT + GUARD, 1.0f);
+
+#define run_both(func, ...)                                                   \
+	do {                                                                  \
+		memcpy(data->expected, start, sizeof(start));                 \
+		scalar.func(data->expected, __VA_ARGS__);                     \
+		memcpy(data->dst, start, sizeof(start));                      \
+		funcs->func(data->dst, __VA_ARGS__);                          \
+		check_same(#func, funcs, data, count);                        \
+	} while (false)
+
+	run_both(add, data->src, count);
+	run_both(add_mul, data->src, data->mul, count);
+	run_both(mul, data->mul, count);
+	run_both(scale, 0.7f, count);
+	run_both(clamp, count);
+
+	add_special_values(start, MAX_COUNT + GUARD);
+	run_both(clamp, count);
+
+#undef run_both
+}
+
+static void test_silent(const struct audio_math_funcs *funcs, size_t count)
+{
+	static const float not_silent[] = {
+		1.0f, -1.0f, 1e-45f, NAN, INFINITY
+	};
+	float data[MAX_COUNT + GUARD];
+
+	/* samples past the end don't count */
+	for (size_t i = 0; i < MAX_COUNT + GUARD; i++)
+		data[i] = (i < count) ? ((i & 1) ? -0.0f : 0.0f) : 1.0f;
+
+	check(funcs->silent(data, count));
+
+	for (size_t i = 0; i < count; i++) {
+		float val = data[i];
+
+		for (size_t j = 0; j < sizeof(not_silent) / sizeof(float); j++) {
+			data[i] = not_silent[j];
+			if (funcs->silent(data, count)) {
+				fprintf(stderr, "%s silent misses %g at %u "
+						"of %u samples\n",
+						funcs->name, not_silent[j],
+						(unsigned)i, (unsigned)count);
+				check(false);
+			}
+		}
+
+		data[i] = val;
+	}
+}
+
+static void test_simd_versions(void)
+{
+	uint32_t cpu_features = os_get_cpu_features();
+	static struct test_data data;
+
+	for (size_t i = 0; i < SIMD_VERSIONS; i++) {
+		const struct audio_math_funcs *funcs = &simd_versions[i];
+
+		if ((cpu_features & funcs->cpu_flag) == 0) {
+			printf("%s not supported by this cpu, skipped\n",
+					funcs->name);
+			continue;
+		}
+
+		for (size_t count = 0; count <= 40; count++) {
+			test_version(funcs, &data, count);
+			test_silent(funcs, count);
+		}
+		test_version(funcs, &data, MAX_COUNT - 1);
+		test_version(funcs, &data, MAX_COUNT);
+		test_silent(funcs, MAX_COUNT);
+	}
+}
+
+static void test_clamp_nan(void)
+{
+	float data[16];
+
+	for (size_t i = 0; i < 16; i++)
+		data[i] = (i & 1) ? NAN : 2.0f;
+
+	audio_mix_clamp(data, 16);
+
+	for (size_t i = 0; i < 16; i++) {
+		if (i & 1)
+			check(isnan(data[i]));
+		else
+			check(data[i] == 1.0f);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define BENCH_ITERATIONS 100000
+
+static double bench_ns(uint64_t start)
+{
+	return (double)(os_gettime_ns() - start) / BENCH_ITERATIONS;
+}
+
+static void bench_version(const struct audio_math_funcs *funcs)
+{
+	static struct test_data data;
+	double add_ns, add_mul_ns, scale_ns, clamp_ns;
+	uint64_t start;
+
+	fill_random(data.src, MAX_COUNT, 0.1f);
+	fill_random(data.mul, MAX_COUNT, 1.0f);
+	fill_random(data.dst, MAX_COUNT, 0.1f);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		funcs->add(data.dst, data.src, MAX_COUNT);
+	add_ns = bench_ns(start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		funcs->add_mul(data.dst, data.src, data.mul, MAX_COUNT);
+	add_mul_ns = bench_ns(start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		funcs->scale(data.dst, 1.0f, MAX_COUNT);
+	scale_ns = bench_ns(start);
+
+	/* half the samples out of range, so the branches can't predict */
+	for (size_t i = 0; i < MAX_COUNT; i++)
+		data.src[i] = random_sample(2.0f);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		memcpy(data.dst, data.src, MAX_COUNT * sizeof(float));
+		funcs->clamp(data.dst, MAX_COUNT);
+	}
+	clamp_ns = bench_ns(start);
+
+	printf("  %-7s add %7.1f, add_mul %7.1f, scale %7.1f, "
+			"copy+clamp %7.1f\n", funcs->name,
+			add_ns, add_mul_ns, scale_ns, clamp_ns);
+}
+
+static void bench_versions(void)
+{
+	uint32_t cpu_features = os_get_cpu_features();
+
+	printf("ns per %d sample call:\n", MAX_COUNT);
+
+	bench_version(&scalar);
+
+	for (size_t i = 0; i < SIMD_VERSIONS; i++) {
+		if (cpu_features & simd_versions[i].cpu_flag)
+			bench_version(&simd_versions[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	test_simd_versions();
+	test_clamp_nan();
+
+	if (unit_test_bench(argc, argv))
+		bench_versions();
+
+	return unit_test_result("test-audio-math");
+}
@@ -0,0 +1,428 @@
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion-simd.h>
+
+#include "unit-test.h"
+
+/*
+ * Checks that the SSSE3 and AVX2 format conversion functions give the same
+ * output as the SSE2 versions they replace, for odd widths and heights so
+ * every tail case of the vectorized loops is hit.  Every output buffer is
+ * compared whole, so writes past the end of a row are caught too.
+ *
+ * The functions take their row widths from the linesizes, so the linesizes
+ * used here are only as aligned as the SSE2 versions need (4 pixels for the
+ * uyvx input, 2 pixels for the decompressed formats).  Functions that work on
+ * two rows at a time get an extra row for odd heights.
+ *
+ * Run with "--bench" to also time each version at 720p, 1080p and 4K.
+ */
+
+typedef void (*compress_func)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+typedef void (*decompress_planar_func)(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize);
+
+typedef void (*decompress_packed_func)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
+
+struct conversion_funcs {
+	const char             *name;
+	uint32_t               cpu_flag;
+	compress_func          to_i420;
+	compress_func          to_nv12;
+	compress_func          to_i444;
+	decompress_planar_func from_420;
+	decompress_planar_func from_nv12;
+	decompress_packed_func from_422;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static inline uint32_t align_size(uint32_t size, uint32_t align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const struct conversion_funcs reference = {
+	"sse2", OS_CPU_SSE2,
+	compress_uyvx_to_i420_sse2,
+	compress_uyvx_to_nv12_sse2,
+	convert_uyvx_to_i444_sse2,
+	decompress_420_sse2,
+	decompress_nv12_sse2,
+	decompress_422_sse2
+};
+
+static const struct conversion_funcs simd_versions[] = {
+	{
+		"ssse3", OS_CPU_SSSE3,
+		compress_uyvx_to_i420_ssse3,
+		compress_uyvx_to_nv12_ssse3,
+		convert_uyvx_to_i444_ssse3,
+		decompress_420_ssse3,
+		decompress_nv12_ssse3,
+		decompress_422_ssse3
+	},
+	{
+		"avx2", OS_CPU_AVX2,
+		compress_uyvx_to_i420_avx2,
+		compress_uyvx_to_nv12_avx2,
+		convert_uyvx_to_i444_avx2,
+		decompress_420_avx2,
+		decompress_nv12_avx2,
+		decompress_422_avx2
+	}
+};
+
+#define SIMD_VERSIONS (sizeof(simd_versions) / sizeof(simd_versions[0]))
+
+/* output buffers get this much extra, to catch writes past the end */
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xCD
+
+struct test_buffers {
+	uint8_t  *input[3];
+	uint32_t in_linesize[3];
+	size_t   in_size[3];
+
+	uint8_t  *output[3];
+	uint32_t out_linesize[3];
+	size_t   out_size[3];
+};
+
+static uint32_t random_state = 1;
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		random_state = random_state * 1103515245 + 12345;
+		data[i] = (uint8_t)(random_state >> 16);
+	}
+}
+
+static void buffers_init(struct test_buffers *buf,
+		const uint32_t in_linesize[3], const size_t in_size[3],
+		const uint32_t out_linesize[3], const size_t out_size[3])
+{
+	memset(buf, 0, sizeof(*buf));
+
+	for (size_t i = 0; i < 3; i++) {
+		buf->in_linesize[i]  = in_linesize[i];
+		buf->in_size[i]      = in_size[i];
+		buf->out_linesize[i] = out_linesize[i];
+		buf->out_size[i]     = out_size[i];
+
+		if (in_size[i]) {
+			buf->input[i] = bmalloc(in_size[i]);
+			fill_random(buf->input[i], in_size[i]);
+		}
+		if (out_size[i])
+			buf->output[i] = bmalloc(out_size[i] + GUARD_SIZE);
+	}
+}
+
+static void buffers_reset_output(struct test_buffers *buf)
+{
+	for (size_t i = 0; i < 3; i++) {
+		if (buf->output[i])
+			memset(buf->output[i], GUARD_BYTE,
+					buf->out_size[i] + GUARD_SIZE);
+	}
+}
+
+static void buffers_save_output(struct test_buffers *buf, uint8_t *saved[3])
+{
+	for (size_t i = 0; i < 3; i++) {
+		saved[i] = NULL;
+		if (buf->output[i])
+			saved[i] = bmemdup(buf->output[i],
+					buf->out_size[i] + GUARD_SIZE);
+	}
+}
+
+static bool buffers_compare_output(struct test_buffers *buf,
+		uint8_t *saved[3])
+{
+	for (size_t i = 0; i < 3; i++) {
+		if (buf->output[i] && memcmp(buf->output[i], saved[i],
+					buf->out_size[i] + GUARD_SIZE) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void buffers_free(struct test_buffers *buf)
+{
+	for (size_t i = 0; i < 3; i++) {
+		bfree(buf->input[i]);
+		bfree(buf->output[i]);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+enum conversion {
+	CONVERSION_I420,
+	CONVERSION_NV12,
+	CONVERSION_I444,
+	CONVERSION_FROM_420,
+	CONVERSION_FROM_NV12,
+	CONVERSION_FROM_422_Y,
+	CONVERSION_FROM_422_U,
+	CONVERSION_COUNT
+};
+
+static const char *conversion_names[CONVERSION_COUNT] = {
+	"uyvx to i420",
+	"uyvx to nv12",
+	"uyvx to i444",
+	"420 to uyvx",
+	"nv12 to uyvx",
+	"422 (yuy2) to uyvx",
+	"422 (uyvy) to uyvx"
+};
+
+static void buffers_init_for(struct test_buffers *buf, enum conversion conv,
+		uint32_t width, uint32_t height)
+{
+	uint32_t in_linesize[3]  = {0};
+	uint32_t out_linesize[3] = {0};
+	size_t   in_size[3]      = {0};
+	size_t   out_size[3]     = {0};
+	uint32_t uyvx_width      = align_size(width, 4);
+	uint32_t width2          = align_size(width, 2);
+	uint32_t rows            = align_size(height, 2);
+
+	switch (conv) {
+	case CONVERSION_I420:
+	case CONVERSION_NV12:
+	case CONVERSION_I444:
+		in_linesize[0]  = uyvx_width * 4;
+		in_size[0]      = (size_t)in_linesize[0] * rows;
+		out_linesize[0] = uyvx_width;
+		out_size[0]     = (size_t)uyvx_width * rows;
+
+		if (conv == CONVERSION_I420) {
+			out_linesize[1] = out_linesize[2] = uyvx_width / 2;
+			out_size[1] = out_size[2] = out_size[0] / 4;
+		} else if (conv == CONVERSION_NV12) {
+			out_linesize[1] = uyvx_width;
+			out_size[1]     = out_size[0] / 2;
+		} else {
+			out_linesize[1] = out_linesize[2] = uyvx_width;
+			out_size[1] = out_size[2] = out_size[0];
+		}
+		break;
+
+	case CONVERSION_FROM_420:
+	case CONVERSION_FROM_NV12:
+		in_linesize[0] = width2;
+		in_size[0]     = (size_t)width2 * rows;
+
+		if (conv == CONVERSION_FROM_420) {
+			in_linesize[1] = in_linesize[2] = width2 / 2;
+			in_size[1] = in_size[2] = in_size[0] / 4;
+		} else {
+			in_linesize[1] = width2;
+			in_size[1]     = in_size[0] / 2;
+		}
+
+		out_linesize[0] = width2 * 4;
+		out_size[0]     = (size_t)out_linesize[0] * rows;
+		break;
+
+	case CONVERSION_FROM_422_Y:
+	case CONVERSION_FROM_422_U:
+		/* each row reads and writes twice its linesize, see
+		 * decompress_422 */
+		in_linesize[0]  = width2 * 2;
+		in_size[0]      = (size_t)in_linesize[0] * (height + 1);
+		out_linesize[0] = width2 * 4;
+		out_size[0]     = (size_t)out_linesize[0] * (height + 1);
+		break;
+
+	default:;
+	}
+
+	buffers_init(buf, in_linesize, in_size, out_linesize, out_size);
+}
+
+static void run_conversion(const struct conversion_funcs *funcs,
+		enum conversion conv, struct test_buffers *buf,
+		uint32_t height)
+{
+	const uint8_t *const *planes = (const uint8_t *const *)buf->input;
+
+	switch (conv) {
+	case CONVERSION_I420:
+		funcs->to_i420(buf->input[0], buf->in_linesize[0], 0, height,
+				buf->output, buf->out_linesize);
+		break;
+	case CONVERSION_NV12:
+		funcs->to_nv12(buf->input[0], buf->in_linesize[0], 0, height,
+				buf->output, buf->out_linesize);
+		break;
+	case CONVERSION_I444:
+		funcs->to_i444(buf->input[0], buf->in_linesize[0], 0, height,
+				buf->output, buf->out_linesize);
+		break;
+	case CONVERSION_FROM_420:
+		funcs->from_420(planes, buf->in_linesize, 0, height,
+				buf->output[0], buf->out_linesize[0]);
+		break;
+	case CONVERSION_FROM_NV12:
+		funcs->from_nv12(planes, buf->in_linesize, 0, height,
+				buf->output[0], buf->out_linesize[0]);
+		break;
+	case CONVERSION_FROM_422_Y:
+	case CONVERSION_FROM_422_U:
+		funcs->from_422(buf->input[0], buf->in_linesize[0], 0, height,
+				buf->output[0], buf->out_linesize[0],
+				conv == CONVERSION_FROM_422_Y);
+		break;
+	default:;
+	}
+}
+
+static void test_bit_exact(const struct conversion_funcs *funcs,
+		enum conversion conv, uint32_t width, uint32_t height)
+{
+	struct test_buffers buf;
+	uint8_t *expected[3];
+	bool same;
+
+	buffers_init_for(&buf, conv, width, height);
+
+	buffers_reset_output(&buf);
+	run_conversion(&reference, conv, &buf, height);
+	buffers_save_output(&buf, expected);
+
+	buffers_reset_output(&buf);
+	run_conversion(funcs, conv, &buf, height);
+	same = buffers_compare_output(&buf, expected);
+
+	if (!same)
+		fprintf(stderr, "%s %s differs at %ux%u\n", funcs->name,
+				conversion_names[conv], width, height);
+	check(same);
+
+	for (size_t i = 0; i < 3; i++)
+		bfree(expected[i]);
+	buffers_free(&buf);
+}
+
+static const uint32_t test_widths[]  = {
+	1, 2, 3, 5, 7, 9, 15, 17, 31, 33, 63, 65, 127, 641, 1279, 1921
+};
+static const uint32_t test_heights[] = {1, 2, 3, 5, 17, 101};
+
+#define ARRAY_COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+static void test_simd_versions(void)
+{
+	uint32_t cpu_features = os_get_cpu_features();
+
+	for (size_t i = 0; i < SIMD_VERSIONS; i++) {
+		const struct conversion_funcs *funcs = &simd_versions[i];
+
+		if ((cpu_features & funcs->cpu_flag) == 0) {
+			printf("%s not supported by this cpu, skipped\n",
+					funcs->name);
+			continue;
+		}
+
+		for (int conv = 0; conv < CONVERSION_COUNT; conv++)
+		for (size_t w = 0; w < ARRAY_COUNT(test_widths); w++)
+		for (size_t h = 0; h < ARRAY_COUNT(test_heights); h++)
+			test_bit_exact(funcs, (enum conversion)conv,
+					test_widths[w], test_heights[h]);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct bench_size {
+	uint32_t width;
+	uint32_t height;
+	int      iterations;
+};
+
+static const struct bench_size bench_sizes[] = {
+	{1280,  720, 400},
+	{1920, 1080, 200},
+	{3840, 2160,  50}
+};
+
+static double bench_conversion(const struct conversion_funcs *funcs,
+		enum conversion conv, struct test_buffers *buf,
+		const struct bench_size *size)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < size->iterations; i++)
+		run_conversion(funcs, conv, buf, size->height);
+
+	return (double)(os_gettime_ns() - start) / size->iterations /
+		1000000.0;
+}
+
+static void bench_size(const struct bench_size *size)
+{
+	uint32_t cpu_features = os_get_cpu_features();
+
+	printf("ms per %ux%u conversion:\n", size->width, size->height);
+
+	for (int conv = 0; conv < CONVERSION_COUNT; conv++) {
+		struct test_buffers buf;
+
+		buffers_init_for(&buf, (enum conversion)conv, size->width,
+				size->height);
+		buffers_reset_output(&buf);
+
+		printf("  %-20s %s %.3f", conversion_names[conv],
+				reference.name,
+				bench_conversion(&reference,
+					(enum conversion)conv, &buf, size));
+
+		for (size_t i = 0; i < SIMD_VERSIONS; i++) {
+			const struct conversion_funcs *funcs = &simd_versions[i];
+
+			if (cpu_features & funcs->cpu_flag)
+				printf(", %s %.3f", funcs->name,
+						bench_conversion(funcs,
+							(enum conversion)conv,
+							&buf, size));
+		}
+
+		printf("\n");
+		buffers_free(&buf);
+	}
+}
+
+static void bench_versions(void)
+{
+	for (size_t i = 0; i < ARRAY_COUNT(bench_sizes); i++)
+		bench_size(&bench_sizes[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	test_simd_versions();
+
+	if (unit_test_bench(argc, argv))
+		bench_versions();
+
+	return unit_test_result("test-format-conversion");
+}
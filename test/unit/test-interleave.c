@@ -0,0 +1,422 @@
+#include <obs-interleave.h>
+
+#include "unit-test.h"
+
+/*
+ * Replays a recorded packet timeline (video plus two audio tracks, in the
+ * order the encoders delivered them) through the per-track interleave queues
+ * and checks that packets come out sorted by dts, with packets of equal dts
+ * in the order they were queued.  The timeline includes ties across tracks
+ * and packets that arrived out of order within their track.
+ *
+ * Randomized packet streams are also run through both the queues and the
+ * single sorted array obs-output used before (insert_interleaved_packet
+ * below), sending packets in between, and both have to send the same packets
+ * in the same order.
+ */
+
+struct timeline_packet {
+	enum obs_encoder_type type;
+	size_t                track_idx;
+	int64_t               dts_usec;
+	bool                  keyframe;
+};
+
+static const struct timeline_packet timeline[] = {
+	{OBS_ENCODER_AUDIO, 0,       0, false},
+	{OBS_ENCODER_AUDIO, 1,       0, false},
+	{OBS_ENCODER_AUDIO, 0,   21333, false},
+	{OBS_ENCODER_AUDIO, 1,   21333, false},
+	{OBS_ENCODER_VIDEO, 0,       0, true},
+	{OBS_ENCODER_AUDIO, 0,   42666, false},
+	{OBS_ENCODER_AUDIO, 1,   42666, false},
+	{OBS_ENCODER_VIDEO, 0,   33333, false},
+	{OBS_ENCODER_AUDIO, 0,   63999, false},
+	{OBS_ENCODER_AUDIO, 1,   63999, false},
+	{OBS_ENCODER_AUDIO, 0,   85332, false},
+	{OBS_ENCODER_AUDIO, 1,   85332, false},
+	{OBS_ENCODER_VIDEO, 0,   66666, false},
+	{OBS_ENCODER_AUDIO, 0,  106665, false},
+	{OBS_ENCODER_AUDIO, 1,  106665, false},
+	{OBS_ENCODER_AUDIO, 0,  127998, false},
+	{OBS_ENCODER_AUDIO, 1,  127998, false},
+	{OBS_ENCODER_VIDEO, 0,   99999, false},
+	{OBS_ENCODER_AUDIO, 0,  149331, false},
+	{OBS_ENCODER_AUDIO, 1,  149331, false},
+	{OBS_ENCODER_AUDIO, 0,  170664, false},
+	{OBS_ENCODER_VIDEO, 0,  133332, false},
+	{OBS_ENCODER_AUDIO, 1,  170664, false},
+	{OBS_ENCODER_VIDEO, 0,  166665, false},
+	{OBS_ENCODER_AUDIO, 0,  191997, false},
+	{OBS_ENCODER_AUDIO, 1,  191997, false},
+	{OBS_ENCODER_AUDIO, 0,  213330, false},
+	{OBS_ENCODER_AUDIO, 1,  234663, false},
+	{OBS_ENCODER_AUDIO, 0,  234663, false},
+	{OBS_ENCODER_AUDIO, 1,  213330, false},
+	{OBS_ENCODER_VIDEO, 0,  199998, false},
+	{OBS_ENCODER_VIDEO, 0,  233331, false},
+	{OBS_ENCODER_AUDIO, 0,  255996, false},
+	{OBS_ENCODER_AUDIO, 1,  255996, false},
+	{OBS_ENCODER_AUDIO, 0,  277329, false},
+	{OBS_ENCODER_AUDIO, 1,  277329, false},
+	{OBS_ENCODER_VIDEO, 0,  266664, false},
+	{OBS_ENCODER_AUDIO, 0,  298662, false},
+	{OBS_ENCODER_AUDIO, 1,  298662, false},
+	{OBS_ENCODER_AUDIO, 0,  319995, false},
+	{OBS_ENCODER_AUDIO, 1,  319995, false},
+	{OBS_ENCODER_AUDIO, 0,  341328, false},
+	{OBS_ENCODER_AUDIO, 1,  341328, false},
+	{OBS_ENCODER_VIDEO, 0,  299997, false},
+	{OBS_ENCODER_VIDEO, 0,  333330, false},
+	{OBS_ENCODER_AUDIO, 0,  362661, false},
+	{OBS_ENCODER_AUDIO, 1,  362661, false},
+	{OBS_ENCODER_AUDIO, 0,  383994, false},
+	{OBS_ENCODER_AUDIO, 1,  383994, false},
+	{OBS_ENCODER_AUDIO, 0,  405327, false},
+	{OBS_ENCODER_AUDIO, 1,  405327, false},
+	{OBS_ENCODER_VIDEO, 0,  366663, false},
+	{OBS_ENCODER_VIDEO, 0,  399996, false},
+	{OBS_ENCODER_AUDIO, 0,  426660, false},
+	{OBS_ENCODER_AUDIO, 1,  426660, false},
+	{OBS_ENCODER_AUDIO, 1,  447993, false},
+	{OBS_ENCODER_AUDIO, 0,  447993, false},
+	{OBS_ENCODER_VIDEO, 0,  433329, false},
+	{OBS_ENCODER_AUDIO, 0,  469326, false},
+	{OBS_ENCODER_AUDIO, 1,  469326, false},
+	{OBS_ENCODER_VIDEO, 0,  466662, false},
+	{OBS_ENCODER_AUDIO, 0,  490659, false},
+	{OBS_ENCODER_AUDIO, 1,  490659, false},
+	{OBS_ENCODER_AUDIO, 0,  511992, false},
+	{OBS_ENCODER_AUDIO, 1,  511992, false},
+	{OBS_ENCODER_VIDEO, 0,  499995, true},
+	{OBS_ENCODER_AUDIO, 0,  533325, false},
+	{OBS_ENCODER_AUDIO, 1,  533325, false},
+	{OBS_ENCODER_AUDIO, 0,  554658, false},
+	{OBS_ENCODER_AUDIO, 1,  554658, false},
+	{OBS_ENCODER_VIDEO, 0,  533328, false},
+	{OBS_ENCODER_AUDIO, 0,  575991, false},
+	{OBS_ENCODER_AUDIO, 1,  575991, false},
+	{OBS_ENCODER_VIDEO, 0,  566661, false},
+	{OBS_ENCODER_AUDIO, 0,  597324, false},
+	{OBS_ENCODER_AUDIO, 1,  597324, false},
+	{OBS_ENCODER_AUDIO, 0,  618657, false},
+	{OBS_ENCODER_AUDIO, 1,  618657, false},
+	{OBS_ENCODER_VIDEO, 0,  599994, false},
+	{OBS_ENCODER_AUDIO, 0,  639990, false},
+	{OBS_ENCODER_VIDEO, 0,  633327, false},
+	{OBS_ENCODER_AUDIO, 1,  639990, false},
+	{OBS_ENCODER_AUDIO, 0,  661323, false},
+	{OBS_ENCODER_AUDIO, 1,  661323, false},
+	{OBS_ENCODER_AUDIO, 0,  682656, false},
+	{OBS_ENCODER_AUDIO, 1,  682656, false},
+	{OBS_ENCODER_AUDIO, 0,  703989, false},
+	{OBS_ENCODER_AUDIO, 1,  703989, false},
+	{OBS_ENCODER_VIDEO, 0,  666660, false},
+	{OBS_ENCODER_AUDIO, 0,  725322, false},
+	{OBS_ENCODER_AUDIO, 1,  725322, false},
+	{OBS_ENCODER_VIDEO, 0,  699993, false},
+	{OBS_ENCODER_AUDIO, 0,  746655, false},
+	{OBS_ENCODER_AUDIO, 1,  746655, false},
+	{OBS_ENCODER_VIDEO, 0,  733326, false},
+	{OBS_ENCODER_AUDIO, 0,  767988, false},
+	{OBS_ENCODER_AUDIO, 1,  767988, false},
+	{OBS_ENCODER_AUDIO, 0,  789321, false},
+	{OBS_ENCODER_AUDIO, 1,  789321, false},
+	{OBS_ENCODER_VIDEO, 0,  766659, false},
+	{OBS_ENCODER_AUDIO, 0,  810654, false},
+	{OBS_ENCODER_AUDIO, 1,  810654, false},
+	{OBS_ENCODER_VIDEO, 0,  799992, false},
+	{OBS_ENCODER_AUDIO, 0,  831987, false},
+	{OBS_ENCODER_AUDIO, 1,  831987, false},
+	{OBS_ENCODER_AUDIO, 0,  853320, false},
+	{OBS_ENCODER_AUDIO, 1,  853320, false},
+	{OBS_ENCODER_VIDEO, 0,  833325, false},
+	{OBS_ENCODER_AUDIO, 0,  874653, false},
+	{OBS_ENCODER_AUDIO, 1,  874653, false},
+	{OBS_ENCODER_AUDIO, 0,  895986, false},
+	{OBS_ENCODER_AUDIO, 1,  895986, false},
+	{OBS_ENCODER_VIDEO, 0,  866658, false},
+	{OBS_ENCODER_AUDIO, 0,  917319, false},
+	{OBS_ENCODER_AUDIO, 1,  917319, false},
+	{OBS_ENCODER_AUDIO, 0,  938652, false},
+	{OBS_ENCODER_AUDIO, 1,  938652, false},
+	{OBS_ENCODER_VIDEO, 0,  899991, false},
+	{OBS_ENCODER_AUDIO, 0,  959985, false},
+	{OBS_ENCODER_AUDIO, 1,  959985, false},
+	{OBS_ENCODER_VIDEO, 0,  933324, false},
+	{OBS_ENCODER_AUDIO, 0,  981318, false},
+	{OBS_ENCODER_AUDIO, 1,  981318, false},
+	{OBS_ENCODER_VIDEO, 0,  966657, false},
+};
+
+#define TIMELINE_SIZE (sizeof(timeline) / sizeof(timeline[0]))
+
+static void make_packet(struct encoder_packet *packet, size_t idx)
+{
+	memset(packet, 0, sizeof(*packet));
+	packet->type      = timeline[idx].type;
+	packet->track_idx = timeline[idx].track_idx;
+	packet->dts_usec  = timeline[idx].dts_usec;
+	packet->keyframe  = timeline[idx].keyframe;
+
+	/* remember the arrival index to check the output order */
+	packet->pts = (int64_t)idx;
+}
+
+/* stable insertion sort by dts, which is the order the old single sorted
+ * array produced */
+static void get_expected_order(size_t *order)
+{
+	for (size_t i = 0; i < TIMELINE_SIZE; i++) {
+		size_t j = i;
+
+		while (j > 0 && timeline[order[j - 1]].dts_usec >
+				timeline[i].dts_usec) {
+			order[j] = order[j - 1];
+			j--;
+		}
+
+		order[j] = i;
+	}
+}
+
+static size_t drain(struct circlebuf *queues, size_t *out, size_t count)
+{
+	struct circlebuf *queue;
+
+	while ((queue = get_next_interleave_queue(queues)) != NULL) {
+		struct interleaved_packet item;
+		circlebuf_pop_front(queue, &item, sizeof(item));
+		out[count++] = (size_t)item.packet.pts;
+	}
+
+	return count;
+}
+
+static void check_order(const size_t *out, size_t count)
+{
+	size_t expected[TIMELINE_SIZE];
+
+	get_expected_order(expected);
+
+	check(count == TIMELINE_SIZE);
+	for (size_t i = 0; i < count && i < TIMELINE_SIZE; i++) {
+		check(out[i] == expected[i]);
+
+		if (i > 0)
+			check(timeline[out[i - 1]].dts_usec <=
+					timeline[out[i]].dts_usec);
+	}
+}
+
+/* everything is queued before sending, like at interleave start */
+static void test_full_replay(void)
+{
+	struct circlebuf queues[INTERLEAVE_QUEUES];
+	size_t out[TIMELINE_SIZE];
+	uint64_t seq = 0;
+	size_t count;
+
+	memset(queues, 0, sizeof(queues));
+
+	for (size_t i = 0; i < TIMELINE_SIZE; i++) {
+		struct encoder_packet packet;
+		make_packet(&packet, i);
+		queue_interleaved_packet(queues, &seq, &packet);
+	}
+
+	count = drain(queues, out, 0);
+	check_order(out, count);
+
+	for (size_t i = 0; i < INTERLEAVE_QUEUES; i++) {
+		check(queues[i].size == 0);
+		circlebuf_free(&queues[i]);
+	}
+}
+
+/* packets are sent while the timeline is replayed.  like the output, a
+ * packet is only sent once a later packet of the opposing type is queued, and
+ * only once both audio tracks have something queued */
+static void test_incremental_replay(void)
+{
+	struct circlebuf queues[INTERLEAVE_QUEUES];
+	size_t out[TIMELINE_SIZE];
+	int64_t highest_video = -1;
+	int64_t highest_audio = -1;
+	uint64_t seq = 0;
+	size_t count = 0;
+
+	memset(queues, 0, sizeof(queues));
+
+	for (size_t i = 0; i < TIMELINE_SIZE; i++) {
+		struct encoder_packet packet;
+		struct circlebuf *queue;
+
+		make_packet(&packet, i);
+		queue_interleaved_packet(queues, &seq, &packet);
+
+		if (packet.type == OBS_ENCODER_VIDEO) {
+			if (packet.dts_usec > highest_video)
+				highest_video = packet.dts_usec;
+		} else if (packet.dts_usec > highest_audio) {
+			highest_audio = packet.dts_usec;
+		}
+
+		while ((queue = get_next_interleave_queue(queues)) != NULL) {
+			struct interleaved_packet item;
+			int64_t opposing;
+
+			if (!queues[1].size || !queues[2].size)
+				break;
+
+			circlebuf_peek_front(queue, &item, sizeof(item));
+			opposing = item.packet.type == OBS_ENCODER_VIDEO ?
+				highest_audio : highest_video;
+			if (opposing <= item.packet.dts_usec)
+				break;
+
+			circlebuf_pop_front(queue, NULL, sizeof(item));
+			out[count++] = (size_t)item.packet.pts;
+		}
+	}
+
+	count = drain(queues, out, count);
+
+	check(count == TIMELINE_SIZE);
+	for (size_t i = 1; i < count; i++)
+		check(timeline[out[i - 1]].dts_usec <=
+				timeline[out[i]].dts_usec);
+
+	for (size_t i = 0; i < INTERLEAVE_QUEUES; i++)
+		circlebuf_free(&queues[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* the old single array, from obs-output.c                                   */
+
+struct sorted_packets {
+	DARRAY(struct encoder_packet) interleaved_packets;
+};
+
+static inline void insert_interleaved_packet(struct sorted_packets *output,
+		struct encoder_packet *out)
+{
+	size_t idx;
+	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
+		struct encoder_packet *cur_packet;
+		cur_packet = output->interleaved_packets.array + idx;
+
+		if (out->dts_usec < cur_packet->dts_usec)
+			break;
+	}
+
+	da_insert(output->interleaved_packets, idx, out);
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t random_value(uint32_t range)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return (random_state >> 8) % range;
+}
+
+#define RANDOM_PACKETS 2000
+
+/* few distinct dts values so there are lots of ties, within and across
+ * tracks, and every so often a packet that's behind the rest of its track */
+static void make_random_packet(struct encoder_packet *packet, int64_t *dts,
+		size_t idx)
+{
+	uint32_t track = random_value(4);
+
+	memset(packet, 0, sizeof(*packet));
+	packet->type = track == 0 ? OBS_ENCODER_VIDEO : OBS_ENCODER_AUDIO;
+	packet->track_idx = track == 0 ? 0 : track - 1;
+
+	if (random_value(3) == 0)
+		*dts += (int64_t)random_value(3) * 1000;
+
+	packet->dts_usec = *dts;
+	if (random_value(10) == 0)
+		packet->dts_usec -= (int64_t)random_value(5) * 1000;
+
+	packet->pts = (int64_t)idx;
+}
+
+static void test_same_as_sorted_array(uint32_t seed, uint32_t send_chance)
+{
+	struct circlebuf queues[INTERLEAVE_QUEUES];
+	struct sorted_packets sorted;
+	size_t sent = 0;
+	uint64_t seq = 0;
+	int64_t dts = 0;
+	bool same = true;
+
+	memset(queues, 0, sizeof(queues));
+	memset(&sorted, 0, sizeof(sorted));
+	random_state = seed;
+
+	for (size_t i = 0; i < RANDOM_PACKETS || sorted.interleaved_packets.num;
+			i++) {
+		bool last = i >= RANDOM_PACKETS;
+
+		if (!last) {
+			struct encoder_packet packet;
+			make_random_packet(&packet, &dts, i);
+			queue_interleaved_packet(queues, &seq, &packet);
+			insert_interleaved_packet(&sorted, &packet);
+		}
+
+		while (sorted.interleaved_packets.num &&
+		       (last || random_value(100) < send_chance)) {
+			struct circlebuf *queue;
+			struct interleaved_packet item;
+
+			queue = get_next_interleave_queue(queues);
+			if (!queue) {
+				same = false;
+				break;
+			}
+
+			circlebuf_pop_front(queue, &item, sizeof(item));
+			if (item.packet.pts !=
+			    sorted.interleaved_packets.array[0].pts)
+				same = false;
+
+			da_erase(sorted.interleaved_packets, 0);
+			sent++;
+		}
+
+		if (!same)
+			break;
+	}
+
+	if (!same)
+		fprintf(stderr, "seed %u: differs after %u packets\n",
+				seed, (unsigned)sent);
+	check(same);
+	check(get_next_interleave_queue(queues) == NULL);
+
+	for (size_t i = 0; i < INTERLEAVE_QUEUES; i++)
+		circlebuf_free(&queues[i]);
+	da_free(sorted.interleaved_packets);
+}
+
+static void test_random_streams(void)
+{
+	static const uint32_t send_chances[] = {0, 10, 50, 90};
+
+	for (uint32_t seed = 1; seed <= 20; seed++) {
+		for (size_t i = 0; i < 4; i++)
+			test_same_as_sorted_array(seed, send_chances[i]);
+	}
+}
+
+int main(void)
+{
+	test_full_replay();
+	test_incremental_replay();
+	test_random_streams();
+	return unit_test_result("test-interleave");
+}
@@ -0,0 +1,113 @@
+#include <obs.h>
+
+#include "unit-test.h"
+
+/*
+ * Fans one encoder packet out to several outputs the way the encoder and
+ * outputs do it: the encoder copies its packet in to a shared pooled buffer
+ * once (send_packet_to_callbacks), and each output only adds a reference to
+ * it.  Checks that this takes exactly one pooled allocation and that no
+ * output gets its own copy.
+ */
+
+#define OUTPUTS 6
+
+static uint8_t payload[50000];
+
+static void make_encoder_packet(struct encoder_packet *packet)
+{
+	memset(packet, 0, sizeof(*packet));
+	packet->type     = OBS_ENCODER_VIDEO;
+	packet->data     = payload;
+	packet->size     = sizeof(payload);
+	packet->keyframe = true;
+}
+
+static long get_buffers_used(long *allocs, long *reuses)
+{
+	obs_encoder_packet_get_pool_stats(allocs, reuses);
+	return *allocs + *reuses;
+}
+
+static void test_fan_out(void)
+{
+	struct encoder_packet encoded;
+	struct encoder_packet shared;
+	struct encoder_packet outputs[OUTPUTS];
+	long allocs_before, reuses_before;
+	long allocs, reuses;
+	long before;
+
+	for (size_t i = 0; i < sizeof(payload); i++)
+		payload[i] = (uint8_t)i;
+
+	make_encoder_packet(&encoded);
+	before = get_buffers_used(&allocs_before, &reuses_before);
+
+	/* the encoder's own data is copied once */
+	obs_encoder_packet_ref(&shared, &encoded);
+	check(shared.buf != NULL);
+	check(shared.data != encoded.data);
+
+	for (size_t i = 0; i < OUTPUTS; i++)
+		obs_encoder_packet_ref(&outputs[i], &shared);
+
+	obs_encoder_packet_release(&shared);
+
+	check(get_buffers_used(&allocs, &reuses) == before + 1);
+
+	for (size_t i = 0; i < OUTPUTS; i++) {
+		check(outputs[i].buf == outputs[0].buf);
+		check(outputs[i].data == outputs[0].data);
+		check(outputs[i].size == sizeof(payload));
+		check(memcmp(outputs[i].data, payload, sizeof(payload)) == 0);
+	}
+
+	for (size_t i = 0; i < OUTPUTS; i++)
+		obs_encoder_packet_release(&outputs[i]);
+
+	/* once every output released it, the buffer goes back to the pool and
+	 * the next packet of the same size reuses it */
+	obs_encoder_packet_ref(&shared, &encoded);
+	obs_encoder_packet_release(&shared);
+
+	get_buffers_used(&allocs, &reuses);
+	check(allocs == allocs_before + 1);
+	check(reuses == reuses_before + 1);
+}
+
+/* a packet whose data was replaced (obs_parse_avc_packet etc.) no longer
+ * points in to its buffer, so referencing it has to copy */
+static void test_replaced_data(void)
+{
+	struct encoder_packet encoded;
+	struct encoder_packet shared;
+	struct encoder_packet replaced;
+	struct encoder_packet copy;
+	uint8_t other[16] = {0};
+	long allocs, reuses;
+	long before;
+
+	make_encoder_packet(&encoded);
+	obs_encoder_packet_ref(&shared, &encoded);
+
+	replaced = shared;
+	replaced.data = other;
+	replaced.size = sizeof(other);
+
+	before = get_buffers_used(&allocs, &reuses);
+	obs_encoder_packet_ref(&copy, &replaced);
+	check(get_buffers_used(&allocs, &reuses) == before + 1);
+	check(copy.buf != shared.buf);
+	check(copy.size == sizeof(other));
+
+	obs_encoder_packet_release(&copy);
+	obs_encoder_packet_release(&shared);
+}
+
+int main(void)
+{
+	test_fan_out();
+	test_replaced_data();
+	return unit_test_result("test-packet-pool");
+}
@@ -0,0 +1,321 @@
+#include <obs-avc.h>
+#include <util/circlebuf.h>
+
+#include "../../plugins/obs-outputs/rtmp-send-stats.h"
+#include "unit-test.h"
+
+/*
+ * Drives the rtmp-stream send capacity estimator with a rate limited fake
+ * sink on a simulated clock, so the runs are exact and take no real time.
+ *
+ * The sink is a socket send buffer that drains at a set rate.  A write blocks
+ * until all of its data fits in to the buffer, like a blocking socket.  The
+ * encoder side queues a 30 fps stream and runs the same drop checks as
+ * rtmp-stream's check_to_drop_frames/drop_frames/add_video_packet: when the
+ * estimated time to send the queue passes a threshold, every queued frame
+ * below that threshold's priority is dropped, and new frames below it are
+ * dropped until one at or above it comes in.
+ */
+
+#define TICK_NS          1000000ULL
+#define FPS              30
+#define KEYFRAME_FRAMES  (FPS * 2)
+#define SINK_BUFFER_SIZE (64 * 1024)
+
+/* rtmp-stream's default thresholds */
+#define DROP_THRESHOLD_USEC        500000
+#define PFRAME_DROP_THRESHOLD_USEC 800000
+
+struct frame {
+	int64_t dts_usec;
+	size_t  size;
+	int     priority;
+};
+
+struct sim {
+	struct send_stats stats;
+
+	/* encoder side */
+	struct circlebuf  queue;
+	size_t            buffered_bytes;
+	int64_t           last_dts_usec;
+	int64_t           min_drop_dts_usec;
+	int64_t           pframe_min_drop_dts_usec;
+	int               min_priority;
+	uint64_t          bitrate_bps;
+	uint64_t          frames;
+	int               dropped_frames;
+
+	/* send thread and sink */
+	uint64_t          sink_bps;
+	double            sink_level;
+	bool              writing;
+	size_t            write_size;
+	size_t            write_left;
+	uint64_t          sent_bytes;
+
+	uint64_t          cur_time;
+};
+
+static void sim_init(struct sim *sim, uint64_t bitrate_bps, uint64_t sink_bps)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->bitrate_bps = bitrate_bps;
+	sim->sink_bps    = sink_bps;
+	send_stats_reset(&sim->stats, 0);
+}
+
+static void sim_free(struct sim *sim)
+{
+	circlebuf_free(&sim->queue);
+}
+
+static inline size_t num_queued(struct sim *sim)
+{
+	return sim->queue.size / sizeof(struct frame);
+}
+
+/* ------------------------------------------------------------------------- */
+/* encoder side                                                              */
+
+static void drop_frames(struct sim *sim, int highest_priority,
+		int64_t *p_min_dts_usec)
+{
+	size_t count = num_queued(sim);
+
+	for (size_t i = 0; i < count; i++) {
+		struct frame frame;
+
+		circlebuf_pop_front(&sim->queue, &frame, sizeof(frame));
+
+		if (frame.priority < highest_priority) {
+			sim->buffered_bytes -= frame.size;
+			sim->dropped_frames++;
+		} else {
+			circlebuf_push_back(&sim->queue, &frame, sizeof(frame));
+		}
+	}
+
+	if (sim->min_priority < highest_priority)
+		sim->min_priority = highest_priority;
+
+	*p_min_dts_usec = sim->last_dts_usec;
+}
+
+static void check_to_drop_frames(struct sim *sim, bool pframes)
+{
+	struct frame first;
+	int64_t buffer_duration_usec;
+	int priority = pframes ?
+		OBS_NAL_PRIORITY_HIGHEST : OBS_NAL_PRIORITY_HIGH;
+	int64_t *p_min_dts_usec = pframes ?
+		&sim->pframe_min_drop_dts_usec : &sim->min_drop_dts_usec;
+	int64_t drop_threshold = pframes ?
+		PFRAME_DROP_THRESHOLD_USEC : DROP_THRESHOLD_USEC;
+
+	if (num_queued(sim) < 5)
+		return;
+
+	circlebuf_peek_front(&sim->queue, &first, sizeof(first));
+	if (first.dts_usec < *p_min_dts_usec)
+		return;
+
+	buffer_duration_usec = send_stats_estimate_usec(&sim->stats,
+			sim->buffered_bytes, sim->cur_time);
+	if (buffer_duration_usec < 0)
+		buffer_duration_usec = sim->last_dts_usec - first.dts_usec;
+
+	if (buffer_duration_usec > drop_threshold)
+		drop_frames(sim, priority, p_min_dts_usec);
+}
+
+static void encode_frame(struct sim *sim)
+{
+	size_t frame_size = (size_t)(sim->bitrate_bps / 8 / FPS);
+	bool keyframe = sim->frames % KEYFRAME_FRAMES == 0;
+	struct frame frame;
+
+	frame.dts_usec = (int64_t)(sim->frames * 1000000 / FPS);
+	frame.size     = keyframe ? frame_size * 4 : frame_size;
+	frame.priority = keyframe ?
+		OBS_NAL_PRIORITY_HIGHEST : OBS_NAL_PRIORITY_HIGH;
+	sim->frames++;
+
+	check_to_drop_frames(sim, false);
+	check_to_drop_frames(sim, true);
+
+	if (frame.priority < sim->min_priority) {
+		sim->dropped_frames++;
+		return;
+	}
+
+	sim->min_priority = 0;
+
+	circlebuf_push_back(&sim->queue, &frame, sizeof(frame));
+	sim->buffered_bytes += frame.size;
+	sim->last_dts_usec = frame.dts_usec;
+}
+
+/* ------------------------------------------------------------------------- */
+/* send thread writing to the sink                                           */
+
+static void fill_sink(struct sim *sim)
+{
+	double space = SINK_BUFFER_SIZE - sim->sink_level;
+	size_t fill = space < (double)sim->write_left ?
+		(size_t)space : sim->write_left;
+
+	sim->sink_level += (double)fill;
+	sim->write_left -= fill;
+
+	if (!sim->write_left) {
+		send_stats_end(&sim->stats, sim->write_size, sim->cur_time,
+				-1);
+		sim->sent_bytes += sim->write_size;
+		sim->writing = false;
+	}
+}
+
+static void send_frames(struct sim *sim)
+{
+	if (sim->writing)
+		fill_sink(sim);
+
+	while (!sim->writing && num_queued(sim)) {
+		struct frame frame;
+
+		circlebuf_pop_front(&sim->queue, &frame, sizeof(frame));
+		sim->buffered_bytes -= frame.size;
+
+		sim->writing    = true;
+		sim->write_size = frame.size;
+		sim->write_left = frame.size;
+		send_stats_begin(&sim->stats, frame.size, sim->cur_time);
+
+		fill_sink(sim);
+	}
+}
+
+static void sim_tick(struct sim *sim)
+{
+	sim->cur_time += TICK_NS;
+
+	sim->sink_level -= (double)sim->sink_bps / 8.0 *
+		(double)TICK_NS / 1000000000.0;
+	if (sim->sink_level < 0.0)
+		sim->sink_level = 0.0;
+
+	while (sim->frames * 1000000000ULL / FPS <= sim->cur_time)
+		encode_frame(sim);
+
+	send_frames(sim);
+}
+
+/* how long the queue will really take to send at the sink's rate */
+static inline int64_t queued_send_time_usec(struct sim *sim)
+{
+	return (int64_t)((sim->buffered_bytes + sim->write_left) * 8ULL *
+			1000000ULL / sim->sink_bps);
+}
+
+static void run_seconds(struct sim *sim, int seconds)
+{
+	uint64_t end = sim->cur_time + (uint64_t)seconds * 1000000000ULL;
+
+	while (sim->cur_time < end)
+		sim_tick(sim);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void test_uncongested(void)
+{
+	struct sim sim;
+
+	sim_init(&sim, 2500000, 10000000);
+	run_seconds(&sim, 20);
+
+	check(sim.dropped_frames == 0);
+	check(sim.stats.congestion < 0.5f);
+	check(queued_send_time_usec(&sim) < DROP_THRESHOLD_USEC);
+
+	sim_free(&sim);
+}
+
+static void test_congested(void)
+{
+	const uint64_t sink_bps = 3000000;
+	int64_t max_send_time = 0;
+	uint64_t sent_start;
+	struct sim sim;
+
+	sim_init(&sim, 6000000, sink_bps);
+	run_seconds(&sim, 5);
+	sent_start = sim.sent_bytes;
+
+	for (int i = 0; i < 15000; i++) {
+		int64_t send_time;
+
+		sim_tick(&sim);
+
+		send_time = queued_send_time_usec(&sim);
+		if (send_time > max_send_time)
+			max_send_time = send_time;
+	}
+
+	/* the capacity is found.  data that goes in to the send buffer
+	 * without blocking counts towards it, so it reads high by up to the
+	 * buffer size per window.  dropping everything up to the next
+	 * keyframe leaves the sink idle for a while, so not all of it is
+	 * used */
+	check(sim.stats.capacity_bps > sink_bps * 8 / 10);
+	check(sim.stats.capacity_bps < sink_bps * 2);
+	check(sim.stats.congestion > 0.9f);
+	check((sim.sent_bytes - sent_start) * 8 > sink_bps * 15 / 2);
+
+	/* frames are dropped so the queue stays within the latency budget,
+	 * give or take a keyframe and the frames queued after a drop */
+	check(sim.dropped_frames > 0);
+	check(max_send_time < PFRAME_DROP_THRESHOLD_USEC + 500000);
+
+	sim_free(&sim);
+}
+
+static void test_stall(void)
+{
+	const int64_t stall_usec = 10 * 1000000;
+	struct sim sim;
+	int dropped;
+
+	sim_init(&sim, 2500000, 5000000);
+	run_seconds(&sim, 10);
+
+	/* no write has blocked yet, so there is no measured capacity */
+	check(sim.dropped_frames == 0);
+	check(sim.stats.capacity_bps == 0);
+
+	/* the connection stalls in the middle of a write.  the write that is
+	 * still blocked has to give an estimate, since the capacity won't be
+	 * measured until it returns.  without it the drop would have to wait
+	 * for the queued duration to pass the threshold */
+	sim.sink_bps = 50000;
+	dropped = sim.dropped_frames;
+
+	while (sim.dropped_frames == dropped &&
+	       sim.cur_time < (uint64_t)(stall_usec + 5000000) * 1000ULL)
+		sim_tick(&sim);
+
+	check(sim.dropped_frames > dropped);
+	check((int64_t)(sim.cur_time / 1000) - stall_usec <
+			DROP_THRESHOLD_USEC);
+
+	sim_free(&sim);
+}
+
+int main(void)
+{
+	test_uncongested();
+	test_congested();
+	test_stall();
+	return unit_test_result("test-rtmp-send-stats");
+}
@@ -0,0 +1,114 @@
+#include <obs.h>
+
+#include "../../plugins/linux-v4l2/v4l2-decoder.h"
+#include "unit-test.h"
+
+/*
+ * Decodes a canned MJPEG stream the way v4l2-input does it, and checks the
+ * format, size, range and content of the frames that come out.
+ *
+ * The frame is a 32x16 baseline JPEG with 4:2:2 sampling like most webcams
+ * send, filled with Y=180 Cb=100 Cr=160.  It is decoded to planar 4:2:2,
+ * so this also covers packing it to YUY2.
+ */
+
+#define FRAME_WIDTH  32
+#define FRAME_HEIGHT 16
+#define FRAMES       12
+
+/* frame threading may hold back up to this many frames */
+#define MAX_DELAY    4
+
+static const uint8_t mjpeg_frame[] = {
+	0xff, 0xd8, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xff,
+	0xdb, 0x00, 0x43, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xff, 0xc0, 0x00, 0x11,
+	0x08, 0x00, 0x10, 0x00, 0x20, 0x03, 0x01, 0x21, 0x00, 0x02, 0x11, 0x01,
+	0x03, 0x11, 0x01, 0xff, 0xc4, 0x00, 0x15, 0x00, 0x01, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x09, 0xff, 0xc4, 0x00, 0x14, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xc4, 0x00, 0x16, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x09,
+	0xff, 0xc4, 0x00, 0x14, 0x11, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xda,
+	0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00,
+	0xb4, 0x02, 0x1f, 0x68, 0x00, 0x00, 0x00, 0x03, 0xff, 0xd9,
+};
+
+static inline bool near(uint8_t val, uint8_t expected)
+{
+	return abs((int)val - (int)expected) <= 2;
+}
+
+static void check_frame(const struct obs_source_frame *frame,
+		uint64_t last_timestamp)
+{
+	check(frame->format == VIDEO_FORMAT_YUY2);
+	check(frame->width == FRAME_WIDTH);
+	check(frame->height == FRAME_HEIGHT);
+	check(frame->full_range);
+	check(frame->color_range_min[0] == 0.0f);
+	check(frame->color_range_max[0] == 1.0f);
+	check(frame->linesize[0] == FRAME_WIDTH * 2);
+	check(frame->timestamp > last_timestamp || last_timestamp == 0);
+
+	for (uint32_t y = 0; y < frame->height; y++) {
+		const uint8_t *line = frame->data[0] + y * frame->linesize[0];
+
+		for (uint32_t x = 0; x < frame->width / 2; x++) {
+			check(near(line[x * 4 + 0], 180));
+			check(near(line[x * 4 + 1], 100));
+			check(near(line[x * 4 + 2], 180));
+			check(near(line[x * 4 + 3], 160));
+		}
+	}
+}
+
+static void test_decode_mjpeg(void)
+{
+	struct v4l2_decoder decoder;
+	struct obs_source_frame frame;
+	uint64_t last_timestamp = 0;
+	int decoded = 0;
+
+	memset(&frame, 0, sizeof(frame));
+
+	if (v4l2_init_decoder(&decoder, V4L2_PIX_FMT_MJPEG) < 0) {
+		check(!"failed to initialize the MJPEG decoder");
+		return;
+	}
+
+	for (uint64_t i = 1; i <= FRAMES; i++) {
+		int ret = v4l2_decode_frame(&decoder, mjpeg_frame,
+				sizeof(mjpeg_frame), i * 1000, &frame);
+
+		check(ret >= 0);
+		if (ret != 1)
+			continue;
+
+		check_frame(&frame, last_timestamp);
+		check(frame.timestamp <= i * 1000);
+		last_timestamp = frame.timestamp;
+		decoded++;
+	}
+
+	check(decoded >= FRAMES - MAX_DELAY);
+
+	v4l2_destroy_decoder(&decoder);
+}
+
+int main(void)
+{
+	test_decode_mjpeg();
+	return unit_test_result("test-v4l2-decoder");
+}
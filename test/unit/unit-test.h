@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/c99defs.h>
+
+/*
+ * Minimal helpers for the unit tests.  Each test is its own executable that
+ * returns non-zero if any check failed.  Tests that also measure performance
+ * only do so when run with "--bench", so ctest runs stay quick.
+ */
+
+static int unit_test_failures = 0;
+
+#define check(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", \
+					__FILE__, __LINE__, #cond); \
+			unit_test_failures++; \
+		} \
+	} while (false)
+
+static inline bool unit_test_bench(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench") == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static inline int unit_test_result(const char *name)
+{
+	if (unit_test_failures)
+		fprintf(stderr, "%s: %d check(s) failed\n", name,
+				unit_test_failures);
+	return unit_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}